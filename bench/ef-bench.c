@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include "ef.h"
+
+// Micro benchmarks of the frame engine. Each benchmark is calibrated to run
+// for at least the minimum time, and then measured a number of times. The
+// median is reported as JSON on stdout, to be compared between builds.
+//
+// Allocations are counted by wrapping the allocator of the C library, which
+// libef is linked statically against.
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void __libc_free(void *p);
+
+static uint64_t ALLOC_CNT;
+
+void *malloc(size_t size) {
+    ALLOC_CNT++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    ALLOC_CNT++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+    ALLOC_CNT++;
+    return __libc_realloc(p, size);
+}
+
+void free(void *p) {
+    __libc_free(p);
+}
+
+#define BENCH_RUNS_MAX 32
+#define BENCH_ARGV_MAX 64
+
+struct bench;
+typedef void (*bench_fn_t)(struct bench *b, uint64_t n);
+
+typedef struct bench {
+    const char *name;
+    bench_fn_t  fn;
+    const char *arg;      // Frame specification, or value to parse
+    int         bytes;    // Bytes per operation, for throughput
+
+    // Prepared by bench_setup()
+    int         argc;
+    const char *argv[BENCH_ARGV_MAX];
+    char       *words;
+    frame_t    *frame;
+    buf_t      *buf;
+    buf_t      *mask;
+    buf_t      *rx;
+    field_t    *field;
+    int         field_offset;
+} bench_t;
+
+// Results must be consumed, or the compiler may drop the work
+static volatile uint64_t SINK;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_parse_bytes(bench_t *b, uint64_t n) {
+    buf_t *v;
+
+    while (n--) {
+        v = parse_bytes(b->arg, b->bytes);
+        SINK += v->data[0];
+        bfree(v);
+    }
+}
+
+static void bench_argc_frame(bench_t *b, uint64_t n) {
+    frame_t *f;
+
+    while (n--) {
+        f = frame_alloc();
+        SINK += argc_frame(b->argc, b->argv, f);
+        frame_free(f);
+    }
+}
+
+// Defaults are filled into the frame on the first call, later calls measure
+// the steady state of building the frame again.
+static void bench_frame_to_buf(bench_t *b, uint64_t n) {
+    buf_t *v;
+
+    while (n--) {
+        v = frame_to_buf(b->frame);
+        SINK += v->size;
+        bfree(v);
+    }
+}
+
+static void bench_frame_mask_to_buf(bench_t *b, uint64_t n) {
+    buf_t *v;
+
+    while (n--) {
+        v = frame_mask_to_buf(b->frame);
+        SINK += v->size;
+        bfree(v);
+    }
+}
+
+static void bench_hdr_write_field(bench_t *b, uint64_t n) {
+    while (n--)
+        hdr_write_field(b->buf, b->field_offset, b->field, b->field->val);
+
+    SINK += b->buf->data[0];
+}
+
+static void bench_inet_chksum(bench_t *b, uint64_t n) {
+    while (n--)
+        SINK += inet_chksum(0, (const uint16_t *)b->buf->data, b->buf->size);
+}
+
+static void bench_bequal_mask(bench_t *b, uint64_t n) {
+    while (n--)
+        SINK += bequal_mask(b->rx, b->buf, b->mask, 0);
+}
+
+static void bench_print_hex_str(bench_t *b, uint64_t n) {
+    while (n--)
+        print_hex_str(PO_FD, b->buf->data, b->buf->size);
+
+    out_flush();
+}
+
+#define STACK_ETH_IPV4 "eth dmac ::1 smac ::2 ctag vid 100 pcp 3 " \
+                       "ipv4 sip 10.0.0.1 dip 10.0.0.2 dscp 10 " \
+                       "udp sport 1000 dport 2000"
+#define STACK_IFH_JR2  "ifh-jr2 ts 0xffffffff di-dst-port-mask 3 " \
+                       "eth dmac ff:ff:ff:ff:ff:ff smac ::1"
+#define STACK_PTP      "eth dmac 01:1b:19:00:00:00 smac ::1 " \
+                       "ptp-announce hdr-sequenceId 7 ann-gmPrio1 128 " \
+                       "ptp-tlv-org ptp-tlv-path"
+#define STACK_IGN      "eth dmac ::1 smac ign ctag vid 100 ipv4 ign " \
+                       "sip 10.0.0.1 udp sport ign"
+
+static bench_t BENCHES[] = {
+    { "parse_bytes/u16",            bench_parse_bytes, "0x8100", 2 },
+    { "parse_bytes/mac",            bench_parse_bytes, "01:02:03:04:05:06", 6 },
+    { "parse_bytes/ipv4",           bench_parse_bytes, "10.11.12.13", 4 },
+    { "argc_frame/eth-ctag-ipv4-udp", bench_argc_frame, STACK_ETH_IPV4 },
+    { "argc_frame/ifh-jr2-eth",     bench_argc_frame, STACK_IFH_JR2 },
+    { "argc_frame/ptp-announce-tlv", bench_argc_frame, STACK_PTP },
+    { "frame_to_buf/eth-ctag-ipv4-udp", bench_frame_to_buf, STACK_ETH_IPV4 },
+    { "frame_to_buf/ifh-jr2-eth",   bench_frame_to_buf, STACK_IFH_JR2 },
+    { "frame_to_buf/ptp-announce-tlv", bench_frame_to_buf, STACK_PTP },
+    { "frame_mask_to_buf/eth-ctag-ipv4-udp-ign", bench_frame_mask_to_buf,
+      STACK_IGN },
+    { "hdr_write_field/ctag-vid",   bench_hdr_write_field, "ctag vid 0x123" },
+    { "hdr_write_field/eth-dmac",   bench_hdr_write_field,
+      "eth dmac 01:02:03:04:05:06" },
+    { "inet_chksum/20",             bench_inet_chksum, 0, 20 },
+    { "inet_chksum/1500",           bench_inet_chksum, 0, 1500 },
+    { "bequal_mask/eth-ctag-ipv4-udp-ign", bench_bequal_mask, STACK_IGN },
+    { "bequal_mask/1514",           bench_bequal_mask, 0, 1514 },
+    { "print_hex_str/eth-ctag-ipv4-udp", bench_print_hex_str, STACK_ETH_IPV4 },
+    { "print_hex_str/1514",         bench_print_hex_str, 0, 1514 },
+};
+
+static int bench_setup(bench_t *b) {
+    char *p;
+    int i;
+
+    if (b->fn == bench_parse_bytes)
+        return 0;
+
+    // Benchmarks on a plain buffer
+    if (!b->arg) {
+        b->buf = balloc(b->bytes);
+        for (i = 0; i < b->bytes; ++i)
+            b->buf->data[i] = i * 7;
+
+        b->rx = bclone(b->buf);
+        b->mask = balloc(b->bytes);
+        memset(b->mask->data, 0xff, b->bytes);
+        return 0;
+    }
+
+    b->words = strdup(b->arg);
+    for (p = strtok(b->words, " "); p && b->argc < BENCH_ARGV_MAX;
+         p = strtok(0, " "))
+        b->argv[b->argc++] = p;
+
+    b->frame = frame_alloc();
+    if (argc_frame(b->argc, b->argv, b->frame) != b->argc) {
+        fprintf(stderr, "%s: Invalid frame: %s\n", b->name, b->arg);
+        return -1;
+    }
+
+    b->buf = frame_to_buf(b->frame);
+    b->mask = frame_mask_to_buf(b->frame);
+    b->rx = bclone(b->buf);
+    b->bytes = b->buf->size;
+
+    // The field of the last word, e.g. 'vid 0x123'
+    if (b->fn == bench_hdr_write_field) {
+        hdr_t *h = b->frame->stack[b->frame->stack_size - 1];
+
+        b->field = find_field(h, b->argv[b->argc - 2]);
+        b->field_offset = h->offset_in_frame;
+        b->bytes = BIT_TO_BYTE(b->field->bit_width);
+    }
+
+    return 0;
+}
+
+static void bench_teardown(bench_t *b) {
+    if (b->frame)
+        frame_free(b->frame);
+
+    bfree(b->buf);
+    bfree(b->mask);
+    bfree(b->rx);
+    free(b->words);
+}
+
+static int u64_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void bench_run(bench_t *b, uint64_t min_ns, int runs, int first) {
+    uint64_t n = 1, t, ns[BENCH_RUNS_MAX], allocs;
+    double ns_op;
+    int i;
+
+    // Calibrate, and warm up
+    while (1) {
+        t = now_ns();
+        b->fn(b, n);
+        t = now_ns() - t;
+        if (t >= min_ns || n >= (1ULL << 40))
+            break;
+
+        // Aim for #min_ns, with some margin
+        if (t < min_ns / 16)
+            n *= 16;
+        else
+            n = n * min_ns / t * 11 / 10 + 1;
+    }
+
+    allocs = ALLOC_CNT;
+    for (i = 0; i < runs; ++i) {
+        t = now_ns();
+        b->fn(b, n);
+        ns[i] = now_ns() - t;
+    }
+    allocs = ALLOC_CNT - allocs;
+
+    qsort(ns, runs, sizeof(ns[0]), u64_cmp);
+    ns_op = (double)ns[runs / 2] / n;
+
+    printf("%s    {\"name\": \"%s\", \"iterations\": %" PRIu64 ", "
+           "\"runs\": %d, \"ns_per_op\": %.2f, \"ns_per_op_min\": %.2f, "
+           "\"allocs_per_op\": %.2f, \"ops_per_sec\": %.0f, "
+           "\"bytes_per_op\": %d, \"mb_per_sec\": %.1f}",
+           first ? "" : ",\n", b->name, n, runs, ns_op,
+           (double)ns[0] / n, (double)allocs / ((double)n * runs),
+           1e9 / ns_op, b->bytes, b->bytes * 1e3 / ns_op);
+    fflush(stdout);
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Usage: ef-bench [-t <ms>] [-r <runs>] [-l] [<filter>...]\n"
+            "  -t <ms>    Minimum time of each run, default 100\n"
+            "  -r <runs>  Measured runs per benchmark, median is reported,\n"
+            "             default 5\n"
+            "  -l         List the benchmarks\n"
+            "  <filter>   Only run benchmarks with a name containing this\n");
+}
+
+int main(int argc, char *argv[]) {
+    int opt, i, j, runs = 5, first = 1, list = 0, match;
+    uint64_t min_ns = 100000000;
+
+    while ((opt = getopt(argc, argv, "t:r:lh")) != -1) {
+        switch (opt) {
+            case 't':
+                min_ns = strtoull(optarg, 0, 0) * 1000000;
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                if (runs < 1 || runs > BENCH_RUNS_MAX) {
+                    fprintf(stderr, "runs must be 1..%d\n", BENCH_RUNS_MAX);
+                    return 1;
+                }
+                break;
+            case 'l':
+                list = 1;
+                break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    // print_hex_str() is measured without the cost of a terminal
+    PO_FD = open("/dev/null", O_WRONLY);
+    if (PO_FD < 0) {
+        perror("/dev/null");
+        return 1;
+    }
+
+    if (!list) {
+        printf("{\n  \"version\": \"%s\",\n  \"compiler\": \"%s\",\n"
+               "  \"optimized\": %s,\n  \"hex_impl\": \"%s\",\n"
+               "  \"benchmarks\": [\n", gGIT_VERSION, __VERSION__,
+#ifdef __OPTIMIZE__
+               "true",
+#else
+               "false",
+#endif
+               hex_impl_name());
+    }
+
+    for (i = 0; i < (int)(sizeof(BENCHES) / sizeof(BENCHES[0])); ++i) {
+        match = optind == argc;
+        for (j = optind; j < argc; ++j)
+            match |= strstr(BENCHES[i].name, argv[j]) != 0;
+
+        if (!match)
+            continue;
+
+        if (list) {
+            printf("%s\n", BENCHES[i].name);
+            continue;
+        }
+
+        if (bench_setup(&BENCHES[i]) == 0) {
+            bench_run(&BENCHES[i], min_ns, runs, first);
+            first = 0;
+        }
+        bench_teardown(&BENCHES[i]);
+    }
+
+    if (!list)
+        printf("\n  ]\n}\n");
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+#define _GNU_SOURCE // unshare()
+#include <stdio.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+#include "ef.h"
+
+// End-to-end TX/RX benchmark. A private network namespace with a veth pair is
+// created, and ef is run with 'tx' on one end at a number of frame sizes,
+// unpaced ('rep <cnt>') and paced ('replay ... pps <rate>'), and with
+// 'rx ... rep <cnt>' expecting the frames on the other end. The frames are
+// received and matched by the exec loop of ef. The rates are computed from the
+// start of the run to the last frame sent and the last frame matched, and the
+// CPU time of ef (which runs in this thread) is reported per frame. Needs
+// CAP_SYS_ADMIN and CAP_NET_ADMIN, but no NICs.
+
+#define VETH_TX "ef-b0"
+#define VETH_RX "ef-b1"
+
+// Headers in front of the payload: eth + ipv4 + udp
+#define FRAME_HDR_SIZE 42
+
+static int sh(const char *fmt, ...) {
+    char cmd[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(cmd, sizeof(cmd), fmt, ap);
+    va_end(ap);
+
+    if (system(cmd) != 0) {
+        fprintf(stderr, "Failed: %s\n", cmd);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int write_file(const char *path, const char *val) {
+    int fd, res;
+
+    fd = open(path, O_WRONLY);
+    if (fd < 0)
+        return -1;
+
+    res = write(fd, val, strlen(val));
+    close(fd);
+
+    return res < 0 ? -1 : 0;
+}
+
+static uint64_t read_u64(const char *fmt, const char *ifname) {
+    char path[128], val[32] = {};
+    int fd, res;
+
+    snprintf(path, sizeof(path), fmt, ifname);
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    res = read(fd, val, sizeof(val) - 1);
+    close(fd);
+
+    return res > 0 ? strtoull(val, 0, 0) : 0;
+}
+
+static int netns_setup() {
+    if (unshare(CLONE_NEWNET) < 0) {
+        perror("unshare(CLONE_NEWNET)");
+        return -1;
+    }
+
+    // No IPv6 autoconf or MLD frames on the veth pair
+    write_file("/proc/sys/net/ipv6/conf/default/disable_ipv6", "1");
+    write_file("/proc/sys/net/ipv6/conf/all/disable_ipv6", "1");
+
+    if (sh("ip link add " VETH_TX " type veth peer name " VETH_RX) ||
+        sh("ip link set " VETH_TX " up") || sh("ip link set " VETH_RX " up"))
+        return -1;
+
+    return 0;
+}
+
+static double ts_to_sec(const struct timespec *ts) {
+    return ts->tv_sec + ts->tv_nsec / 1e9;
+}
+
+static double tv_ns(const struct timeval *a, const struct timeval *b) {
+    return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_usec - a->tv_usec) * 1e3;
+}
+
+static int frame_spec(char *o, size_t size, int frame_size) {
+    return snprintf(o, size, "eth dmac ::1 smac ::2 ipv4 sip 1.1.1.1 "
+                    "dip 2.2.2.2 udp sport 1 dport 2 data pattern cnt %d",
+                    frame_size - FRAME_HDR_SIZE);
+}
+
+// Run one test, and print a JSON record of it
+static int bench_one(int frame_size, uint64_t cnt, uint64_t pps,
+                     const char *pcap, int first) {
+    char spec[256], cmd[1024];
+    const char *argv[128];
+    stats_if_t *tx_s, *rx_s, tx0, rx0;
+    uint64_t tx_frames, tx_bytes, rx_frames, rx_bytes, rx_match, tx_drop;
+    double start, run_sec, tx_sec, rx_sec, t, frames;
+    const result_rec_t *recs;
+    struct timespec ts0, ts1;
+    struct rusage ru0, ru1;
+    size_t i, rec_cnt;
+    int argc, len, res, timeout = TIME_OUT_MS;
+    frame_t *f;
+    buf_t *b;
+    pcap_writer_t *w;
+
+    frame_spec(spec, sizeof(spec), frame_size);
+
+    // Paced TX replays a single frame file at a fixed rate
+    if (pps) {
+        struct timespec ts = {};
+
+        argc = argv_split(spec, argv, 128);
+        f = frame_alloc();
+        if (argc_frame(argc, argv, f) != argc) {
+            frame_free(f);
+            return -1;
+        }
+        b = frame_to_buf(f);
+        frame_free(f);
+
+        w = pcap_writer_open(pcap, 65535, 0);
+        res = !w || pcap_writer_write(w, pcap_writer_if(w, 0), &ts, b->data,
+                                      b->size) < 0;
+        if (w && pcap_writer_close(w) < 0)
+            res = 1;
+        bfree(b);
+        if (res)
+            return -1;
+
+        frame_spec(spec, sizeof(spec), frame_size);
+        len = snprintf(cmd, sizeof(cmd), "tx " VETH_TX " replay %s pps %"
+                       PRIu64 " loop %" PRIu64, pcap, pps, cnt);
+    } else {
+        len = snprintf(cmd, sizeof(cmd), "tx " VETH_TX " rep %" PRIu64 " %s",
+                       cnt, spec);
+    }
+
+    snprintf(cmd + len, sizeof(cmd) - len, " rx " VETH_RX " rep %" PRIu64
+             " %s", cnt, spec);
+
+    // The counters only grow, the test is the difference
+    tx_s = stats_if_get(VETH_TX);
+    rx_s = stats_if_get(VETH_RX);
+    if (!tx_s || !rx_s)
+        return -1;
+    tx0 = *tx_s;
+    rx0 = *rx_s;
+    tx_drop = read_u64("/sys/class/net/%s/statistics/tx_dropped", VETH_TX);
+
+    // The frames of a 'rep' are sent before any is read, so the time must
+    // cover both. The time of a replay counts from its end.
+    TIME_OUT_MS = pps ? 500 : 500 + cnt / 50;
+
+    argc = argv_split(cmd, argv, 128);
+    result_job_begin();
+    getrusage(RUSAGE_THREAD, &ru0);
+    clock_gettime(CLOCK_REALTIME, &ts0);
+    res = argc_cmds(argc, argv);
+    clock_gettime(CLOCK_REALTIME, &ts1);
+    getrusage(RUSAGE_THREAD, &ru1);
+    TIME_OUT_MS = timeout;
+
+    // ef listens for the whole timeout, so the rates are measured up to the
+    // times of the last frame sent (TX) and matched (RX-OK), if any
+    start = ts_to_sec(&ts0);
+    run_sec = tx_sec = rx_sec = ts_to_sec(&ts1) - start;
+    recs = result_job_recs(&rec_cnt);
+    for (i = 0; i < rec_cnt; ++i) {
+        t = recs[i].ts_sec + recs[i].ts_nsec / 1e9 - start;
+        if (t <= 0 || t > run_sec)
+            continue;
+
+        if (recs[i].type == RESULT_TX)
+            tx_sec = t;
+        else if (recs[i].type == RESULT_RX_OK)
+            rx_sec = t;
+    }
+    result_job_end(-1);
+
+    tx_drop = read_u64("/sys/class/net/%s/statistics/tx_dropped", VETH_TX) -
+              tx_drop;
+    tx_frames = tx_s->tx_frames - tx0.tx_frames;
+    tx_bytes = tx_s->tx_bytes - tx0.tx_bytes;
+    rx_frames = rx_s->rx_frames - rx0.rx_frames;
+    rx_bytes = rx_s->rx_bytes - rx0.rx_bytes;
+    rx_match = rx_s->rx_match - rx0.rx_match;
+
+    // A NO-RX or a drop is a result of the test, not a failure to run it
+    if (res < 0)
+        return -1;
+
+    // Frames are sent and received by this thread, the CPU time is of both
+    frames = tx_frames ? tx_frames : 1;
+
+    printf("%s    {\"mode\": \"%s\", \"frame_size\": %d, \"frames\": %" PRIu64
+           ", \"pps_target\": %" PRIu64 ", "
+           "\"tx_frames\": %" PRIu64 ", \"tx_errors\": %" PRIu64 ", "
+           "\"tx_pps\": %.0f, \"tx_gbps\": %.3f, "
+           "\"rx_frames\": %" PRIu64 ", \"rx_match\": %" PRIu64 ", "
+           "\"rx_unexpected\": %" PRIu64 ", "
+           "\"rx_pps\": %.0f, \"rx_gbps\": %.3f, "
+           "\"cpu_user_ns_per_frame\": %.1f, "
+           "\"cpu_sys_ns_per_frame\": %.1f, "
+           "\"rx_kernel_drops\": %d, \"veth_tx_drops\": %" PRIu64 ", "
+           "\"errors\": %d}",
+           first ? "" : ",\n", pps ? "paced" : "unpaced", frame_size, cnt,
+           pps, tx_frames, tx_s->tx_drop - tx0.tx_drop,
+           tx_frames / tx_sec, tx_bytes * 8.0 / tx_sec / 1e9,
+           rx_frames, rx_match, rx_s->rx_unexpected - rx0.rx_unexpected,
+           rx_match / rx_sec, rx_bytes * 8.0 / rx_sec / 1e9,
+           tv_ns(&ru0.ru_utime, &ru1.ru_utime) / frames,
+           tv_ns(&ru0.ru_stime, &ru1.ru_stime) / frames,
+           EXEC_HOST_DROPS, tx_drop, res);
+    fflush(stdout);
+
+    return 0;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Usage: ef-veth-bench [-n <frames>] [-p <pps>] [-s <size>,...]\n"
+            "  -n <frames>  Frames per test, default 100000\n"
+            "  -p <pps>     Rate of the paced tests, default 50000, 0 to\n"
+            "               skip them\n"
+            "  -s <sizes>   Frame sizes (without FCS), default 60,508,1514\n");
+}
+
+int main(int argc, char *argv[]) {
+    int opt, i, size_cnt = 0, sizes[16], first = 1, err = 0;
+    const char *size_list = "60,508,1514";
+    uint64_t cnt = 100000, pps = 50000;
+    char pcap[] = "/tmp/ef-veth-bench-XXXXXX.pcap";
+    char *p, *s;
+
+    while ((opt = getopt(argc, argv, "n:p:s:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                cnt = strtoull(optarg, 0, 0);
+                break;
+            case 'p':
+                pps = strtoull(optarg, 0, 0);
+                break;
+            case 's':
+                size_list = optarg;
+                break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    s = strdup(size_list);
+    for (p = strtok(s, ","); p && size_cnt < 16; p = strtok(0, ",")) {
+        sizes[size_cnt] = atoi(p);
+        if (sizes[size_cnt] < 60 || sizes[size_cnt] > 9000) {
+            fprintf(stderr, "Invalid frame size: %s\n", p);
+            return 1;
+        }
+        size_cnt++;
+    }
+    free(s);
+
+    if (cnt == 0 || netns_setup() < 0)
+        return 1;
+
+    i = mkstemps(pcap, 5);
+    if (i < 0) {
+        perror(pcap);
+        return 1;
+    }
+    close(i);
+
+    // The interface counters of ef are part of the measurement
+    stats_enable();
+
+    // The TX/RX lines of ef are not part of the report
+    PO_FD = open("/dev/null", O_WRONLY);
+    PE_FD = PO_FD;
+
+    printf("{\n  \"version\": \"%s\",\n  \"cpus\": %ld,\n  \"tests\": [\n",
+           gGIT_VERSION, sysconf(_SC_NPROCESSORS_ONLN));
+
+    for (i = 0; i < size_cnt; ++i) {
+        if (bench_one(sizes[i], cnt, 0, pcap, first) == 0)
+            first = 0;
+        else
+            err++;
+
+        if (!pps)
+            continue;
+
+        if (bench_one(sizes[i], cnt, pps, pcap, first) == 0)
+            first = 0;
+        else
+            err++;
+    }
+
+    printf("\n  ]\n}\n");
+    unlink(pcap);
+
+    if (err)
+        fprintf(stderr, "%d test(s) failed\n", err);
+
+    return err ? 1 : 0;
+}
@@ -6,7 +6,7 @@
 #include <stdio.h>
 
 int argc_frame(int argc, const char *argv[], frame_t *f) {
-    int i, j, res, offset;
+    int i, res, offset;
     hdr_t *h;
 
     if(argc > FRAME_STACK_MAX) {
@@ -27,14 +27,9 @@ int argc_frame(int argc, const char *argv[], frame_t *f) {
             return -1;
         }
 
-        h = 0;
-        for (j = 0; j < HDR_TMPL_SIZE; ++j) {
-            if (hdr_tmpls[j] && strcmp(argv[i], hdr_tmpls[j]->name) == 0) {
-                h = hdr_tmpls[j];
-                i++;
-                break;
-            }
-        }
+        h = hdr_tmpl_find(argv[i]);
+        if (h)
+            i++;
 
         if (!h) {
             //po("ERROR: Invalid parameter: %s\n", argv[i]);
@@ -42,7 +37,9 @@ int argc_frame(int argc, const char *argv[], frame_t *f) {
             return i;
         }
 
+        TIMING_ENTER(TIMING_CLONE, 0);
         h = frame_clone_and_push_hdr(f, h);
+        TIMING_LEAVE();
         if (!h) {
             po("ERROR: frame_clone_and_push_hdr() failed\n");
             return -1;
@@ -79,6 +76,24 @@ void cmd_destruct(cmd_t *c) {
     if (c->frame_mask_buf)
         bfree(c->frame_mask_buf);
 
+    if (c->replay)
+        replay_free(c->replay);
+
+    if (c->gen)
+        gen_free(c->gen);
+
+    if (c->expect)
+        free(c->expect);
+
+    if (c->lat)
+        free(c->lat);
+
+    if (c->seq)
+        free(c->seq);
+
+    if (c->rfc2544)
+        rfc2544_free(c->rfc2544);
+
     memset(c, 0, sizeof(*c));
 }
 
@@ -101,22 +116,104 @@ void print_help() {
     po("     as we must also check that no frames are received during\n");
     po("     the test.  Default is 100ms.\n");
     po("\n");
+    po("  -s <interval-in-ms>   Print statistics of each interface on\n");
+    po("     stderr at the given interval while tests run: TX and RX\n");
+    po("     frames/s and Mbit/s, and the number of matched and\n");
+    po("     unexpected frames, and of frames which could not be sent.\n");
+    po("\n");
+    po("  -f <file>             Run a batch of tests from <file> ('-' for stdin).\n");
+    po("     Each line holds the commands of one test, in the same\n");
+    po("     syntax as on the command-line. A line ending with '\\'\n");
+    po("     continues on the next line, and lines starting with '#'\n");
+    po("     are comments. A line may start with '-t <timeout-in-ms>'.\n");
+    po("     Interface sockets and named frames are kept between\n");
+    po("     tests, and the result of each test is reported as\n");
+    po("     TEST-OK, TEST-ERR or TEST-INCONCLUSIVE (see rx).\n");
+    po("\n");
+    po("  -d <socket>           Run as a daemon, serving jobs on the unix\n");
+    po("     socket <socket>. A job is a line in the same syntax as a\n");
+    po("     line in a batch file (-f). The output of the job is sent\n");
+    po("     back to the client, followed by a JSON line per result\n");
+    po("     record (the format of -o jsonl) and the line\n");
+    po("     'END <result>', where <result> is 0 if the job passed.\n");
+    po("     Sockets and named frames are kept between jobs. The\n");
+    po("     request 'quit' closes the connection, and 'shutdown'\n");
+    po("     stops the daemon.\n");
+    po("\n");
     po("  -c <if>,[<snaplen>],[<sync>],[<file>],[cnt]\n");
-    po("     Use tcpdump to capture traffic on an interface while the\n");
-    po("     test is running. If file is not specified, then it will\n");
-    po("     default to './<if>.pcap'\n");
+    po("     Capture traffic on an interface while the test is running.\n");
+    po("     If file is not specified, then it will default to\n");
+    po("     './<if>.pcap'. A file ending with '.pcapng' is written as\n");
+    po("     pcapng. The capture is done by ef itself, and stops\n");
+    po("     after <cnt> frames if specified. If <sync> is specified,\n");
     po("     tcpdump will be invoked with the following options:\n");
     po("     tcpdump -i <if> [-s <snaplen>] [-j <sync>] -w <file> -c <cnt>\n");
     po("\n");
+    po("  -o jsonl:<file> | bin:<file>\n");
+    po("     Write a record of each result (TX, RX-OK, RX-ERR, NO-RX) to\n");
+    po("     <file>, in addition to the text output. A record holds the\n");
+    po("     type, command index, interface, timestamp, frame length and\n");
+    po("     frame name. 'jsonl' writes a JSON object per line, 'bin'\n");
+    po("     writes fixed size records (see result_rec_t in ef.h).\n");
+    po("     Frames are time stamped by the NIC (hw) or the kernel (sw)\n");
+    po("     with SO_TIMESTAMPING, else by ef (host). The timestamps\n");
+    po("     are also shown on the TX and RX-OK lines, and used in\n");
+    po("     captures (-c).\n");
+    po("\n");
+    po("  -T                    Print a timing report on stderr at exit.\n");
+    po("     It holds the time spent in each phase (parse, clone,\n");
+    po("     frame-buf, socket, capture, tx, wait, rx, teardown) and on\n");
+    po("     each interface, the frames and bytes sent and received, the\n");
+    po("     syscall and allocation counts, and the getrusage() deltas.\n");
+    po("     Only if ef is built with TIMING_ENABLE (the default).\n");
+    po("\n");
     po("\n");
     po("Valid commands:\n");
     po("  tx: Transmit a frame on a interface. Syntax:\n");
     po("  tx <interface> FRAME | help\n");
+    po("  tx <interface> replay <file> [speed [x]<factor> | pps <cnt> | asap]\n");
+    po("     [loop <cnt>]\n");
+    po("     Transmit the frames of a pcap or pcapng file. By default the\n");
+    po("     recorded gaps are kept, 'speed' scales them, 'pps' sends at a\n");
+    po("     fixed rate and 'asap' drops them. 'loop' replays the file\n");
+    po("     <cnt> times.\n");
+    po("  tx <interface> [rep <cnt>] latency [<stream-id>] FRAME\n");
+    po("     Embed a signature (stream id, sequence number and TX time)\n");
+    po("     in the last 28 bytes of the payload of each frame, which\n");
+    po("     must end with at least 28 bytes of 'data'. The checksums of\n");
+    po("     the frame are kept valid. The stream id defaults to the\n");
+    po("     index of the command, and must differ between commands.\n");
     po("\n");
     po("  rx: Specify a frame which is expected to be received. If no \n");
     po("      frame is specified, then the expectation is that no\n");
-    po("      frames are received on the interface. Syntax:\n");
+    po("      frames are received on the interface. Instead of an\n");
+    po("      interface, 'file:<file>' checks the frames recorded in a\n");
+    po("      pcap or pcapng file. If the host drops frames on the\n");
+    po("      interface, the test fails as INCONCLUSIVE, as a NO-RX\n");
+    po("      may then not be caused by the DUT. The socket buffer is\n");
+    po("      sized for the frames sent in the test. Syntax:\n");
     po("  rx <interface> [FRAME] | help\n");
+    po("  rx <interface> rep <cnt> FRAME\n");
+    po("     Expect the frame <cnt> times. Like with 'tx ... rep', only\n");
+    po("     the last one is reported (RX-OK).\n");
+    po("  rx <interface> latency\n");
+    po("     Measure the latency of the frames received with a latency\n");
+    po("     signature, instead of matching them. The latency and the\n");
+    po("     jitter of each stream are printed at the end (LATENCY), with\n");
+    po("     percentiles up to p99.99 from a histogram, and the frames\n");
+    po("     lost, reordered, duplicated or late (SEQ). The latency is\n");
+    po("     measured with the kernel software timestamps, as the TX time\n");
+    po("     is taken from the system clock, not the clock of the NIC.\n");
+    po("  rx <interface> seq (rtag | htag | offset <offset> [bytes <cnt>])\n");
+    po("     Track the sequence numbers of the frames received in an R-TAG\n");
+    po("     (802.1CB), an HSR tag or a counter of 1, 2, 4 or 8 bytes at a\n");
+    po("     fixed offset, instead of matching them. The numbers are\n");
+    po("     tracked in a window of the last 4096, so the memory used does\n");
+    po("     not grow with the length of the test. Lost frames and\n");
+    po("     duplicates fail the test.\n");
+    po("  Example:\n");
+    po("  ef tx eth0 rep 10000 latency 1 eth ipv4 udp data pattern cnt 64\\\n");
+    po("     rx eth1 latency\n");
     po("\n");
     po("  hex: Print a frame on stdout as a hex string. Syntax:\n");
     po("  hex FRAME\n");
@@ -127,8 +224,53 @@ void print_help() {
     po("  name <name> FRAME-SPEC | help\n");
     po("\n");
     po("  pcap: Write a frame to a pcap file (appending if the file\n");
-    po("  exists already). Syntax:\n");
-    po("  pcap <file> FRAME | help\n");
+    po("  exists already). A file ending with '.pcapng' is written\n");
+    po("  as pcapng. Syntax:\n");
+    po("  pcap <file> [rep <cnt>] FRAME | help\n");
+    po("\n");
+    po("  gen: Write all variants of a frame to a pcap file. Any value\n");
+    po("  in the frame may be a range, '<first>..<last>', and a frame\n");
+    po("  is written for each combination of the values. The frames\n");
+    po("  are time stamped 1us apart. The file is overwritten, or\n");
+    po("  split in <cnt> files named <file>-000 etc. Syntax:\n");
+    po("  gen <file> [threads <cnt>] [shards <cnt>] FRAME\n");
+    po("  Example, every VID, PCP and DSCP:\n");
+    po("  ef gen c.pcap eth ctag vid 0..4095 pcp 0..7 ipv4 dscp 0..63\n");
+    po("\n");
+    po("  expect-<counter>: Check how much a kernel counter of an\n");
+    po("  interface changed during the test. <counter> is one of\n");
+    po("  rx-frames, tx-frames, rx-bytes, tx-bytes, rx-dropped,\n");
+    po("  tx-dropped, rx-errors and tx-errors, and <op> one of eq, ne,\n");
+    po("  ge, le, gt and lt, or ==, !=, >=, <=, > and < (which must be\n");
+    po("  quoted in a shell). The counters count all frames on the\n");
+    po("  interface, not only the ones sent by ef. The changes of all\n");
+    po("  the interfaces of a test are printed (LINK) if it uses\n");
+    po("  expect-<counter>, 'rep' or 'replay'. Syntax:\n");
+    po("  expect-<counter> <interface> <op> <cnt>\n");
+    po("  Example:\n");
+    po("  ef tx eth0 rep 1000000 eth ipv4 udp expect-rx-frames eth1 ge 1000000\n");
+    po("\n");
+    po("  rfc2544: Run the RFC 2544 benchmarks from <tx-if> to <rx-if>\n");
+    po("  through the DUT: throughput (binary search of the highest\n");
+    po("  rate without loss), latency at the throughput rate, frame loss\n");
+    po("  rate (from 100%% of the line rate in steps of 10%%) and\n");
+    po("  back-to-back (binary search of the longest burst without\n");
+    po("  loss), and print a table of the results. The frame is padded\n");
+    po("  with data to each frame size (with FCS, default 64, 128, 256,\n");
+    po("  512, 1024, 1280 and 1518). The frames received are counted per\n");
+    po("  trial, not matched. 'rate' is the line rate in Mbps (default\n");
+    po("  the speed of <tx-if>), 'duration' the time of a trial in ms\n");
+    po("  (default 1000), 'resolution' the precision of the searches in\n");
+    po("  percent (default 0.5), and 'burst' the longest burst (default\n");
+    po("  the frames of a trial). Latency needs 28 bytes of data. A trial\n");
+    po("  in which the host could not send or receive at the rate is\n");
+    po("  host-limited: it ends the search, is marked in the table, and\n");
+    po("  fails the benchmark. Syntax:\n");
+    po("  rfc2544 <tx-if> <rx-if> [sizes <size>,...] [rate <mbps>]\n");
+    po("     [duration <ms>] [resolution <pct>] [burst <cnt>]\n");
+    po("     [tests (throughput|latency|loss|b2b),...] FRAME\n");
+    po("  Example:\n");
+    po("  ef rfc2544 eth0 eth1 rate 1000 eth dmac ::1 smac ::2 ipv4 udp\n");
     po("\n");
     po("Where FRAME is either a frame specification of a named frame.\n");
     po("Syntax: FRAME ::= FRAME-SPEC | name <name>\n");
@@ -162,7 +304,8 @@ void print_help() {
     po("   Send a frame 1 million times:\n");
     po("   ef tx eth0 rep 1000000 eth dmac ::1 smac ::2\n");
     po("   Note that the repeat flag must follow the tx <interface> key-word\n");
-    po("   Results must be viewed through the PC or DUT interface counters, i.e. outside of 'ef'\n");
+    po("   Results must be viewed through the PC or DUT interface counters, i.e. with\n");
+    po("   'expect-<counter>', outside of 'ef', or as they go with '-s <interval-in-ms>'\n");
     po("\n");
 }
 
@@ -176,16 +319,20 @@ int argc_cmd(int argc, const char *argv[], cmd_t *c) {
 
     if (strcmp(argv[i], "name") == 0) {
         c->type = CMD_TYPE_NAME;
-#ifdef HAS_LIBPCAP
     } else if (strcmp(argv[i], "pcap") == 0) {
         c->type = CMD_TYPE_PCAP;
-#endif
+    } else if (strcmp(argv[i], "gen") == 0) {
+        c->type = CMD_TYPE_GEN;
     } else if (strcmp(argv[i], "hex") == 0) {
         c->type = CMD_TYPE_HEX;
     } else if (strcmp(argv[i], "rx") == 0) {
         c->type = CMD_TYPE_RX;
     } else if (strcmp(argv[i], "tx") == 0) {
         c->type = CMD_TYPE_TX;
+    } else if (strncmp(argv[i], "expect-", 7) == 0) {
+        c->type = CMD_TYPE_EXPECT;
+    } else if (strcmp(argv[i], "rfc2544") == 0) {
+        c->type = CMD_TYPE_RFC2544;
     } else if (strcmp(argv[i], "help") == 0) {
         print_help();
         return -1;
@@ -207,9 +354,10 @@ int argc_cmd(int argc, const char *argv[], cmd_t *c) {
         case CMD_TYPE_HEX: /* fallthrough */
             break;
 
-#ifdef HAS_LIBPCAP
+        case CMD_TYPE_EXPECT: /* fallthrough */
+        case CMD_TYPE_RFC2544: /* fallthrough */
+        case CMD_TYPE_GEN: /* fallthrough */
         case CMD_TYPE_PCAP: /* fallthrough */
-#endif
         case CMD_TYPE_RX: /* fallthrough */
         case CMD_TYPE_TX: /* fallthrough */
             c->arg0 = strdup(argv[i]);
@@ -220,14 +368,82 @@ int argc_cmd(int argc, const char *argv[], cmd_t *c) {
             ;
     }
 
-    if (c->type == CMD_TYPE_TX) {
+    if (c->type == CMD_TYPE_EXPECT) {
+        res = argc_link_expect(argc - i, argv + i, argv[0] + 7, &c->expect);
+        if (res < 0) {
+            cmd_destruct(c);
+            return -1;
+        }
+
+        return i + res;
+    }
+
+    if (c->type == CMD_TYPE_RFC2544) {
+        res = argc_rfc2544(argc - i, argv + i, &c->rfc2544);
+        if (res < 0) {
+            cmd_destruct(c);
+            return -1;
+        }
+
+        return i + res;
+    }
+
+    if (c->type == CMD_TYPE_GEN) {
+        res = argc_gen(argc - i, argv + i, &c->gen);
+        if (res < 0) {
+            cmd_destruct(c);
+            return -1;
+        }
+
+        return i + res;
+    }
+
+    if (c->type == CMD_TYPE_TX && i < argc && strcmp(argv[i], "replay") == 0) {
+        res = argc_replay(argc - i, argv + i, &c->replay);
+        if (res < 0) {
+            cmd_destruct(c);
+            return -1;
+        }
+
+        return i + res;
+    }
+
+    if (c->type == CMD_TYPE_TX || c->type == CMD_TYPE_PCAP ||
+        c->type == CMD_TYPE_RX) {
         c->repeat = 1;
-        if (strcmp(argv[i], "rep") == 0 || strcmp(argv[i], "repeat") == 0) {
+        if (i + 1 < argc &&
+            (strcmp(argv[i], "rep") == 0 || strcmp(argv[i], "repeat") == 0)) {
             c->repeat = atoi(argv[i+1]);
             i += 2;
         }
     }
 
+    if (c->type == CMD_TYPE_TX && i < argc && strcmp(argv[i], "latency") == 0) {
+        res = argc_latency(argc - i, argv + i, &c->lat);
+        if (res < 0) {
+            cmd_destruct(c);
+            return -1;
+        }
+
+        i += res;
+    }
+
+    // Frames with a latency signature are accounted, not matched
+    if (c->type == CMD_TYPE_RX && i < argc && strcmp(argv[i], "latency") == 0) {
+        c->lat_rx = 1;
+        return i + 1;
+    }
+
+    if (c->type == CMD_TYPE_RX && i < argc && strcmp(argv[i], "seq") == 0) {
+        res = argc_seq(argc - i, argv + i, &c->seq);
+        if (res < 0) {
+            cmd_destruct(c);
+            return -1;
+        }
+
+        return i + res;
+    }
+
     //po("%d, i=%d/%d %s\n", __LINE__, i, argc, argv[i]);
     if (i + 1 < argc && strcmp(argv[i], "name") == 0 &&
         c->type != CMD_TYPE_NAME) {
@@ -257,10 +473,12 @@ int argc_cmd(int argc, const char *argv[], cmd_t *c) {
     }
 
     if (c->frame) {
+        TIMING_ENTER(TIMING_FRAME_BUF, 0);
         c->frame_buf = frame_to_buf(c->frame);
 
         if (c->frame->has_mask)
             c->frame_mask_buf = frame_mask_to_buf(c->frame);
+        TIMING_LEAVE();
     }
 
     i += res;
@@ -272,9 +490,10 @@ int argc_cmd(int argc, const char *argv[], cmd_t *c) {
 int argc_cmds(int argc, const char *argv[]) {
     struct timeval tv_now, tv_left, tv_begin, tv_end;
 
-    int res, i = 0, cmd_idx = 0;
+    int res, capture, i = 0, cmd_idx = 0;
     cmd_t cmds[100] = {};
 
+    TIMING_ENTER(TIMING_PARSE, 0);
     while (i < argc && cmd_idx < 100) {
         //po("%d, cmd[%d]\n", __LINE__, cmd_idx);
         res = argc_cmd(argc - i, argv + i, &cmds[cmd_idx]);
@@ -287,17 +506,24 @@ int argc_cmds(int argc, const char *argv[]) {
             break;
 
         } else {
-            return -1;
+            TIMING_LEAVE();
+            res = -1;
+            goto out;
 
         }
     }
+    TIMING_LEAVE();
 
     if (i != argc) {
         po("Parse error! arg# %d out of %d, cmd_idx = %d\n", i, argc, cmd_idx);
-        return -1;
+        res = -1;
+        goto out;
     }
 
-    capture_all_start();
+    // Within a session (batch mode) the capture spans all the tests
+    capture = !exec_session_active() && capture_cnt() > 0;
+    if (capture)
+        capture_all_start();
 
     tv_left.tv_sec = TIME_OUT_MS / 1000;
     tv_left.tv_usec = (TIME_OUT_MS - (tv_left.tv_sec * 1000)) * 1000;
@@ -310,17 +536,26 @@ int argc_cmds(int argc, const char *argv[]) {
     // specified. We need to sleep the the deceired time if we are capturing
     // interfaces.
     gettimeofday(&tv_now, 0);
-    if (capture_cnt() > 0 && timercmp(&tv_now, &tv_end, <)) {
+    if (capture && timercmp(&tv_now, &tv_end, <)) {
+        TIMING_ENTER(TIMING_CAPTURE, 0);
         timersub(&tv_end, &tv_now, &tv_left);
         sleep(tv_left.tv_sec);
         usleep(tv_left.tv_usec);
+        TIMING_LEAVE();
     }
 
-    capture_all_stop();
+    if (capture)
+        capture_all_stop();
 
-    for (i = 0; i < cmd_idx; ++i) {
+out:
+    // A failing argc_cmd() may leave a partly parsed command behind
+    TIMING_ENTER(TIMING_TEARDOWN, 0);
+    for (i = 0; i <= cmd_idx && i < 100; ++i) {
         cmd_destruct(&cmds[i]);
     }
+    TIMING_LEAVE();
+
+    out_flush();
 
     return res;
 }
@@ -328,9 +563,12 @@ int argc_cmds(int argc, const char *argv[]) {
 int TIME_OUT_MS = 100;
 
 int main_(int argc, const char *argv[]) {
-    int opt;
+    int opt, res;
+    const char *batch = 0, *daemon = 0;
 
-    while ((opt = getopt(argc, (char * const*)argv, "vht:c:")) != -1) {
+    out_signals_init();
+
+    while ((opt = getopt(argc, (char * const*)argv, "vhTt:s:c:f:d:o:")) != -1) {
         switch (opt) {
             case 'v':
                 print_version();
@@ -340,10 +578,20 @@ int main_(int argc, const char *argv[]) {
                 print_help();
                 return -1;
 
+            case 'T':
+                if (timing_enable())
+                    return -1;
+                break;
+
             case 't':
                 TIME_OUT_MS = atoi(optarg);
                 break;
 
+            case 's':
+                if (stats_start(atoi(optarg)))
+                    return -1;
+                break;
+
             case 'c':
                 if (capture_add(optarg)) {
                     po("ERROR adding capture interface\n");
@@ -351,12 +599,44 @@ int main_(int argc, const char *argv[]) {
                 }
                 break;
 
+            case 'f':
+                batch = optarg;
+                break;
+
+            case 'd':
+                daemon = optarg;
+                break;
+
+            case 'o':
+                if (result_sink_open(optarg))
+                    return -1;
+                break;
+
             default: /* '?' */
                 print_help();
                 return -1;
         }
     }
 
-    return argc_cmds(argc - optind, argv + optind);
+    if (batch || daemon) {
+        if (optind != argc || (batch && daemon)) {
+            po("ERROR: -f and -d can not be combined with other commands\n");
+            res = -1;
+        } else if (daemon) {
+            res = daemon_run(daemon);
+        } else {
+            res = batch_run(batch);
+        }
+    } else {
+        res = argc_cmds(argc - optind, argv + optind);
+    }
+
+    stats_stop();
+    result_sink_close();
+
+    timing_report();
+    out_flush();
+
+    return res;
 }
 
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <limits.h>
+#include "ef.h"
+
+#define BATCH_ARGS_MAX 4096
+
+// Split a string into words, like a shell would do it (without expansions).
+// Words are separated by white-space, and may be quoted with ' or ". Outside
+// of single quotes, a backslash escapes the next character. The string is
+// modified in place, and the words in argv are pointing into it.
+//
+// Returns the number of words, or -1 on error.
+int argv_split(char *s, const char *argv[], int argv_max) {
+    int argc = 0;
+    char quote;
+    char *o;
+
+    while (1) {
+        while (isspace((unsigned char)*s))
+            s++;
+
+        if (!*s)
+            break;
+
+        if (argc + 1 >= argv_max) {
+            po("ERROR: Too many arguments\n");
+            return -1;
+        }
+
+        argv[argc++] = o = s;
+        quote = 0;
+
+        for (; *s; s++) {
+            if (quote) {
+                if (*s == quote) {
+                    quote = 0;
+                    continue;
+                }
+
+                if (quote == '"' && *s == '\\' && s[1])
+                    s++;
+
+            } else if (*s == '\'' || *s == '"') {
+                quote = *s;
+                continue;
+
+            } else if (*s == '\\' && s[1]) {
+                s++;
+
+            } else if (isspace((unsigned char)*s)) {
+                break;
+            }
+
+            *o++ = *s;
+        }
+
+        if (quote) {
+            po("ERROR: Missing closing %c\n", quote);
+            return -1;
+        }
+
+        if (*s)
+            s++;
+
+        *o = 0;
+    }
+
+    argv[argc] = 0;
+
+    return argc;
+}
+
+// Run a single job given as a string, in the same syntax as the command-line.
+// The job may start with '-t <timeout-in-ms>' which only applies to this job.
+int batch_job(char *s) {
+    int res, argc, timeout = TIME_OUT_MS;
+    const char *argv_[BATCH_ARGS_MAX];
+    const char **argv = argv_;
+    char *end;
+    long t;
+
+    EXEC_HOST_DROPS = 0;
+    argc = argv_split(s, argv, BATCH_ARGS_MAX);
+
+    if (argc >= 1 && strcmp(argv[0], "-t") == 0) {
+        t = argc >= 2 ? strtol(argv[1], &end, 0) : -1;
+        if (t < 0 || t > INT_MAX || end == argv[1] || *end) {
+            po("ERROR: Invalid timeout: %s\n", argc >= 2 ? argv[1] : "");
+            return -1;
+        }
+
+        TIME_OUT_MS = t;
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc < 0) {
+        res = -1;
+    } else {
+        res = argc_cmds(argc, argv);
+    }
+
+    TIME_OUT_MS = timeout;
+
+    return res;
+}
+
+static int batch_test(char *s, int idx, int line_no) {
+    int res = batch_job(s);
+
+    if (res == 0) {
+        po("TEST-OK  %5d: line %d\n", idx, line_no);
+    } else if (EXEC_HOST_DROPS) {
+        pe("TEST-INCONCLUSIVE %5d: line %d\n", idx, line_no);
+    } else {
+        pe("TEST-ERR %5d: line %d\n", idx, line_no);
+    }
+
+    // Let the harness see the result of each test as it completes
+    out_flush();
+
+    return res;
+}
+
+int is_blank_or_comment(const char *s) {
+    while (isspace((unsigned char)*s))
+        s++;
+
+    return *s == 0 || *s == '#';
+}
+
+int batch_run(const char *path) {
+    FILE *f;
+    ssize_t len;
+    size_t line_cap = 0;
+    char *line = 0;
+    buf_t *test = 0, *tmp;
+    int line_no = 0, test_line = 0, test_cnt = 0, err_cnt = 0, cont;
+
+    if (strcmp(path, "-") == 0) {
+        f = stdin;
+    } else {
+        f = fopen(path, "r");
+        if (!f) {
+            po("ERROR: Could not open %s: %m\n", path);
+            return -1;
+        }
+    }
+
+    exec_session_begin();
+    if (capture_cnt() > 0)
+        capture_all_start();
+
+    while (1) {
+        len = getline(&line, &line_cap, f);
+
+        if (len >= 0) {
+            line_no++;
+
+            while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+                line[--len] = 0;
+
+            cont = len > 0 && line[len - 1] == '\\';
+            if (cont)
+                line[--len] = 0;
+
+            if (!test) {
+                test = bprintf("%s", line);
+                test_line = line_no;
+            } else {
+                tmp = bprintf("%s %s", (char *)test->data, line);
+                bfree(test);
+                test = tmp;
+            }
+
+            if (!test) {
+                err_cnt++;
+                break;
+            }
+
+            if (cont)
+                continue;
+
+        } else if (!test) {
+            break;
+        }
+
+        if (!is_blank_or_comment((char *)test->data)) {
+            test_cnt++;
+            if (batch_test((char *)test->data, test_cnt, test_line) != 0)
+                err_cnt++;
+        }
+
+        bfree(test);
+        test = 0;
+
+        if (len < 0)
+            break;
+    }
+
+    if (capture_cnt() > 0)
+        capture_all_stop();
+    exec_session_end();
+
+    free(line);
+    if (f != stdin)
+        fclose(f);
+
+    po("BATCH: %d tests, %d failed\n", test_cnt, err_cnt);
+
+    return err_cnt > 255 ? 255 : err_cnt;
+}
@@ -1,13 +1,36 @@
 #include "ef.h"
 #include <stdio.h>
+#include <errno.h>
+#include <signal.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct buf_map {
+    int     ref;
+    void   *addr;
+    size_t  len;
+};
+
+static void bmap_put(struct buf_map *m) {
+    if (--m->ref)
+        return;
+
+    munmap(m->addr, m->len);
+    free(m);
+}
 
 void bfree(buf_t *b) {
     if (!b)
         return;
 
+    if (b->map)
+        bmap_put(b->map);
+
     free(b);
 }
 
@@ -16,6 +39,7 @@ buf_t *balloc(size_t size) {
     uint8_t *d;
 
     d = (uint8_t *)calloc(1, sizeof(buf_t) + size);
+    TIMING_CNT(TIMING_CNT_ALLOC, 1);
     if (!d)
         return 0;
 
@@ -30,6 +54,20 @@ buf_t *bclone(const buf_t *b) {
     if (!b)
         return 0;
 
+    // Mapped buffers are never written, so the clone can share the mapping
+    if (b->map) {
+        buf_t *bb = balloc(0);
+        if (!bb)
+            return 0;
+
+        bb->size = b->size;
+        bb->data = b->data;
+        bb->map = b->map;
+        bb->map->ref++;
+
+        return bb;
+    }
+
     buf_t *bb = balloc(b->size);
     if (!bb)
         return 0;
@@ -39,6 +77,76 @@ buf_t *bclone(const buf_t *b) {
     return bb;
 }
 
+// Map len bytes at offset of the file at path. If len is zero, then the rest of
+// the file is mapped. The data is not copied until the buffer is written
+// somewhere else, but it must not be modified.
+buf_t *bmap_file(const char *path, size_t offset, size_t len) {
+    long page = sysconf(_SC_PAGESIZE);
+    struct buf_map *m;
+    struct stat st;
+    size_t skew;
+    buf_t *b;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        po("ERROR: Could not open %s: %m\n", path);
+        return 0;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        po("ERROR: Could not stat %s: %m\n", path);
+        close(fd);
+        return 0;
+    }
+
+    if (offset > (size_t)st.st_size ||
+        (len && len > (size_t)st.st_size - offset)) {
+        po("ERROR: %zu bytes at offset %zu is beyond the end of %s (%zu bytes)\n",
+           len, offset, path, (size_t)st.st_size);
+        close(fd);
+        return 0;
+    }
+
+    if (!len)
+        len = st.st_size - offset;
+
+    if (!len) {
+        po("ERROR: No data in %s\n", path);
+        close(fd);
+        return 0;
+    }
+
+    b = balloc(0);
+    m = calloc(1, sizeof(*m));
+    if (!b || !m) {
+        close(fd);
+        bfree(b);
+        free(m);
+        return 0;
+    }
+
+    // The mapping must start on a page boundary
+    skew = offset % page;
+    m->len = len + skew;
+    m->addr = mmap(0, m->len, PROT_READ, MAP_PRIVATE, fd, offset - skew);
+    close(fd);
+
+    if (m->addr == MAP_FAILED) {
+        po("ERROR: Could not map %s: %m\n", path);
+        bfree(b);
+        free(m);
+        return 0;
+    }
+
+    m->ref = 1;
+    b->map = m;
+    b->data = (uint8_t *)m->addr + skew;
+    b->size = len;
+
+    return b;
+}
+
 int bequal(const buf_t *a, const buf_t *b) {
     if ((a && !b) || (!a && b))
         return 0;
@@ -90,95 +198,179 @@ int bequal_mask(const buf_t *rx_frame, const buf_t *expected_frame,
     return 1;
 }
 
-void ble_free(buf_list_element_t *b) {
-    if (!b)
-        return;
+///////////////////////////////////////////////////////////////////////////////
+// Output buffering. All output from po(), pe() and print_hex_str() goes through
+// a single buffer, which is written when it is full, when output is switching
+// to another file descriptor, or on out_flush(). Switching file descriptors
+// flushes such that stdout and stderr keep their relative order when they are
+// sent to the same place.
+#define OUT_BUF_SIZE (64 * 1024)
+
+static struct {
+    int    fd;
+    size_t len;
+    char   data[OUT_BUF_SIZE];
+} OUT = { .fd = -1 };
+
+static int write_all(int fd, const char *d, size_t len) {
+    ssize_t res;
+
+    while (len) {
+        res = write(fd, d, len);
+        TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
 
-    if (b->next)
-        ble_free(b->next);
+        d += res;
+        len -= res;
+    }
 
-    free(b);
+    return 0;
 }
 
-buf_list_element_t *ble_alloc(size_t size) {
-    buf_list_element_t *b;
-    uint8_t *d;
+int out_flush() {
+    int res = 0;
 
-    d = (uint8_t *)calloc(1, sizeof(buf_list_element_t) + size);
-    if (!d)
-        return 0;
+    if (OUT.len)
+        res = write_all(OUT.fd, OUT.data, OUT.len);
 
-    b = (buf_list_element_t *)d;
-    b->next = 0;
-    b->buf.size = size;
-    b->buf.data = d + sizeof(buf_list_element_t);
+    OUT.len = 0;
 
-    return b;
-};
-
-buf_list_element_t *ble_tail(buf_list_element_t *head) {
-    while (head->next)
-        head = head->next;
+    return res;
+}
 
-    return head;
+static void out_fini() __attribute__ ((destructor));
+static void out_fini() {
+    out_flush();
 }
 
-buf_list_element_t *ble_append(buf_list_element_t *head,
-                               buf_list_element_t *e) {
-    ble_tail(head)->next = e;
-    return e;
+// Write what is buffered before the process dies from a termination signal.
+// Only write() is used, and a line being added when the signal came is lost.
+static void out_signal(int sig) {
+    const char *d = OUT.data;
+    size_t len = OUT.len;
+    ssize_t res;
+
+    OUT.len = 0;
+    while (len && OUT.fd >= 0) {
+        res = write(OUT.fd, d, len);
+        if (res <= 0)
+            break;
+
+        d += res;
+        len -= res;
+    }
+
+    signal(sig, SIG_DFL);
+    raise(sig);
 }
 
-buf_list_element_t *ble_append_buf(buf_list_element_t *head, buf_t *e) {
-    buf_list_element_t *le = ble_alloc(e->size);
+void out_signals_init() {
+    struct sigaction act = {};
 
-    if (!le)
-        return 0;
+    act.sa_handler = out_signal;
+    sigaction(SIGINT, &act, 0);
+    sigaction(SIGTERM, &act, 0);
+    sigaction(SIGHUP, &act, 0);
+}
 
-    memcpy(le->buf.data, e->data, e->size);
-    bfree(e);
+// Make #fd the owner of the buffer, and return the free space
+static size_t out_select(int fd) {
+    if (OUT.fd != fd) {
+        out_flush();
+        OUT.fd = fd;
+    }
 
-    return ble_append(head, le);
+    return OUT_BUF_SIZE - OUT.len;
 }
 
-void bl_reset(buf_list_t *b) {
-    ble_free(b->head);
-    memset(b, 0, sizeof(*b));
+int out_write(int fd, const void *d, size_t len) {
+    if (out_select(fd) < len) {
+        out_flush();
+
+        if (len > OUT_BUF_SIZE)
+            return write_all(fd, d, len);
+    }
+
+    memcpy(OUT.data + OUT.len, d, len);
+    OUT.len += len;
+
+    return 0;
 }
 
-void bl_check(buf_list_t *b) {
-    size_t s;
-    buf_list_element_t *head;
+int out_vprintf(int fd, const char *fmt, va_list ap) {
+    int res;
+    char *s;
+    va_list ap2;
+    size_t free_space = out_select(fd);
 
-    if (!b)
-        return;
+    va_copy(ap2, ap);
+    res = vsnprintf(OUT.data + OUT.len, free_space, fmt, ap2);
+    va_end(ap2);
+
+    if (res < 0)
+        return res;
 
-    assert(b->capacity >= b->size);
+    if ((size_t)res < free_space) {
+        OUT.len += res;
+        return res;
+    }
 
-    // Check that sum of all elements matches the list capacity
-    s = 0;
-    head = b->head;
-    while (head) {
-        s += head->buf.size;
-        head = head->next;
+    // Did not fit (vsnprintf needs room for the terminating zero as well)
+    out_flush();
+    if ((size_t)res < OUT_BUF_SIZE) {
+        vsnprintf(OUT.data, OUT_BUF_SIZE, fmt, ap);
+        OUT.len = res;
+        return res;
     }
 
-    assert(s == b->capacity);
+    s = malloc(res + 1);
+    if (!s)
+        return -1;
+
+    vsnprintf(s, res + 1, fmt, ap);
 
-    // Check that the free capacity is smaller than the lastest block
-    if (b->capacity > b->size) {
-        assert((b->capacity - b->size) < ble_tail(b->head)->buf.size);
+    out_write(fd, s, res);
+    free(s);
+
+    return res;
+}
+
+int out_hex(int fd, const void *d, size_t len) {
+    size_t n, free_space;
+    const uint8_t *p = (const uint8_t *)d;
+
+    while (len) {
+        free_space = out_select(fd);
+        if (free_space < 2) {
+            out_flush();
+            continue;
+        }
+
+        n = free_space / 2;
+        if (n > len)
+            n = len;
+
+        hex_encode(OUT.data + OUT.len, p, n);
+        OUT.len += 2 * n;
+        p += n;
+        len -= n;
     }
 
-    // Check that assert is turned on
-    assert(0);
+    return 0;
 }
 
+int PO_FD = 1;
+int PE_FD = 2;
+
 int po(const char *fmt, ...) {
     int res;
     va_list ap;
     va_start(ap, fmt);
-    res = vdprintf(1, fmt, ap);
+    res = out_vprintf(PO_FD, fmt, ap);
     va_end(ap);
     return res;
 }
@@ -187,71 +379,11 @@ int pe(const char *fmt, ...) {
     int res;
     va_list ap;
     va_start(ap, fmt);
-    res = vdprintf(2, fmt, ap);
+    res = out_vprintf(PE_FD, fmt, ap);
     va_end(ap);
     return res;
 }
 
-int bl_printf_append(buf_list_t *b, const char *fmt, ...) {
-    char *data_end;
-    va_list ap;
-    int res;
-    size_t str_size;
-    size_t free_space;
-    size_t alloc_size;
-    buf_list_element_t *tail, *new_element;
-
-    bl_check(b);
-
-    free_space = b->capacity - b->size;
-    if (free_space) {
-        tail = ble_tail(b->head);
-        data_end = (char *)tail->buf.data + tail->buf.size - free_space;
-    } else {
-        data_end = 0;
-    }
-
-    va_start(ap, fmt);
-    res = vsnprintf(data_end, free_space, fmt, ap);
-    va_end(ap);
-
-    if (res < 0)
-        return res;
-
-    str_size = (size_t)res;
-
-    if (str_size <= free_space) {
-        b->size += str_size;
-        bl_check(b);
-
-        return str_size;
-    }
-
-    alloc_size = 4096;
-    if (str_size > alloc_size)
-        alloc_size = str_size;
-
-    new_element = ble_alloc(alloc_size);
-    if (!new_element)
-        return -1;
-
-    va_start(ap, fmt);
-    str_size = vsnprintf((char *)new_element->buf.data, alloc_size, fmt, ap);
-    va_end(ap);
-
-    if (free_space) {
-        memcpy(data_end, new_element->buf.data, free_space);
-        memmove(new_element->buf.data, new_element->buf.data + free_space,
-                str_size - free_space);
-    }
-
-    b->size += str_size;
-    b->capacity += alloc_size;
-    bl_check(b);
-
-    return str_size;
-}
-
 buf_t *bprintf(const char *fmt, ...) {
     buf_t *b;
     va_list ap;
@@ -3,8 +3,14 @@
 #include <unistd.h>
 #include <signal.h>
 #include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
 #include "ef.h"
 
+extern char **environ;
+
 
 static struct capture *HEAD = 0;
 
@@ -34,25 +40,91 @@ static void capture_push(struct capture *c) {
     p->next = c;
 }
 
-static struct capture * capture_by_pid(pid_t pid) {
-    struct capture *p = HEAD;
+// tcpdump's default snaplen
+#define CAPTURE_SNAPLEN_DEFAULT 262144
 
-    while (p) {
-        if (p->pid == pid)
-            return p;
+#define CAPTURE_ARGV_MAX         16
+#define CAPTURE_READY_TIMEOUT_MS 10000
+#define CAPTURE_STOP_TIMEOUT_MS  10000
 
-        p = p->next;
-    }
+static void capture_argv_free(char **argv) {
+    char **p;
 
-    return 0;
+    if (!argv)
+        return;
+
+    for (p = argv; *p; ++p)
+        free(*p);
+
+    free(argv);
 }
 
+static void capture_free(struct capture *c) {
+    capture_argv_free(c->tcpdump_argv);
+    if (c->err_fd >= 0)
+        close(c->err_fd);
+    free(c->ifname);
+    free(c->file);
+    free(c);
+}
+
+// Build the tcpdump arguments for captures which can not be done in-process.
+// tcpdump is asked to deliver and write each frame as it arrives, such that the
+// file is complete when it exits on SIGINT.
+static char **capture_tcpdump_argv(const char *s_elements[5],
+                                   const char *file) {
+    const char *a[CAPTURE_ARGV_MAX];
+    char **argv;
+    int i, argc = 0;
+
+    a[argc++] = "tcpdump";
+    a[argc++] = "--immediate-mode";
+    a[argc++] = "-U";
+    a[argc++] = "-i";
+    a[argc++] = s_elements[0];
+
+    // snaplen
+    if (s_elements[1] && *s_elements[1]) {
+        a[argc++] = "-s";
+        a[argc++] = s_elements[1];
+    }
+
+    // sync
+    if (s_elements[2] && *s_elements[2]) {
+        a[argc++] = "-j";
+        a[argc++] = s_elements[2];
+    }
+
+    // file
+    a[argc++] = "-w";
+    a[argc++] = file;
+
+    // Count
+    if (s_elements[4] && *s_elements[4]) {
+        a[argc++] = "-c";
+        a[argc++] = s_elements[4];
+    }
+
+    argv = calloc(argc + 1, sizeof(char *));
+    if (!argv)
+        return 0;
+
+    for (i = 0; i < argc; ++i) {
+        argv[i] = strdup(a[i]);
+        if (!argv[i]) {
+            capture_argv_free(argv);
+            return 0;
+        }
+    }
+
+    return argv;
+}
 
 int capture_add(char *s) {
-    // <if>,[<snaplen>],[<sync>],[<file>]
+    // <if>,[<snaplen>],[<sync>],[<file>],[<cnt>]
     const char *s_elements[5] = {};
     struct capture *c;
-    buf_t *b, *b_old, *b_tmp;
+    buf_t *b_tmp;
     int i = 0;
     char *p;
 
@@ -67,30 +139,32 @@ int capture_add(char *s) {
         }
     }
 
-    if (s_elements[0]) {
-        b = bprintf("tcpdump -i %s", s_elements[0]);
-    } else {
+    if (!s_elements[0] || !*s_elements[0])
         return -1;
-    }
+
+    c = calloc(1, sizeof(*c));
+    if (!c)
+        return -1;
+
+    c->fd = -1;
+    c->err_fd = -1;
+    c->ifname = strdup(s_elements[0]);
+    c->snaplen = CAPTURE_SNAPLEN_DEFAULT;
 
     // snaplen
     if (s_elements[1] && *s_elements[1]) {
-        b_old = b;
-        b = bprintf("%s -s %s", b_old->data, s_elements[1]);
-        bfree(b_old);
-        b_old = 0;
-        if (!b)
+        if (parse_uint32(s_elements[1], &c->snaplen) != 0 || !c->snaplen) {
+            capture_free(c);
             return -1;
+        }
     }
 
-    // sync
-    if (s_elements[2] && *s_elements[2]) {
-        b_old = b;
-        b = bprintf("%s -j %s", b_old->data, s_elements[2]);
-        bfree(b_old);
-        b_old = 0;
-        if (!b)
+    // Count
+    if (s_elements[4] && *s_elements[4]) {
+        if (parse_uint32(s_elements[4], &c->cnt) != 0) {
+            capture_free(c);
             return -1;
+        }
     }
 
     // file
@@ -99,188 +173,325 @@ int capture_add(char *s) {
     } else {
         b_tmp = bprintf("%s.pcap", s_elements[0]);
     }
-    // pcap is not overwriting!!!
-    unlink((char *)b_tmp->data);
 
-    b_old = b;
-    b = bprintf("%s -w %s", b_old->data, b_tmp->data);
-    bfree(b_old);
-    bfree(b_tmp);
-    b_tmp = 0;
-    b_old = 0;
-    if (!b)
+    if (!b_tmp) {
+        capture_free(c);
         return -1;
+    }
 
-    // Count
-    if (s_elements[4] && *s_elements[4]) {
-        b_old = b;
-        b = bprintf("%s -c %s", b_old->data, s_elements[4]);
-        bfree(b_old);
-        b_old = 0;
-        if (!b)
+    c->file = strdup((char *)b_tmp->data);
+    bfree(b_tmp);
+
+    // pcap is not overwriting!!!
+    unlink(c->file);
+
+    // Time stamp types are a property of the libpcap/tcpdump capture, in
+    // which case we still need to invoke tcpdump.
+    if (s_elements[2] && *s_elements[2]) {
+        c->tcpdump_argv = capture_tcpdump_argv(s_elements, c->file);
+        if (!c->tcpdump_argv) {
+            capture_free(c);
             return -1;
+        }
     }
 
+    capture_push(c);
 
-    //b_old = b;
-    //b = bprintf("%s > /dev/null", b_old->data);
-    //bfree(b_old);
-    //b_old = 0;
+    return 0;
+}
 
+// Forward what tcpdump writes on stderr, and look for the line telling that it
+// is ready to capture. Returns the number of bytes read, 0 on end-of-file and
+// -1 if nothing was read within the timeout.
+static int capture_stderr_read(struct capture *c, int timeout_ms) {
+    struct pollfd pfd = {};
+    char buf[256];
+    ssize_t i, res;
 
-    c = calloc(1, sizeof(*c));
+    if (c->err_fd < 0)
+        return 0;
 
-    if (!c) {
-        bfree(b);
+    pfd.fd = c->err_fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout_ms) <= 0)
         return -1;
+
+    res = read(c->err_fd, buf, sizeof(buf));
+    if (res <= 0) {
+        close(c->err_fd);
+        c->err_fd = -1;
+        return 0;
     }
 
-    c->tcpdump_cmd = b;
-    capture_push(c);
+    pe("%.*s", (int)res, buf);
+
+    for (i = 0; i < res; ++i) {
+        if (buf[i] == '\n' || c->err_line_len == sizeof(c->err_line) - 1) {
+            c->err_line[c->err_line_len] = 0;
+            if (strstr(c->err_line, "listening on"))
+                c->ready = 1;
+            c->err_line_len = 0;
+        } else {
+            c->err_line[c->err_line_len++] = buf[i];
+        }
+    }
+
+    return res;
+}
+
+static int capture_start(struct capture *c) {
+    int i, res, pipe_fd[2];
+    posix_spawn_file_actions_t fa;
+
+    if (pipe(pipe_fd) < 0) {
+        po("%s:%d pipe error: %m\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, pipe_fd[1], 2);
+    posix_spawn_file_actions_addclose(&fa, pipe_fd[0]);
+    posix_spawn_file_actions_addclose(&fa, pipe_fd[1]);
+    res = posix_spawnp(&c->pid, c->tcpdump_argv[0], &fa, 0, c->tcpdump_argv,
+                       environ);
+    posix_spawn_file_actions_destroy(&fa);
+    close(pipe_fd[1]);
+
+    if (res != 0) {
+        errno = res;
+        po("ERROR: Failed to start %s: %m\n", c->tcpdump_argv[0]);
+        close(pipe_fd[0]);
+        return -1;
+    }
+
+    c->err_fd = pipe_fd[0];
+    c->err_line_len = 0;
+    c->ready = 0;
+    c->running = 1;
+
+    po("PID %d ->", c->pid);
+    for (i = 0; c->tcpdump_argv[i]; ++i)
+        po(" %s", c->tcpdump_argv[i]);
+    po("\n");
 
     return 0;
 }
 
-void signal_empty(int sig) {
+static int elapsed_ms(const struct timespec *begin) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - begin->tv_sec) * 1000 +
+           (now.tv_nsec - begin->tv_nsec) / 1000000;
 }
 
-void signal_child(int sig) {
-    struct capture *c;
+// Wait for tcpdump to tell that it is listening
+static int capture_wait_ready(struct capture *c) {
+    struct timespec begin;
+    int left;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    while (!c->ready) {
+        left = CAPTURE_READY_TIMEOUT_MS - elapsed_ms(&begin);
+        if (left <= 0 || capture_stderr_read(c, left) == 0) {
+            po("ERROR: tcpdump on %s did not get ready\n", c->ifname);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Wait for tcpdump to exit, while forwarding its output. Returns 0 when the
+// process is reaped.
+static int capture_wait_exit(struct capture *c, int timeout_ms) {
+    struct timespec begin;
     int status;
-    pid_t p;
 
-    while (1) {
-        p = waitpid(-1, &status, WNOHANG);
-        if (p <= 0)
-            return;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
 
-        c = capture_by_pid(p);
-        if (c) {
+    while (c->running) {
+        if (waitpid(c->pid, &status, WNOHANG) == c->pid) {
+            c->running = 0;
             if (WIFEXITED(status)) {
-                int res = WEXITSTATUS(status);
-                c->running = 0;
-                if (c->res == 0)
-                    c->success = 1;
-                po("PID %d exited with code %d\n", p, res);
+                po("PID %d exited with code %d\n", c->pid,
+                   WEXITSTATUS(status));
             } else if (WIFSIGNALED(status)) {
-                int s = WTERMSIG(status);
-                c->running = 0;
-                po("PID %d exited with signal %d\n", p, s);
+                po("PID %d exited with signal %d\n", c->pid,
+                   WTERMSIG(status));
             }
+            break;
         }
+
+        if (elapsed_ms(&begin) >= timeout_ms)
+            return -1;
+
+        if (capture_stderr_read(c, 10) == 0)
+            usleep(1000);
     }
+
+    // Get the last words (like the packet counters)
+    while (capture_stderr_read(c, 0) > 0)
+        ;
+
+    return 0;
 }
 
-static int capture_execl(const char *c) {
-    int res;
+// The frames are stamped by the kernel (or NIC), see raw_socket()
+static int capture_open(struct capture *c) {
+    c->frames = 0;
+    c->fd = raw_socket(c->ifname);
+    if (c->fd < 0)
+        return -1;
 
-    res = execl("/bin/bash", "bash", "-c", c, (char *) NULL);
-    return res;
+    c->pcap = pcap_writer_open(c->file, c->snaplen, 0);
+    if (!c->pcap) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+
+    c->if_id = pcap_writer_if(c->pcap, c->ifname);
+
+    return 0;
 }
 
-static int capture_start(struct capture *c) {
-    int pid;
-    signal(SIGCHLD, &signal_child);
+// Read all frames pending on the capture socket, and write them to the file
+static void capture_read(struct capture *c) {
+    int res;
+    buf_t *b;
+    struct timespec ts;
 
-    pid = fork();
+    if (c->fd < 0)
+        return;
 
-    if (pid == 0) {
-        return capture_execl((char *)c->tcpdump_cmd->data);
-    }
+    b = balloc(64 * 1024);
+    if (!b)
+        return;
 
-    if (pid > 0) {
-        c->pid = pid;
-        c->running = 1;
-        po("PID %d -> %s\n", c->pid, c->tcpdump_cmd->data);
+    while (!c->cnt || c->frames < c->cnt) {
+        b->size = 64 * 1024;
+        res = rx_frame_recv(c->fd, b, &ts, MSG_DONTWAIT);
+        if (res <= 0)
+            break;
+
+        pcap_writer_write(c->pcap, c->if_id, &ts, b->data, b->size);
+        c->frames++;
     }
 
-    return c->pid;
+    bfree(b);
+
+    // Just like 'tcpdump -c', stop when the requested frames are captured
+    if (c->cnt && c->frames >= c->cnt) {
+        close(c->fd);
+        c->fd = -1;
+    }
 }
 
-int capture_all_start() {
-    struct capture *p = HEAD;
+static void capture_close(struct capture *c) {
+    if (c->fd >= 0) {
+        capture_read(c);
+        close(c->fd);
+        c->fd = -1;
+    }
 
-    while (p) {
-        capture_start(p);
-        p = p->next;
+    if (c->pcap) {
+        if (pcap_writer_close(c->pcap) < 0)
+            po("ERROR: Failed to write %s: %m\n", c->file);
+        c->pcap = 0;
+        po("CAPTURE %16s: %u frames -> %s\n", c->ifname, c->frames, c->file);
     }
+}
+
+int capture_fds_fill(fd_set *rfds, int fd_max) {
+    struct capture *p;
+
+    for (p = HEAD; p; p = p->next) {
+        if (p->fd < 0)
+            continue;
 
-    if (HEAD) {
-        // We need to wait a bit before tcpdump is ready to capture frames
-        // TODO, read the output from tcpdump instead
-        sleep(3);
+        FD_SET(p->fd, rfds);
+        if (p->fd > fd_max)
+            fd_max = p->fd;
     }
 
-    return 0;
+    return fd_max;
 }
 
-static void wait_poll(int times) {
-    int i;
+void capture_fds_process(fd_set *rfds) {
     struct capture *p;
 
-    for (i = 0; i < times; ++i) {
-        int j = 0;
+    for (p = HEAD; p; p = p->next) {
+        if (p->fd >= 0 && FD_ISSET(p->fd, rfds))
+            capture_read(p);
+    }
+}
 
-        usleep(1000);
-        signal_child(0);
+int capture_all_start() {
+    struct capture *p = HEAD;
+    int external = 0;
 
-        // Check if we still have pending processes
-        for (p = HEAD; p; p = p->next) {
-            if (p->running)
-                j++;
+    TIMING_ENTER(TIMING_CAPTURE, 0);
+    while (p) {
+        if (p->tcpdump_argv) {
+            if (capture_start(p) == 0)
+                external++;
+        } else if (capture_open(p) != 0) {
+            po("ERROR: Failed to start capture on %s\n", p->ifname);
         }
+        p = p->next;
+    }
 
-        if (j == 0)
-            break;
+    // The tcpdump instances are started in parallel, and then waited for
+    for (p = HEAD; external && p; p = p->next) {
+        if (p->running)
+            capture_wait_ready(p);
     }
+    TIMING_LEAVE();
+
+    return 0;
 }
 
 int capture_all_stop() {
     struct capture *p;
-    int cnt = 0;
 
-    // Signal all running
-    for (p = HEAD; p; p = p->next) {
-        if (p->running) {
-            cnt++;
-        }
-    }
+    TIMING_ENTER(TIMING_CAPTURE, 0);
 
-    if (cnt) {
-        // Apparently it take some time from the frame is received until it find
-        // its way to pcap file.
-        sleep(3);
+    // In-process captures are complete once the socket is drained
+    for (p = HEAD; p; p = p->next) {
+        capture_close(p);
     }
 
-    signal(SIGCHLD, signal_empty);
-
-    // Signal all running
+    // tcpdump flushes the file when it exits on SIGINT
     for (p = HEAD; p; p = p->next) {
         if (p->running) {
             kill(p->pid, SIGINT);
         }
     }
 
-    wait_poll(10000);
-
-    // If processes are still runnign, then kill them
     for (p = HEAD; p; p = p->next) {
-        if (p->running) {
-            po("Killing: %d!\n", p->pid);
-            kill(p->pid, SIGTERM);
+        if (capture_wait_exit(p, CAPTURE_STOP_TIMEOUT_MS) == 0)
+            continue;
+
+        // If processes are still running, then kill them
+        po("Killing: %d!\n", p->pid);
+        kill(p->pid, SIGTERM);
+        if (capture_wait_exit(p, 1000) != 0) {
+            kill(p->pid, SIGKILL);
+            capture_wait_exit(p, CAPTURE_STOP_TIMEOUT_MS);
         }
     }
 
-    wait_poll(10000);
-
     p = HEAD;
     while (p) {
         struct capture *pp = p;
         p = p->next;
-        bfree(pp->tcpdump_cmd);
-        free(pp);
+        capture_free(pp);
     }
+    HEAD = 0;
+    TIMING_LEAVE();
 
     return 0;
 }
-
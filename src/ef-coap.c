@@ -111,13 +111,13 @@ int coap_parse_parms(hdr_t *hdr, int hdr_offset, struct field *f, int argc, cons
 static int coap_fill_defaults(struct frame *f, int stack_idx) {
     char buf[16];
     hdr_t *h = f->stack[stack_idx];
-    field_t *tkl = find_field(h, "tkl");
-    field_t *token = find_field(h, "token");
+    field_t *tkl = &h->fields[COAP_FIELD_TOKEN_LENGTH];
+    field_t *token = &h->fields[COAP_FIELD_TOKEN];
 
     if (!tkl->val) {
         if (token->val) {
             snprintf(buf, 16, "%d", BIT_TO_BYTE(h->fields[COAP_FIELD_TOKEN].bit_width));
-            tkl->val = parse_bytes(buf, 1);
+            field_val_parse(tkl, buf, 1);
         }
     }
 
@@ -175,8 +175,8 @@ static int options_fill_defaults(struct frame *f, int stack_idx) {
 
 
     hdr_t   *hdr = f->stack[stack_idx];
-    field_t *fnum = find_field(hdr, "num");
-    field_t *fval = find_field(hdr, "val");
+    field_t *fnum = &hdr->fields[COAP_OPT_FIELD_NUM];
+    field_t *fval = &hdr->fields[COAP_OPT_FIELD_VAL];
 
     if (!fnum->val || !fval->val) {
         return 0;
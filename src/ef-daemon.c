@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include "ef.h"
+
+#define DAEMON_CLIENTS_MAX 16
+#define DAEMON_REQ_MAX     (64 * 1024)
+
+// Protocol: The client sends one job per line, in the same syntax as a line in
+// a batch file. Each job is executed in turn, its output is sent back on the
+// connection, followed by its result records as JSON lines (the format of
+// '-o jsonl:', see ef-result.c) and the line "END <result>", where result is 0
+// if the job passed. The request "quit" closes the connection, and "shutdown"
+// stops the daemon.
+typedef struct {
+    int     fd;
+    size_t  len;
+    char    buf[DAEMON_REQ_MAX];
+} daemon_client_t;
+
+enum {
+    DAEMON_CLIENT_OK,
+    DAEMON_CLIENT_CLOSE,
+    DAEMON_CLIENT_SHUTDOWN,
+};
+
+static volatile sig_atomic_t DAEMON_STOP = 0;
+
+static void daemon_signal(int sig) {
+    DAEMON_STOP = 1;
+}
+
+static int daemon_job(daemon_client_t *c, char *line) {
+    int res, po_fd = PO_FD, pe_fd = PE_FD;
+
+    PO_FD = c->fd;
+    PE_FD = c->fd;
+
+    result_job_begin();
+    res = batch_job(line);
+    result_job_end(c->fd);
+    po("END %d\n", res);
+
+    PO_FD = po_fd;
+    PE_FD = pe_fd;
+
+    if (out_flush() < 0)
+        return DAEMON_CLIENT_CLOSE;
+
+    return DAEMON_CLIENT_OK;
+}
+
+// Execute all complete requests received from the client
+static int daemon_client_process(daemon_client_t *c) {
+    int res;
+    char *p, *line;
+    size_t line_len;
+
+    while ((p = memchr(c->buf, '\n', c->len))) {
+        line = c->buf;
+        line_len = p - c->buf + 1;
+        *p = 0;
+        if (p > line && p[-1] == '\r')
+            p[-1] = 0;
+
+        if (strcmp(line, "quit") == 0) {
+            return DAEMON_CLIENT_CLOSE;
+        } else if (strcmp(line, "shutdown") == 0) {
+            return DAEMON_CLIENT_SHUTDOWN;
+        } else if (!is_blank_or_comment(line)) {
+            res = daemon_job(c, line);
+            if (res != DAEMON_CLIENT_OK)
+                return res;
+        }
+
+        c->len -= line_len;
+        memmove(c->buf, c->buf + line_len, c->len);
+    }
+
+    if (c->len == sizeof(c->buf)) {
+        out_flush();
+        dprintf(c->fd, "ERROR: Request too long\nEND -1\n");
+        return DAEMON_CLIENT_CLOSE;
+    }
+
+    return DAEMON_CLIENT_OK;
+}
+
+static void daemon_client_close(daemon_client_t **c) {
+    close((*c)->fd);
+    free(*c);
+    *c = 0;
+}
+
+static void daemon_accept(int lfd, daemon_client_t *clients[]) {
+    int i, fd;
+
+    fd = accept(lfd, 0, 0);
+    if (fd < 0)
+        return;
+
+    for (i = 0; i < DAEMON_CLIENTS_MAX; ++i) {
+        if (clients[i])
+            continue;
+
+        clients[i] = calloc(1, sizeof(daemon_client_t));
+        if (!clients[i])
+            break;
+
+        clients[i]->fd = fd;
+        return;
+    }
+
+    dprintf(fd, "ERROR: Too many clients\n");
+    close(fd);
+}
+
+int daemon_run(const char *path) {
+    struct sockaddr_un sa = {};
+    struct sigaction act = {};
+    daemon_client_t *clients[DAEMON_CLIENTS_MAX] = {};
+    daemon_client_t *c;
+    int i, lfd, res, fd_max, err = 0;
+    ssize_t cnt;
+    fd_set rfds;
+
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        po("ERROR: Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+
+    lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0) {
+        po("%s:%d socket error: %m\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+        listen(lfd, DAEMON_CLIENTS_MAX) < 0) {
+        po("%s:%d bind/listen error: %m\n", __FILE__, __LINE__);
+        close(lfd);
+        return -1;
+    }
+
+    // A client going away must not take the daemon with it, and SIGINT and
+    // SIGTERM must interrupt select() such that the socket is cleaned up.
+    signal(SIGPIPE, SIG_IGN);
+    act.sa_handler = daemon_signal;
+    sigaction(SIGINT, &act, 0);
+    sigaction(SIGTERM, &act, 0);
+
+    exec_session_begin();
+    if (capture_cnt() > 0)
+        capture_all_start();
+
+    po("DAEMON: listening on %s\n", path);
+    out_flush();
+
+    while (!DAEMON_STOP) {
+        FD_ZERO(&rfds);
+        FD_SET(lfd, &rfds);
+        fd_max = lfd;
+
+        for (i = 0; i < DAEMON_CLIENTS_MAX; ++i) {
+            if (!clients[i])
+                continue;
+
+            FD_SET(clients[i]->fd, &rfds);
+            if (clients[i]->fd > fd_max)
+                fd_max = clients[i]->fd;
+        }
+
+        res = select(fd_max + 1, &rfds, 0, 0, 0);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+
+            po("%s:%d select error: %m\n", __FILE__, __LINE__);
+            err = -1;
+            break;
+        }
+
+        if (FD_ISSET(lfd, &rfds))
+            daemon_accept(lfd, clients);
+
+        for (i = 0; i < DAEMON_CLIENTS_MAX && !DAEMON_STOP; ++i) {
+            c = clients[i];
+            if (!c || !FD_ISSET(c->fd, &rfds))
+                continue;
+
+            cnt = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len);
+            if (cnt <= 0) {
+                daemon_client_close(&clients[i]);
+                continue;
+            }
+
+            c->len += cnt;
+            res = daemon_client_process(c);
+
+            if (res == DAEMON_CLIENT_SHUTDOWN)
+                DAEMON_STOP = 1;
+
+            if (res != DAEMON_CLIENT_OK)
+                daemon_client_close(&clients[i]);
+        }
+    }
+
+    for (i = 0; i < DAEMON_CLIENTS_MAX; ++i) {
+        if (clients[i])
+            daemon_client_close(&clients[i]);
+    }
+
+    close(lfd);
+    unlink(path);
+
+    if (capture_cnt() > 0)
+        capture_all_stop();
+    exec_session_end();
+
+    return err;
+}
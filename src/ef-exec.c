@@ -1,7 +1,10 @@
+#define _GNU_SOURCE // sendmmsg()
 #include "ef.h"
 
+#include <poll.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <inttypes.h>
 #include <net/if.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -9,9 +12,8 @@
 #include <sys/stat.h>
 #include <linux/if_ether.h>
 #include <linux/if_packet.h>
-#ifdef HAS_LIBPCAP
-#include <pcap/pcap.h>
-#endif
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
 #include <assert.h>
 #include <sys/time.h>
 
@@ -19,8 +21,27 @@
 #define MAX(a, b) (a > b ? a : b)
 #endif
 
+static void raw_socket_drain(int s) {
+    int i;
+
+    // Make sure that the socket is empty before started.
+    //
+    // Warning: I have no idea why this is needed, but otherwise I see that the
+    // test is failing on Ubuntu 18.04
+    //
+    // TODO: This does not seem to be needed, if we uses a RX ring buffer
+    // instead (atleast that seems to work for libpcap)
+    for (i = 0; i < 10000; ++i) {
+        struct msghdr msg = { 0 };
+        int res = recvmsg(s, &msg, MSG_DONTWAIT);
+        TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+        if (res < 0)
+            break;
+    }
+}
+
 int raw_socket(const char *name) {
-    int i, s, res, val, ifidx;
+    int s, res, val, ifidx;
     struct sockaddr_ll sa = {};
     struct packet_mreq mr = {};
 
@@ -28,6 +49,7 @@ int raw_socket(const char *name) {
         return -1;
 
     s = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
     if (s < 0) {
         po("%s:%d socket error: %m\n", __FILE__, __LINE__);
         return -1;
@@ -40,6 +62,7 @@ int raw_socket(const char *name) {
     sa.sll_protocol = htons(ETH_P_ALL);
 
     res = bind(s, (struct sockaddr*)&sa, sizeof(sa));
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
     if (res < 0) {
         po("%s:%d bind error: %m\n", __FILE__, __LINE__);
         close(s);
@@ -49,6 +72,7 @@ int raw_socket(const char *name) {
     mr.mr_ifindex = ifidx;
     mr.mr_type = PACKET_MR_PROMISC;
     res = setsockopt(s, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof(mr));
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
     if (res == -1) {
         po("%s:%d Failed to set PROMISC: %m\n", __FILE__, __LINE__);
         close(s);
@@ -57,29 +81,167 @@ int raw_socket(const char *name) {
 
     val = 1;
     setsockopt(s, SOL_PACKET, PACKET_AUXDATA, &val, sizeof(val));
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
     if (res == -1) {
         po("%s:%d Failed to enable AUXDATA: %m\n", __FILE__, __LINE__);
         close(s);
         return -1;
     }
 
-    // Make sure that the socket is empty before started.
-    //
-    // Warning: I have no idea why this is needed, but otherwise I see that the
-    // test is failing on Ubuntu 18.04
-    //
-    // TODO: This does not seem to be needed, if we uses a RX ring buffer
-    // instead (atleast that seems to work for libpcap)
-    for (i = 0; i < 10000; ++i) {
-        struct msghdr msg = { 0 };
-        int res = recvmsg(s, &msg, MSG_DONTWAIT);
-        if (res < 0)
-            break;
+    // Kernel timestamps of all received frames, and of the sent frames which
+    // ask for it (see tx_frame_send()). Hardware timestamps are reported if
+    // the NIC has them enabled.
+    val = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_RX_HARDWARE |
+          SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+          SOF_TIMESTAMPING_OPT_TSONLY;
+    if (setsockopt(s, SOL_SOCKET, SO_TIMESTAMPING, &val, sizeof(val)) < 0) {
+        val = 1;
+        setsockopt(s, SOL_SOCKET, SO_TIMESTAMPNS, &val, sizeof(val));
     }
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+
+    raw_socket_drain(s);
 
     return s;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Session state. When a session is active (batch and daemon mode), interface
+// sockets and named frames are kept between calls to exec_cmds(), such that
+// each test only pays for the work it does.
+#define SESSION_SOCKETS_MAX 100
+
+typedef struct {
+    char *name;
+    int   fd;
+} session_socket_t;
+
+static int SESSION_ACTIVE = 0;
+static session_socket_t SESSION_SOCKETS[SESSION_SOCKETS_MAX];
+static int SESSION_SOCKETS_CNT = 0;
+static cmd_t *SESSION_NAMES = 0;
+
+static void pcap_out_close_all();
+
+int exec_session_begin() {
+    SESSION_ACTIVE = 1;
+    return 0;
+}
+
+int exec_session_active() {
+    return SESSION_ACTIVE;
+}
+
+void exec_session_end() {
+    int i;
+    cmd_t *c;
+
+    for (i = 0; i < SESSION_SOCKETS_CNT; ++i) {
+        close(SESSION_SOCKETS[i].fd);
+        free(SESSION_SOCKETS[i].name);
+    }
+    memset(SESSION_SOCKETS, 0, sizeof(SESSION_SOCKETS));
+    SESSION_SOCKETS_CNT = 0;
+
+    while (SESSION_NAMES) {
+        c = SESSION_NAMES;
+        SESSION_NAMES = c->next;
+        cmd_destruct(c);
+        free(c);
+    }
+
+    pcap_out_close_all();
+
+    SESSION_ACTIVE = 0;
+}
+
+static int session_socket_get_(const char *name) {
+    int i, fd;
+
+    if (!SESSION_ACTIVE)
+        return raw_socket(name);
+
+    for (i = 0; i < SESSION_SOCKETS_CNT; ++i) {
+        if (strcmp(SESSION_SOCKETS[i].name, name) == 0) {
+            // Frames received between two tests does not belong to any of
+            // them
+            raw_socket_drain(SESSION_SOCKETS[i].fd);
+            return SESSION_SOCKETS[i].fd;
+        }
+    }
+
+    fd = raw_socket(name);
+    if (fd < 0 || SESSION_SOCKETS_CNT >= SESSION_SOCKETS_MAX)
+        return fd;
+
+    SESSION_SOCKETS[SESSION_SOCKETS_CNT].name = strdup(name);
+    SESSION_SOCKETS[SESSION_SOCKETS_CNT].fd = fd;
+    SESSION_SOCKETS_CNT++;
+
+    return fd;
+}
+
+static int session_socket_get(const char *name) {
+    int fd;
+
+    TIMING_ENTER(TIMING_SOCKET, name);
+    fd = session_socket_get_(name);
+    TIMING_LEAVE();
+
+    return fd;
+}
+
+static void session_socket_put(int fd) {
+    int i;
+
+    for (i = 0; SESSION_ACTIVE && i < SESSION_SOCKETS_CNT; ++i) {
+        if (SESSION_SOCKETS[i].fd == fd)
+            return;
+    }
+
+    close(fd);
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+}
+
+static cmd_t *session_name_find(const char *name) {
+    cmd_t *c;
+
+    for (c = SESSION_NAMES; c; c = c->next) {
+        if (strcmp(c->name, name) == 0)
+            return c;
+    }
+
+    return 0;
+}
+
+// Remember a named frame, such that it can be used by later tests in the
+// session. A frame with the same name as an existing one replaces it.
+static void session_name_add(const cmd_t *src) {
+    cmd_t *c, **pp;
+
+    for (pp = &SESSION_NAMES; *pp; pp = &(*pp)->next) {
+        if (strcmp((*pp)->name, src->name) == 0) {
+            c = *pp;
+            *pp = c->next;
+            cmd_destruct(c);
+            free(c);
+            break;
+        }
+    }
+
+    c = calloc(1, sizeof(*c));
+    if (!c)
+        return;
+
+    c->type = CMD_TYPE_NAME;
+    c->name = strdup(src->name);
+    c->frame = frame_clone(src->frame);
+    c->frame_buf = bclone(src->frame_buf);
+    c->frame_mask_buf = bclone(src->frame_mask_buf);
+    c->next = SESSION_NAMES;
+    SESSION_NAMES = c;
+}
+
 int add_cmd_to_resource(cmd_t *c, int res_max, int res_valid,
                         cmd_socket_t *resources) {
 
@@ -122,7 +284,8 @@ int add_cmd_to_resource(cmd_t *c, int res_max, int res_valid,
 int rfds_wfds_fill(cmd_socket_t *resources, int res_valid, fd_set *rfds,
                    fd_set *wfds) {
     cmd_t *cmd_ptr;
-    int i, fd_set_cnt, fd_max;
+    int i, fd_set_cnt, fd_max, tx_pending;
+    uint64_t now = replay_now();
 
     fd_max = 0;
     fd_set_cnt = 0;
@@ -133,6 +296,10 @@ int rfds_wfds_fill(cmd_socket_t *resources, int res_valid, fd_set *rfds,
     for (i = 0; i < res_valid; i++) {
         resources[i].has_rx = 0;
         resources[i].has_tx = 0;
+        tx_pending = 0;
+
+        if (resources[i].fd < 0)
+            continue;
 
         cmd_ptr = resources[i].cmd;
         while (cmd_ptr) {
@@ -141,9 +308,16 @@ int rfds_wfds_fill(cmd_socket_t *resources, int res_valid, fd_set *rfds,
             if (cmd_ptr->type == CMD_TYPE_RX)
                 resources[i].has_rx = 1;
 
-            // Only TX is not done
-            if (cmd_ptr->type == CMD_TYPE_TX && cmd_ptr->done == 0)
-                resources[i].has_tx = 1;
+            // Frames are sent in order, so only the first TX command which
+            // is not done counts. A replay waits for its next deadline.
+            if (cmd_ptr->type == CMD_TYPE_TX && cmd_ptr->done == 0 &&
+                tx_pending == 0) {
+                tx_pending = 1;
+                if (!cmd_ptr->replay ||
+                    replay_next(cmd_ptr->replay, now, 0) ||
+                    cmd_ptr->replay->done)
+                    resources[i].has_tx = 1;
+            }
 
             cmd_ptr = cmd_ptr->next;
         }
@@ -167,117 +341,480 @@ int rfds_wfds_fill(cmd_socket_t *resources, int res_valid, fd_set *rfds,
     return -1;
 }
 
-int rfds_wfds_process(cmd_socket_t *resources, int res_valid, fd_set *rfds,
-                      fd_set *wfds) {
-    int i, res, match, old_size, tx_done;
-    buf_t *b;
-    cmd_t *cmd_ptr;
-
-    uint8_t cbuf[sizeof(struct cmsghdr) + sizeof(struct tpacket_auxdata) +
-            sizeof(size_t)] = {};
-
-    for (i = 0; i < res_valid; i++) {
-        struct iovec iov = {};
-        struct msghdr msg = {};
-
-        if (!FD_ISSET(resources[i].fd, rfds))
+// Find the best timestamp of a message: hardware, then kernel software
+// (SO_TIMESTAMPING or SO_TIMESTAMPNS). Returns -1 if there is none. If #sys is
+// set, it is updated with the software timestamp, which unlike the hardware
+// one is in the domain of CLOCK_REALTIME, and left as is if there is none.
+static int ts_from_cmsg(struct msghdr *msg, struct timespec *ts,
+                        struct timespec *sys) {
+    struct scm_timestamping tss;
+    struct cmsghdr *cmsg;
+    int src = -1;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
             continue;
 
-        // read the frame, and try to match it
-        b = balloc(32 * 1024);
+        if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+            if ((tss.ts[0].tv_sec || tss.ts[0].tv_nsec) && sys)
+                *sys = tss.ts[0];
+
+            if (tss.ts[2].tv_sec || tss.ts[2].tv_nsec) {
+                *ts = tss.ts[2];
+                src = TS_SRC_HW;
+            } else if ((tss.ts[0].tv_sec || tss.ts[0].tv_nsec) &&
+                       src < TS_SRC_SW) {
+                *ts = tss.ts[0];
+                src = TS_SRC_SW;
+            }
+        } else if (cmsg->cmsg_type == SCM_TIMESTAMPNS && src < 0) {
+            memcpy(ts, CMSG_DATA(cmsg), sizeof(*ts));
+            if (sys)
+                *sys = *ts;
+            src = TS_SRC_SW;
+        }
+    }
 
-        iov.iov_base = b->data;
-        iov.iov_len = b->size;
-        msg.msg_iov = &iov;
-        msg.msg_iovlen = 1;
-        msg.msg_control = cbuf;
-        msg.msg_controllen = sizeof(cbuf);
+    return src;
+}
 
-        res = recvmsg(resources[i].fd, &msg, 0);
-        if (res > 0) {
-            old_size = b->size;
-            b->size = res;
+// Receive a frame from a packet socket. The size of #b is the capacity on
+// input, and the size of the frame on return. If the kernel has stripped a
+// VLAN tag, then it is re-inserted, hence the capacity must allow for 4
+// additional bytes. If #ts is set, it is updated with the time the frame was
+// received (the kernel timestamp if enabled on the socket), and #ts_src (if
+// set) with where the time was taken. If #ts_sys is set, it is updated with
+// the time in the domain of CLOCK_REALTIME, the software timestamp if there is
+// one, as the hardware timestamp is taken from the clock of the NIC.
+int rx_frame_recv_ts(int fd, buf_t *b, struct timespec *ts, ts_src_t *ts_src,
+                     struct timespec *ts_sys, int flags) {
+    struct timespec t, sys = {};
+    int res, src;
+    size_t old_size;
+    struct iovec iov = {};
+    struct msghdr msg = {};
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr align;
+        uint8_t buf[CMSG_SPACE(sizeof(struct tpacket_auxdata)) +
+                    CMSG_SPACE(sizeof(struct timespec)) +
+                    CMSG_SPACE(sizeof(struct scm_timestamping))];
+    } cbuf;
+
+    iov.iov_base = b->data;
+    iov.iov_len = b->size;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf.buf;
+    msg.msg_controllen = sizeof(cbuf.buf);
+
+    res = recvmsg(fd, &msg, flags);
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+    if (res <= 0)
+        return res;
+
+    old_size = b->size;
+    b->size = res;
+
+    if (ts || ts_sys) {
+        src = ts_from_cmsg(&msg, &t, &sys);
+        if (src < 0) {
+            clock_gettime(CLOCK_REALTIME, &t);
+            src = TS_SRC_HOST;
+        }
 
-            // We need to get the vlan ID from AUX data
-            if (msg.msg_controllen >= sizeof(struct cmsghdr) &&
-                res + 4 < old_size) {
-                struct cmsghdr* cmsg = (struct cmsghdr*)cbuf;
+        if (ts)
+            *ts = t;
+        if (ts_src)
+            *ts_src = src;
+        if (ts_sys) {
+            if (sys.tv_sec || sys.tv_nsec)
+                *ts_sys = sys;
+            else if (src == TS_SRC_HW)
+                clock_gettime(CLOCK_REALTIME, ts_sys);
+            else
+                *ts_sys = t;
+        }
+    }
 
-                if ((cmsg->cmsg_level == SOL_PACKET) &&
-                    (cmsg->cmsg_type == PACKET_AUXDATA)) {
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        // We need to get the vlan ID from AUX data
+        if ((cmsg->cmsg_level == SOL_PACKET) &&
+            (cmsg->cmsg_type == PACKET_AUXDATA) && res + 4 < old_size) {
 
-                    struct tpacket_auxdata* aux =
-                            (struct tpacket_auxdata*)CMSG_DATA(cmsg);
+            struct tpacket_auxdata* aux =
+                    (struct tpacket_auxdata*)CMSG_DATA(cmsg);
 
-                    if (aux->tp_status & TP_STATUS_VLAN_VALID) {
-                        uint16_t tci = htons(aux->tp_vlan_tci);
+            if (aux->tp_status & TP_STATUS_VLAN_VALID) {
+                uint16_t tci = htons(aux->tp_vlan_tci);
 
-                        // make room and re-add the vlan tag
-                        memmove(b->data + 16, b->data + 12, res - 12);
+                // make room and re-add the vlan tag
+                memmove(b->data + 16, b->data + 12, res - 12);
 #ifdef TP_STATUS_VLAN_TPID_VALID
-                        uint16_t tpid = htons(aux->tp_vlan_tpid);
-                        memcpy(b->data + 12, &tpid, sizeof(tpid));
+                uint16_t tpid = htons(aux->tp_vlan_tpid);
+                memcpy(b->data + 12, &tpid, sizeof(tpid));
 #else
-                        {
-                            uint8_t eth_p_8021q[2] = {0x81, 0x00};
-                            memcpy(b->data + 12, eth_p_8021q,
-                                   sizeof(eth_p_8021q));
-                        }
-#endif
-                        memcpy(b->data + 14, &tci, sizeof(tci));
-                        b->size += 4;
-                    }
+                {
+                    uint8_t eth_p_8021q[2] = {0x81, 0x00};
+                    memcpy(b->data + 12, eth_p_8021q, sizeof(eth_p_8021q));
                 }
+#endif
+                memcpy(b->data + 14, &tci, sizeof(tci));
+                b->size += 4;
             }
+        }
+    }
 
-            // Try to match the frame agains expected frames
-            match = 0;
-            for (cmd_ptr = resources[i].cmd; cmd_ptr; cmd_ptr = cmd_ptr->next) {
+    return res;
+}
 
-                if (!cmd_ptr->frame_buf)
-                    continue;
+int rx_frame_recv(int fd, buf_t *b, struct timespec *ts, int flags) {
+    return rx_frame_recv_ts(fd, b, ts, 0, 0, flags);
+}
 
-                if (cmd_ptr->done)
-                    continue;
+// Maximum time to wait for the TX timestamp of a frame. A software timestamp
+// is ready when the frame is handed to the driver, a hardware timestamp when
+// the NIC has sent it.
+#define TX_TS_TIMEOUT_MS 10
+
+// Read all TX timestamps from the error queue of the socket, and return the
+// best one (see ts_from_cmsg()), or -1 if there are none.
+static int tx_ts_read(int fd, struct timespec *ts) {
+    union {
+        struct cmsghdr align;
+        uint8_t buf[CMSG_SPACE(sizeof(struct scm_timestamping)) +
+                    CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+    } cbuf;
+    struct msghdr msg;
+    struct timespec t;
+    int res, src, best = -1;
 
-                if (bequal_mask(b, cmd_ptr->frame_buf, cmd_ptr->frame_mask_buf,
-                                cmd_ptr->frame->padding_len)) {
-                    match = 1;
-                    cmd_ptr->done = 1;
-                    break;
-                }
+    while (1) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = cbuf.buf;
+        msg.msg_controllen = sizeof(cbuf.buf);
+
+        res = recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+        TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+        if (res < 0)
+            break;
+
+        src = ts_from_cmsg(&msg, &t, 0);
+        if (src > best) {
+            best = src;
+            *ts = t;
+        }
+    }
+
+    return best;
+}
+
+// Send a frame. If #ts is set, the kernel is asked to timestamp the frame,
+// and #ts is updated with the timestamp read back from the error queue, or
+// the time of the send if there is none. Returns the result of the send.
+static int tx_frame_send(int fd, const buf_t *b, struct timespec *ts,
+                         ts_src_t *ts_src) {
+    union {
+        struct cmsghdr align;
+        uint8_t buf[CMSG_SPACE(sizeof(uint32_t))];
+    } cbuf = {};
+    struct iovec iov = { .iov_base = b->data, .iov_len = b->size };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+    struct pollfd pfd = { .fd = fd };
+    struct cmsghdr *cmsg;
+    struct timespec t;
+    uint32_t flags = SOF_TIMESTAMPING_TX_SOFTWARE |
+                     SOF_TIMESTAMPING_TX_HARDWARE;
+    int res, src;
+
+    *ts_src = TS_SRC_HOST;
+
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+    if (!ts)
+        return send(fd, b->data, b->size, 0);
+
+    // Timestamps of frames sent before are stale
+    tx_ts_read(fd, &t);
+
+    msg.msg_control = cbuf.buf;
+    msg.msg_controllen = sizeof(cbuf.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SO_TIMESTAMPING;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(flags));
+    memcpy(CMSG_DATA(cmsg), &flags, sizeof(flags));
+
+    clock_gettime(CLOCK_REALTIME, ts);
+
+    res = sendmsg(fd, &msg, 0);
+    if (res < 0)
+        return res;
+
+    // POLLERR is set once the timestamp is on the error queue
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+    if (poll(&pfd, 1, TX_TS_TIMEOUT_MS) > 0) {
+        src = tx_ts_read(fd, &t);
+        if (src >= 0) {
+            *ts = t;
+            *ts_src = src;
+        }
+    }
+
+    return res;
+}
+
+// Print the time of a frame at the end of a TX or RX-OK line
+static void po_ts(const struct timespec *ts, ts_src_t ts_src) {
+    po(" at %lld.%09ld (%s)", (long long)ts->tv_sec, ts->tv_nsec,
+       ts_src_name(ts_src));
+}
+
+// Match a received frame against the expected frames of the resource, and
+// report it as RX-OK or RX-ERR.
+static void rx_frame_match(cmd_socket_t *r, const buf_t *b,
+                           const struct timespec *ts, ts_src_t ts_src) {
+    cmd_t *cmd_ptr;
+    int match = 0;
+
+    for (cmd_ptr = r->cmd; cmd_ptr; cmd_ptr = cmd_ptr->next) {
+        if (!cmd_ptr->frame_buf)
+            continue;
+
+        if (cmd_ptr->done)
+            continue;
+
+        if (bequal_mask(b, cmd_ptr->frame_buf, cmd_ptr->frame_mask_buf,
+                        cmd_ptr->frame->padding_len)) {
+            match = 1;
+            if (cmd_ptr->repeat > 1) {
+                cmd_ptr->repeat--;
+            } else {
+                cmd_ptr->done = 1;
             }
+            break;
+        }
+    }
 
-            if (match) {
-                po("RX-OK  %16s: ", cmd_ptr->arg0);
-                if (cmd_ptr->name) {
-                    po("name %s", cmd_ptr->name);
-                } else {
-                    print_hex_str(1, b->data, b->size);
-                    if (cmd_ptr->frame_mask_buf) {
-                        po("\nRX-OK MASK:              ");
-                        print_hex_str(1, cmd_ptr->frame_mask_buf->data,
-                                      cmd_ptr->frame_mask_buf->size);
-                        po("\n");
-                    }
-                }
+    if (match) {
+        STATS_ADD(r->stats, rx_match, 1);
+
+        // Only the last frame of a 'rep' is reported
+        if (!cmd_ptr->done)
+            return;
+
+        result_add(RESULT_RX_OK, cmd_ptr->idx, cmd_ptr->arg0, ts, ts_src,
+                   b->size, cmd_ptr->name);
+        po("RX-OK  %16s: ", cmd_ptr->arg0);
+        if (cmd_ptr->name) {
+            po("name %s", cmd_ptr->name);
+            po_ts(ts, ts_src);
+        } else {
+            print_hex_str(PO_FD, b->data, b->size);
+            po_ts(ts, ts_src);
+            if (cmd_ptr->frame_mask_buf) {
+                po("\nRX-OK MASK:              ");
+                print_hex_str(PO_FD, cmd_ptr->frame_mask_buf->data,
+                              cmd_ptr->frame_mask_buf->size);
                 po("\n");
-            } else {
-                resources[i].rx_err_cnt ++;
-                pe("RX-ERR %16s: ", resources[i].cmd->arg0);
-                print_hex_str(2, b->data, b->size);
-                pe("\n");
             }
+        }
+        po("\n");
+    } else {
+        STATS_ADD(r->stats, rx_unexpected, 1);
+        r->rx_err_cnt ++;
+        result_add(RESULT_RX_ERR, -1, r->cmd->arg0, ts, ts_src, b->size, 0);
+        pe("RX-ERR %16s: ", r->cmd->arg0);
+        print_hex_str(PE_FD, b->data, b->size);
+        pe("\n");
+    }
+}
+
+// Frames with a latency signature or a sequence number are accounted by
+// 'rx <if> latency' or 'rx <if> seq', all others are matched. The latency is
+// measured with #ts_sys, in the clock domain of the signature.
+static void rx_frame_handle(cmd_socket_t *r, const buf_t *b,
+                            const struct timespec *ts, ts_src_t ts_src,
+                            const struct timespec *ts_sys) {
+    if ((r->lat && lat_rx_frame(r->lat, b, ts_sys)) ||
+        (r->seq && seq_rx_frame(r->seq, b))) {
+        STATS_ADD(r->stats, rx_match, 1);
+        return;
+    }
+
+    rx_frame_match(r, b, ts, ts_src);
+}
+
+// Resources named 'file:<path>' are recorded pcap/pcapng files, which are
+// matched like frames received on a port.
+static int is_rx_file(const char *name) {
+    return strncmp(name, "file:", 5) == 0;
+}
+
+static void rx_file_frame(void *ctx, const struct timespec *ts,
+                          const uint8_t *data, uint32_t len,
+                          uint32_t orig_len) {
+    buf_t b = { .size = len, .data = (uint8_t *)data };
+
+    // The file does not tell where its timestamps were taken
+    rx_frame_handle((cmd_socket_t *)ctx, &b, ts, TS_SRC_HOST, ts);
+}
+
+static int rx_file_process(cmd_socket_t *r) {
+    cmd_t *cmd_ptr;
+
+    for (cmd_ptr = r->cmd; cmd_ptr; cmd_ptr = cmd_ptr->next) {
+        if (cmd_ptr->type != CMD_TYPE_RX) {
+            po("ERROR: %s can only be used with rx\n", cmd_ptr->arg0);
+            return -1;
+        }
+    }
+
+    return pcap_file_read(r->cmd->arg0 + 5, rx_file_frame, r);
+}
+
+// Time until the next replayed frame is due, 0 if one is due already, or -1
+// if no replay is in progress.
+static int64_t replay_wait(cmd_socket_t *resources, int res_valid) {
+    uint64_t w, now = replay_now();
+    int64_t wait = -1;
+    cmd_t *cmd_ptr;
+    int i;
+
+    for (i = 0; i < res_valid; i++) {
+        if (resources[i].fd < 0)
+            continue;
+
+        for (cmd_ptr = resources[i].cmd; cmd_ptr; cmd_ptr = cmd_ptr->next) {
+            if (cmd_ptr->type != CMD_TYPE_TX || !cmd_ptr->replay ||
+                cmd_ptr->done)
+                continue;
+
+            w = 0;
+            replay_next(cmd_ptr->replay, now, &w);
+            if (wait < 0 || (int64_t)w < wait)
+                wait = w;
+        }
+    }
+
+    return wait;
+}
 
+#define REPLAY_BATCH 64
+
+// Send the frames of a replay which are due, in batches of sendmmsg(). Returns
+// 1 if more frames may be due.
+static int tx_replay(int fd, cmd_t *c, stats_if_t *stats) {
+    struct mmsghdr msgs[REPLAY_BATCH] = {};
+    struct iovec iov[REPLAY_BATCH];
+    replay_t *r = c->replay;
+    const pcap_rec_t *rec;
+    uint64_t now = replay_now();
+    int i, j, n, res;
+
+    for (n = 0; n < REPLAY_BATCH; n++) {
+        rec = replay_next(r, now, 0);
+        if (!rec)
+            break;
+
+        iov[n].iov_base = (void *)rec->data;
+        iov[n].iov_len = rec->len;
+        msgs[n].msg_hdr.msg_iov = &iov[n];
+        msgs[n].msg_hdr.msg_iovlen = 1;
+        replay_sent(r);
+    }
+
+    // sendmmsg() stops at the first frame which fails, skip it and go on
+    for (i = 0; i < n; i += res) {
+        res = sendmmsg(fd, msgs + i, n - i, 0);
+        TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+        if (res <= 0) {
+            STATS_ADD(stats, tx_drop, 1);
+            r->failed++;
+            res = 1;
+            continue;
+        }
+
+        STATS_ADD(stats, tx_frames, res);
+        for (j = i; j < i + res; j++) {
+            STATS_ADD(stats, tx_bytes, iov[j].iov_len);
+            TIMING_IO(c->arg0, 1, iov[j].iov_len);
         }
+    }
+
+    if (!r->done)
+        return n == REPLAY_BATCH;
+
+    result_add(RESULT_TX, c->idx, c->arg0, 0, TS_SRC_HOST, 0, c->name);
+    po("TX     %16s: replay %s: %" PRIu64 " frames",
+       c->arg0, r->path, r->sent - r->failed);
+    if (r->failed)
+        po(", %" PRIu64 " failed", r->failed);
+    po("\n");
+    c->done = 1;
+
+    return 0;
+}
+
+// Read a frame, and try to match it
+static int rx_frame_read(cmd_socket_t *r) {
+    struct timespec ts, ts_sys;
+    ts_src_t ts_src;
+    buf_t *b;
+    int res;
+
+    TIMING_ENTER(TIMING_RX, r->cmd->arg0);
+    b = balloc(32 * 1024);
+
+    res = rx_frame_recv_ts(r->fd, b, &ts, &ts_src, &ts_sys, MSG_DONTWAIT);
+    if (res > 0) {
+        STATS_ADD(r->stats, rx_frames, 1);
+        STATS_ADD(r->stats, rx_bytes, res);
+        TIMING_IO(r->cmd->arg0, 0, res);
+        rx_frame_handle(r, b, &ts, ts_src, &ts_sys);
+    } else if (res < 0) {
+        // Readable for a TX timestamp which came after its timeout
+        tx_ts_read(r->fd, &ts);
+    }
+
+    bfree(b);
+    TIMING_LEAVE();
+
+    return res;
+}
+
+// The frames still queued when the time runs out. A long 'rep' leaves little
+// of the time for reading.
+#define RX_QUEUE_MAX (1 << 20)
+
+static void rx_queue_read(cmd_socket_t *r) {
+    int i;
+
+    for (i = 0; i < RX_QUEUE_MAX; ++i) {
+        if (rx_frame_read(r) <= 0)
+            break;
+    }
+}
+
+int rfds_wfds_process(cmd_socket_t *resources, int res_valid, fd_set *rfds,
+                      fd_set *wfds) {
+    int i, res, tx_done;
+    struct timespec ts;
+    ts_src_t ts_src;
+    buf_t *b;
+    cmd_t *cmd_ptr;
+
+    for (i = 0; i < res_valid; i++) {
+        if (resources[i].fd < 0 || !FD_ISSET(resources[i].fd, rfds))
+            continue;
 
-        bfree(b);
+        rx_frame_read(&resources[i]);
     }
 
     while(1) {
         tx_done = 1;
         for (i = 0; i < res_valid; i++) {
-            if (!FD_ISSET(resources[i].fd, wfds))
+            if (resources[i].fd < 0 || !FD_ISSET(resources[i].fd, wfds))
                 continue;
 
             // TX the first not "done" frame.
@@ -288,8 +825,32 @@ int rfds_wfds_process(cmd_socket_t *resources, int res_valid, fd_set *rfds,
                 if (cmd_ptr->done)
                     continue;
 
+                TIMING_ENTER(TIMING_TX, cmd_ptr->arg0);
+                if (cmd_ptr->replay) {
+                    if (tx_replay(resources[i].fd, cmd_ptr,
+                                  resources[i].stats))
+                        tx_done = 0;
+                    TIMING_LEAVE();
+                    break;
+                }
+
+                // Only the last frame of a 'rep' is reported and stamped
                 b = cmd_ptr->frame_buf;
-                res = send(resources[i].fd, b->data, b->size, 0);
+                if (cmd_ptr->lat)
+                    lat_tx_stamp(cmd_ptr->lat, b);
+                res = tx_frame_send(resources[i].fd, b,
+                                    cmd_ptr->repeat == 1 ? &ts : 0, &ts_src);
+                if ((size_t)res == b->size) {
+                    STATS_ADD(resources[i].stats, tx_frames, 1);
+                    STATS_ADD(resources[i].stats, tx_bytes, res);
+                    TIMING_IO(cmd_ptr->arg0, 1, res);
+                } else {
+                    STATS_ADD(resources[i].stats, tx_drop, 1);
+
+                    // Not a loss of the DUT, the number is used again
+                    if (cmd_ptr->lat)
+                        cmd_ptr->lat->seq--;
+                }
                 cmd_ptr->repeat--;
 
                 if (cmd_ptr->repeat > 0) {
@@ -297,15 +858,19 @@ int rfds_wfds_process(cmd_socket_t *resources, int res_valid, fd_set *rfds,
                 }
 
                 if ((size_t)res == b->size && cmd_ptr->repeat == 0) {
+                    result_add(RESULT_TX, cmd_ptr->idx, cmd_ptr->arg0, &ts,
+                               ts_src, b->size, cmd_ptr->name);
                     po("TX     %16s: ", cmd_ptr->arg0);
                     if (cmd_ptr->name) {
                         po("name %s", cmd_ptr->name);
                     } else {
-                        print_hex_str(1, b->data, b->size);
+                        print_hex_str(PO_FD, b->data, b->size);
                     }
+                    po_ts(&ts, ts_src);
                     po("\n");
                     cmd_ptr->done = 1;
                 }
+                TIMING_LEAVE();
                 break;
             }
         }
@@ -335,54 +900,236 @@ static int copy_cmd_by_name(const char *name, int cnt, cmd_t *cmds, cmd_t *dst)
         return 0;
     }
 
+    // Fall back to frames named by earlier tests in the session
+    if (SESSION_ACTIVE) {
+        cmd_t *c = session_name_find(name);
+
+        if (c) {
+            dst->frame = frame_clone(c->frame);
+            dst->frame_buf = bclone(c->frame_buf);
+            dst->frame_mask_buf = bclone(c->frame_mask_buf);
+            return 0;
+        }
+    }
+
     return -1;
 }
 
-#ifdef HAS_LIBPCAP
-int pcap_append(cmd_t *c) {
-    struct pcap_pkthdr pkt;
-    struct stat statbuf;
+// Open pcap writers, one per path. They are kept open for the whole run (or
+// session), such that a file written by many commands or with 'rep' is only
+// opened once. The writers are flushed when a command line is completed.
+typedef struct pcap_out {
+    struct pcap_out *next;
+    char            *path;
+    pcap_writer_t   *w;
+    int              if_id;
+} pcap_out_t;
 
-    pcap_t *pcap;
-    pcap_dumper_t *pcapfile;
+static pcap_out_t *PCAP_OUTS = 0;
 
-    pcap = pcap_open_dead(DLT_EN10MB, 65535);
-    if (!pcap) {
-        pe("Error from pcap_open_dead(): %s\n", pcap_geterr(pcap));
-        return -1;
+static pcap_out_t *pcap_out_get(const char *path) {
+    pcap_out_t *o;
+
+    for (o = PCAP_OUTS; o; o = o->next) {
+        if (strcmp(o->path, path) == 0)
+            return o;
     }
 
-    if (stat(c->arg0, &statbuf) == 0) {
-        pcapfile = pcap_dump_open_append(pcap, c->arg0);
-    } else {
-        pcapfile = pcap_dump_open(pcap, c->arg0);
+    o = calloc(1, sizeof(*o));
+    if (!o)
+        return 0;
+
+    o->w = pcap_writer_open(path, 65535, 1);
+    if (!o->w) {
+        free(o);
+        return 0;
+    }
+
+    o->if_id = pcap_writer_if(o->w, 0);
+    o->path = strdup(path);
+    o->next = PCAP_OUTS;
+    PCAP_OUTS = o;
+
+    return o;
+}
+
+static void pcap_out_flush_all() {
+    pcap_out_t *o;
+
+    for (o = PCAP_OUTS; o; o = o->next) {
+        if (pcap_writer_flush(o->w) < 0)
+            pe("ERROR: Failed to write %s: %m\n", o->path);
     }
+}
 
-    if (!pcapfile) {
-        pe("Error from pcap_dump_open(): %s\n", pcap_geterr(pcap));
+static void pcap_out_close_all() {
+    pcap_out_t *o;
+
+    while (PCAP_OUTS) {
+        o = PCAP_OUTS;
+        PCAP_OUTS = o->next;
+
+        if (pcap_writer_close(o->w) < 0)
+            pe("ERROR: Failed to write %s: %m\n", o->path);
+        free(o->path);
+        free(o);
+    }
+}
+
+int pcap_append(cmd_t *c) {
+    struct timespec ts = {};
+    pcap_out_t *o;
+    uint32_t i;
+
+    o = pcap_out_get(c->arg0);
+    if (!o)
         return -1;
+
+    for (i = 0; i < c->repeat; ++i) {
+        if (pcap_writer_write(o->w, o->if_id, &ts, c->frame_buf->data,
+                              c->frame_buf->size) < 0) {
+            pe("ERROR: Failed to write %s: %m\n", o->path);
+            return -1;
+        }
     }
 
-    memset(&pkt, 0, sizeof(pkt));
-    pkt.caplen = c->frame_buf->size;
-    pkt.len = c->frame_buf->size;
-    pcap_dump((u_char *)pcapfile, &pkt, c->frame_buf->data);
+    return 0;
+}
+
+static int gen_exec(cmd_t *c) {
+    struct timespec t0, t1;
+    int64_t res;
+    double sec;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    res = gen_run(c->gen, c->arg0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
 
-    pcap_dump_close(pcapfile);
-    pcap_close(pcap);
+    if (res < 0) {
+        pe("ERROR: gen: Failed to write %s\n", c->arg0);
+        return -1;
+    }
+
+    sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    po("GEN    %16s: %" PRId64 " frames in %.2fs (%.0f frames/s)\n",
+       c->arg0, res, sec, sec > 0 ? res / sec : 0);
 
     return 0;
 }
-#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Host side RX losses. A frame which the kernel drops on one of our sockets
+// would be reported as NO-RX, as if the DUT had lost it. The drops are counted
+// (PACKET_STATISTICS), and the socket buffers are sized for the load of the
+// test.
+
+// Memory accounted by the kernel per queued frame, on top of the frame
+#define RCVBUF_FRAME_OVERHEAD 768
+
+int EXEC_HOST_DROPS = 0;
+
+// Frames are not read while the frames of a 'tx ... rep <cnt>' are sent, so
+// the sockets must be able to queue all the frames of the test. A replay is
+// counted by the records of its file, times the passes.
+static int rcvbuf_estimate(int cnt, const cmd_t *cmds) {
+    uint64_t size = 0, frames, bytes, pass;
+    int i;
+
+    for (i = 0; i < cnt && size < RCVBUF_MAX; i++) {
+        if (cmds[i].type != CMD_TYPE_TX)
+            continue;
+
+        if (cmds[i].replay) {
+            replay_size(cmds[i].replay, &frames, &bytes);
+            pass = bytes + frames * RCVBUF_FRAME_OVERHEAD;
+            if (pass && cmds[i].replay->loop > RCVBUF_MAX / pass)
+                return RCVBUF_MAX;
+
+            size += pass * cmds[i].replay->loop;
+            continue;
+        }
+
+        if (!cmds[i].frame_buf)
+            continue;
+
+        size += (uint64_t)cmds[i].repeat *
+                (cmds[i].frame_buf->size + RCVBUF_FRAME_OVERHEAD);
+    }
+
+    return size > RCVBUF_MAX ? RCVBUF_MAX : size;
+}
+
+void raw_socket_rcvbuf(int fd, int size) {
+    int cur = 0;
+    socklen_t len = sizeof(cur);
+
+    // The kernel doubles the value set, and reports the doubled value
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &cur, &len) < 0 || cur >= size)
+        return;
+
+    size /= 2;
+
+    // SO_RCVBUFFORCE may exceed net.core.rmem_max, but needs CAP_NET_ADMIN
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    TIMING_CNT(TIMING_CNT_SYSCALL, 3);
+}
+
+// Reading the statistics clears them
+int raw_socket_drops(int fd, struct tpacket_stats *st) {
+    socklen_t len = sizeof(*st);
+
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+    memset(st, 0, sizeof(*st));
+
+    return getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, st, &len);
+}
+
+static int resource_has_rx(const cmd_socket_t *r) {
+    const cmd_t *c;
+
+    for (c = r->cmd; c; c = c->next) {
+        if (c->type == CMD_TYPE_RX)
+            return 1;
+    }
+
+    return 0;
+}
+
+// Returns the number of frames dropped by the host on the RX sockets
+static int host_drops_report(cmd_socket_t *resources, int res_valid) {
+    struct tpacket_stats st;
+    int i, drops = 0;
+
+    for (i = 0; i < res_valid; i++) {
+        if (resources[i].fd < 0 || !resource_has_rx(&resources[i]) ||
+            raw_socket_drops(resources[i].fd, &st) < 0 || !st.tp_drops)
+            continue;
+
+        pe("INCONCLUSIVE %10s: the host dropped %u of %u frames\n",
+           resources[i].cmd->arg0, st.tp_drops, st.tp_packets);
+        drops += st.tp_drops;
+    }
+
+    return drops;
+}
 
 int exec_cmds(int cnt, cmd_t *cmds) {
-    struct timeval tv_now, tv_left, tv_begin, tv_end;
+    struct timeval tv_now, tv_left, tv_begin, tv_end, tv_timeout, tv;
     int i, res, fd_max, err = 0;
-    int res_valid = 0;
+    int64_t wait;
+    int res_valid = 0, snap_cnt, rcvbuf;
     cmd_socket_t resources[100] = {};
+    link_snap_t snaps[100];
+    struct tpacket_stats st;
     fd_set rfds, wfds;
     cmd_t *cmd_ptr;
 
+    EXEC_HOST_DROPS = 0;
+
+    for (i = 0; i < cnt; i++)
+        cmds[i].idx = i;
+
     // Print inventory of named frames
     for (i = 0; i < cnt; i++) {
         if (cmds[i].type != CMD_TYPE_NAME)
@@ -390,12 +1137,13 @@ int exec_cmds(int cnt, cmd_t *cmds) {
 
         if (cmds[i].frame_buf && cmds[i].name) {
             po("NAME:  %16s: ", cmds[i].name);
-            print_hex_str(1, cmds[i].frame_buf->data, cmds[i].frame_buf->size);
+            print_hex_str(PO_FD, cmds[i].frame_buf->data,
+                          cmds[i].frame_buf->size);
             po("\n");
 
             if (cmds[i].frame_mask_buf) {
                 po("NAME MASK:               ");
-                print_hex_str(1, cmds[i].frame_mask_buf->data,
+                print_hex_str(PO_FD, cmds[i].frame_mask_buf->data,
                               cmds[i].frame_mask_buf->size);
                 po("\n");
             }
@@ -419,17 +1167,46 @@ int exec_cmds(int cnt, cmd_t *cmds) {
         }
     }
 
+    // Place the latency signatures in the frames to send
+    err += lat_tx_streams(cnt, cmds);
+    for (i = 0; i < cnt; i++) {
+        if (cmds[i].lat && cmds[i].frame_buf &&
+            lat_tx_prepare(cmds[i].lat, cmds[i].frame, cmds[i].frame_buf) < 0)
+            err++;
+    }
+
     if (err)
         return err;
 
-#ifdef HAS_LIBPCAP
+    if (SESSION_ACTIVE) {
+        for (i = 0; i < cnt; i++) {
+            if (cmds[i].type == CMD_TYPE_NAME && cmds[i].frame_buf &&
+                cmds[i].name)
+                session_name_add(&cmds[i]);
+        }
+    }
+
     for (i = 0; i < cnt; i++) {
         if (cmds[i].type != CMD_TYPE_PCAP)
             continue;
 
         pcap_append(&cmds[i]);
     }
-#endif
+
+    pcap_out_flush_all();
+    if (!SESSION_ACTIVE)
+        pcap_out_close_all();
+
+    for (i = 0; i < cnt; i++) {
+        if (cmds[i].type == CMD_TYPE_GEN && gen_exec(&cmds[i]) < 0)
+            err++;
+    }
+
+    for (i = 0; i < cnt; i++) {
+        if (cmds[i].type == CMD_TYPE_RFC2544 &&
+            rfc2544_run(cmds[i].rfc2544, cmds[i].arg0) < 0)
+            err++;
+    }
 
     // Handle HEX strings
     for (i = 0; i < cnt; i++) {
@@ -438,13 +1215,15 @@ int exec_cmds(int cnt, cmd_t *cmds) {
 
         if (cmds[i].frame_mask_buf && cmds[i].frame_buf) {
             po("DATA: ");
-            print_hex_str(1, cmds[i].frame_buf->data, cmds[i].frame_buf->size);
+            print_hex_str(PO_FD, cmds[i].frame_buf->data,
+                          cmds[i].frame_buf->size);
             po("\nMASK: ");
-            print_hex_str(1, cmds[i].frame_mask_buf->data,
+            print_hex_str(PO_FD, cmds[i].frame_mask_buf->data,
                           cmds[i].frame_buf->size);
             po("\n");
         } else if (cmds[i].frame_buf) {
-            print_hex_str(1, cmds[i].frame_buf->data, cmds[i].frame_buf->size);
+            print_hex_str(PO_FD, cmds[i].frame_buf->data,
+                          cmds[i].frame_buf->size);
             po("\n");
         }
     }
@@ -460,49 +1239,150 @@ int exec_cmds(int cnt, cmd_t *cmds) {
     }
 
     // Open all resources
+    rcvbuf = rcvbuf_estimate(cnt, cmds);
     for (i = 0; i < res_valid; i++) {
-        resources[i].fd = raw_socket(resources[i].cmd->arg0);
+        if (is_rx_file(resources[i].cmd->arg0))
+            continue;
 
-        if (resources[i].fd < 0)
+        resources[i].fd = session_socket_get(resources[i].cmd->arg0);
+        resources[i].stats = stats_if_get(resources[i].cmd->arg0);
+
+        if (resources[i].fd < 0) {
+            for (i = i - 1; i >= 0; i--) {
+                if (resources[i].fd >= 0)
+                    session_socket_put(resources[i].fd);
+            }
             return -1;
+        }
+
+        if (resource_has_rx(&resources[i])) {
+            raw_socket_rcvbuf(resources[i].fd, rcvbuf);
+
+            // Drops from before the test (between tests in a session) do
+            // not count
+            raw_socket_drops(resources[i].fd, &st);
+        }
     }
 
+    for (i = 0; i < res_valid; i++) {
+        for (cmd_ptr = resources[i].cmd; cmd_ptr; cmd_ptr = cmd_ptr->next) {
+            if (cmd_ptr->lat_rx && !resources[i].lat)
+                resources[i].lat = lat_rx_new();
+
+            if (cmd_ptr->seq && resources[i].seq) {
+                pe("ERROR: Only one 'rx %s seq' per interface\n",
+                   cmd_ptr->arg0);
+                err++;
+            } else if (cmd_ptr->seq) {
+                resources[i].seq = cmd_ptr->seq;
+            }
+        }
+    }
+
+    // Recorded files are checked up front, they do not need the timeout
+    for (i = 0; i < res_valid; i++) {
+        if (is_rx_file(resources[i].cmd->arg0) &&
+            rx_file_process(&resources[i]) < 0)
+            err++;
+    }
+
+    snap_cnt = link_snap_begin(cnt, cmds, snaps, 100);
+
     timerclear(&tv_now);
     timerclear(&tv_end);
     timerclear(&tv_left);
     timerclear(&tv_begin);
 
-    tv_left.tv_sec = TIME_OUT_MS / 1000;
-    tv_left.tv_usec = (TIME_OUT_MS - (tv_left.tv_sec * 1000)) * 1000;
+    tv_timeout.tv_sec = TIME_OUT_MS / 1000;
+    tv_timeout.tv_usec = (TIME_OUT_MS - (tv_timeout.tv_sec * 1000)) * 1000;
+    tv_left = tv_timeout;
 
     gettimeofday(&tv_begin, 0);
     timeradd(&tv_begin, &tv_left, &tv_end);
     while (1) {
         fd_max = rfds_wfds_fill(resources, res_valid, &rfds, &wfds);
-        if (fd_max < 0) {
+
+        // In-process captures are serviced until the timeout
+        fd_max = capture_fds_fill(&rfds, fd_max);
+
+        // A replay in progress wakes up at its next deadline
+        wait = replay_wait(resources, res_valid);
+        if (fd_max < 0 && wait < 0) {
             break;
         }
 
-        res = select(fd_max + 1, &rfds, &wfds, 0, &tv_left);
+        tv = tv_left;
+        if (wait >= 0 && wait / 1000 < tv.tv_sec * 1000000LL + tv.tv_usec) {
+            tv.tv_sec = wait / 1000000000;
+            tv.tv_usec = wait % 1000000000 / 1000;
+        }
+
+        // The lines of the frames handled so far are seen while waiting
+        out_flush();
+
+        TIMING_ENTER(TIMING_WAIT, 0);
+        res = select(fd_max + 1, &rfds, &wfds, 0, &tv);
+        TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+        TIMING_LEAVE();
         gettimeofday(&tv_now, 0);
+
+        // The timeout counts from the end of the replay
+        if (wait >= 0)
+            timeradd(&tv_now, &tv_timeout, &tv_end);
+
         if (timercmp(&tv_now, &tv_end, >)) {
             break;
         }
         timersub(&tv_end, &tv_now, &tv_left);
 
-        if (res == 0) {
+        if (res == 0 && wait >= 0) {
+            continue;
+        } else if (res == 0) {
             break;
         } else if (res < 0) {
             break;
         }
 
+        capture_fds_process(&rfds);
         rfds_wfds_process(resources, res_valid, &rfds, &wfds);
     }
 
+    // Frames with a latency signature or a sequence number are counted, not
+    // matched, so all of them count
+    for (i = 0; i < res_valid; i++) {
+        if (resources[i].fd >= 0 && (resources[i].lat || resources[i].seq))
+            rx_queue_read(&resources[i]);
+    }
+
+    for (i = 0; i < res_valid; i++) {
+        if (resources[i].seq)
+            err += seq_rx_report(resources[i].seq, resources[i].cmd->arg0);
+
+        if (!resources[i].lat)
+            continue;
+
+        for (cmd_ptr = cmds; cmd_ptr < cmds + cnt; cmd_ptr++) {
+            if (cmd_ptr->type == CMD_TYPE_TX && cmd_ptr->lat)
+                lat_rx_sent(resources[i].lat, cmd_ptr->lat);
+        }
+
+        err += lat_rx_report(resources[i].lat, resources[i].cmd->arg0);
+        lat_rx_free(resources[i].lat);
+        resources[i].lat = 0;
+    }
+
+    err += link_snap_end(cnt, cmds, snaps, snap_cnt);
+
+    // The result of a test with host drops is not trusted, even if it passed
+    EXEC_HOST_DROPS = host_drops_report(resources, res_valid);
+    if (EXEC_HOST_DROPS)
+        err++;
+
     // close resources
+    TIMING_ENTER(TIMING_TEARDOWN, 0);
     for (i = 0; i < res_valid; i++) {
         if (resources[i].fd >= 0) {
-            close(resources[i].fd);
+            session_socket_put(resources[i].fd);
             resources[i].fd = -1;
         }
     }
@@ -512,6 +1392,10 @@ int exec_cmds(int cnt, cmd_t *cmds) {
         err += resources[i].rx_err_cnt;
 
         for (cmd_ptr = resources[i].cmd; cmd_ptr; cmd_ptr = cmd_ptr->next) {
+            if (cmd_ptr->replay &&
+                (cmd_ptr->replay->failed || cmd_ptr->replay->err))
+                err++;
+
             if (cmd_ptr->type != CMD_TYPE_RX)
                 continue;
 
@@ -521,16 +1405,20 @@ int exec_cmds(int cnt, cmd_t *cmds) {
             if (cmd_ptr->done)
                 continue;
 
+            result_add(RESULT_NO_RX, cmd_ptr->idx, cmd_ptr->arg0, 0,
+                       TS_SRC_HOST, cmd_ptr->frame_buf->size, cmd_ptr->name);
             pe("NO-RX  %16s: ", cmd_ptr->arg0);
+            if (cmd_ptr->repeat > 1)
+                pe("%u times ", cmd_ptr->repeat);
             if (cmd_ptr->name) {
                 pe("name %s", cmd_ptr->name);
             } else {
-                print_hex_str(2, cmd_ptr->frame_buf->data,
+                print_hex_str(PE_FD, cmd_ptr->frame_buf->data,
                               cmd_ptr->frame_buf->size);
                 pe("\n");
                 if (cmd_ptr->frame_mask_buf) {
                     pe("NO-RX MASK:              ");
-                    print_hex_str(2, cmd_ptr->frame_mask_buf->data,
+                    print_hex_str(PE_FD, cmd_ptr->frame_mask_buf->data,
                                   cmd_ptr->frame_mask_buf->size);
                     pe("\n");
                 }
@@ -542,5 +1430,8 @@ int exec_cmds(int cnt, cmd_t *cmds) {
         }
     }
 
+    result_flush();
+    TIMING_LEAVE();
+
     return err;
 }
@@ -0,0 +1,599 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "ef.h"
+
+// Frames of a sweep are generated by worker threads in blocks, and written in
+// order by the calling thread. A block slot is reused when it is written.
+#define GEN_DIM_MAX      16
+#define GEN_THREADS_MAX  64
+#define GEN_BLOCK_FRAMES 1024
+#define GEN_WORD_SIZE    24
+
+// Frames which must be built again are cached per thread, if there are no
+// more combinations than this of the values which can not be patched.
+#define GEN_TMPL_MAX     1024
+
+typedef struct {
+    int      argv_idx;
+    uint64_t first;
+    uint64_t cnt;
+
+    // Set if the value can be written into an already built frame. Otherwise
+    // the frame is built again when the value changes.
+    int      patch;
+    int      stack_idx;
+    int      field_idx;
+} gen_dim_t;
+
+struct gen {
+    int        argc;
+    char     **argv;
+    int        threads;
+    int        shards;
+    int        dim_cnt;
+    gen_dim_t  dims[GEN_DIM_MAX];
+    uint64_t   cnt;
+
+    // Combinations of the values which can not be patched
+    uint64_t   key_cnt;
+};
+
+typedef struct {
+    frame_t *frame;
+    buf_t   *tmpl;
+} gen_tmpl_t;
+
+// Per thread state for building frames
+typedef struct {
+    const gen_t *g;
+    const char **argv;
+    char       (*words)[GEN_WORD_SIZE];
+    gen_tmpl_t  *tmpls;
+    uint64_t     tmpl_cnt;
+    gen_tmpl_t  *cur;
+    uint64_t     key;
+} gen_builder_t;
+
+typedef struct {
+    uint64_t  seq;
+    int       done;
+    uint32_t  cnt;
+    uint32_t  len[GEN_BLOCK_FRAMES];
+    uint8_t  *data;
+    size_t    data_size;
+    size_t    data_len;
+} gen_block_t;
+
+typedef struct {
+    const gen_t    *g;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    gen_block_t    *blocks;
+    int             block_cnt;
+    uint64_t        seq_next;
+    uint64_t        seq_cnt;
+    int             err;
+} gen_job_t;
+
+void gen_free(gen_t *g) {
+    int i;
+
+    if (!g)
+        return;
+
+    for (i = 0; i < g->argc; ++i)
+        free(g->argv[i]);
+
+    free(g->argv);
+    free(g);
+}
+
+// Parse '<first>..<last>'
+static int gen_range_parse(const char *s, uint64_t *first, uint64_t *last) {
+    const char *dots = strstr(s, "..");
+    char *end;
+
+    if (!dots || dots == s)
+        return 0;
+
+    *first = strtoull(s, &end, 0);
+    if (end != dots)
+        return 0;
+
+    *last = strtoull(dots + 2, &end, 0);
+    if (end == dots + 2 || *end)
+        return 0;
+
+    return 1;
+}
+
+static void gen_builder_init(gen_builder_t *b, const gen_t *g, int cache) {
+    int i;
+
+    memset(b, 0, sizeof(*b));
+    b->g = g;
+    b->argv = calloc(g->argc ? g->argc : 1, sizeof(*b->argv));
+    b->words = calloc(g->dim_cnt ? g->dim_cnt : 1, sizeof(*b->words));
+    b->key = UINT64_MAX;
+    b->tmpl_cnt = cache && g->key_cnt <= GEN_TMPL_MAX ? g->key_cnt : 1;
+    b->tmpls = calloc(b->tmpl_cnt, sizeof(*b->tmpls));
+    b->cur = b->tmpls;
+
+    for (i = 0; i < g->argc; ++i)
+        b->argv[i] = g->argv[i];
+
+    for (i = 0; i < g->dim_cnt; ++i)
+        b->argv[g->dims[i].argv_idx] = b->words[i];
+}
+
+static void gen_builder_uninit(gen_builder_t *b) {
+    uint64_t i;
+
+    for (i = 0; i < b->tmpl_cnt; ++i) {
+        if (b->tmpls[i].frame)
+            frame_free(b->tmpls[i].frame);
+        bfree(b->tmpls[i].tmpl);
+    }
+
+    free(b->tmpls);
+    free(b->argv);
+    free(b->words);
+}
+
+// Build the frame from the command line words, with the values of #val
+static int gen_builder_build(gen_builder_t *b, const uint64_t *val) {
+    const gen_t *g = b->g;
+    int i;
+
+    for (i = 0; i < g->dim_cnt; ++i)
+        snprintf(b->words[i], GEN_WORD_SIZE, "%" PRIu64, val[i]);
+
+    if (b->cur->frame)
+        frame_free(b->cur->frame);
+
+    bfree(b->cur->tmpl);
+    b->cur->tmpl = 0;
+    b->key = UINT64_MAX;
+
+    b->cur->frame = frame_alloc();
+    if (argc_frame(g->argc, b->argv, b->cur->frame) != g->argc)
+        return -1;
+
+    b->cur->tmpl = frame_to_buf(b->cur->frame);
+
+    return b->cur->tmpl ? 0 : -1;
+}
+
+// Write #v into the field of a dimension
+static void gen_patch(gen_builder_t *b, buf_t *o, const gen_dim_t *d,
+                      uint64_t v) {
+    hdr_t *h = b->cur->frame->stack[d->stack_idx];
+    field_t *f = &h->fields[d->field_idx];
+    uint8_t d_[8];
+    buf_t val = { .size = BIT_TO_BYTE(f->bit_width), .data = d_ };
+    int i;
+
+    for (i = val.size - 1; i >= 0; --i, v >>= 8)
+        d_[i] = v & 0xff;
+
+    hdr_write_field(o, h->offset_in_frame, f, &val);
+}
+
+// Get the frame of variant #idx ready, and the values of its dimensions. The
+// frame is only built again when a value which can not be patched changes.
+static int gen_builder_prepare(gen_builder_t *b, uint64_t idx, uint64_t *val) {
+    const gen_t *g = b->g;
+    uint64_t key = 0;
+    int i;
+
+    for (i = g->dim_cnt - 1; i >= 0; --i) {
+        val[i] = g->dims[i].first + idx % g->dims[i].cnt;
+        idx /= g->dims[i].cnt;
+    }
+
+    for (i = 0; i < g->dim_cnt; ++i) {
+        if (!g->dims[i].patch)
+            key = key * g->dims[i].cnt + val[i] - g->dims[i].first;
+    }
+
+    if (b->tmpl_cnt > 1) {
+        b->cur = &b->tmpls[key];
+        if (!b->cur->tmpl && gen_builder_build(b, val) < 0)
+            return -1;
+    } else if (key != b->key) {
+        if (gen_builder_build(b, val) < 0)
+            return -1;
+        b->key = key;
+    }
+
+    return 0;
+}
+
+// Copy the prepared frame to #o, and write the values which are patched
+static void gen_builder_frame(gen_builder_t *b, const uint64_t *val,
+                              uint8_t *o) {
+    const gen_t *g = b->g;
+    buf_t ob = { .size = b->cur->tmpl->size, .data = o };
+    int i;
+
+    memcpy(o, b->cur->tmpl->data, ob.size);
+
+    for (i = 0; i < g->dim_cnt; ++i) {
+        if (g->dims[i].patch)
+            gen_patch(b, &ob, &g->dims[i], val[i]);
+    }
+}
+
+// Find the field a dimension is the value of, and check that writing the
+// value gives the same frame as building it.
+static void gen_dim_compile(gen_t *g, gen_dim_t *d, gen_builder_t *b,
+                            gen_builder_t *probe) {
+    uint64_t val[GEN_DIM_MAX], p[3] = { 0, 1, d->cnt - 1 };
+    int i, j, stack_idx = -1;
+    const char *hdr_name = 0;
+    field_t *f;
+    hdr_t *h;
+    buf_t *o;
+
+    if (d->argv_idx == 0)
+        return;
+
+    for (i = 0; i < d->argv_idx; ++i) {
+        if (hdr_tmpl_find(g->argv[i])) {
+            hdr_name = g->argv[i];
+            stack_idx++;
+        }
+    }
+
+    for (i = 0; i < g->dim_cnt; ++i)
+        val[i] = g->dims[i].first;
+
+    if (gen_builder_build(b, val) < 0 || stack_idx < 0 ||
+        stack_idx >= b->cur->frame->stack_size ||
+        strcmp(b->cur->frame->stack[stack_idx]->name, hdr_name) != 0)
+        return;
+
+    h = b->cur->frame->stack[stack_idx];
+    f = find_field(h, g->argv[d->argv_idx - 1]);
+    if (!f || f->bit_width > 64)
+        return;
+
+    d->stack_idx = stack_idx;
+    d->field_idx = f - h->fields;
+
+    o = balloc(b->cur->tmpl->size);
+    for (i = 0; i < 3 && p[i] < d->cnt; ++i) {
+        j = d - g->dims;
+        val[j] = d->first + p[i];
+        if (gen_builder_build(probe, val) < 0 ||
+            probe->cur->tmpl->size != b->cur->tmpl->size)
+            break;
+
+        memcpy(o->data, b->cur->tmpl->data, o->size);
+        gen_patch(b, o, d, val[j]);
+        if (!bequal(o, probe->cur->tmpl))
+            break;
+    }
+
+    d->patch = i == 3 || p[i] >= d->cnt;
+    bfree(o);
+}
+
+// Parse '[threads <cnt>] [shards <cnt>] FRAME', where the values in FRAME may
+// be ranges: '<first>..<last>'. Returns the number of arguments consumed, or
+// -1.
+int argc_gen(int argc, const char *argv[], gen_t **out) {
+    gen_builder_t b, probe;
+    uint64_t first, last, val[GEN_DIM_MAX];
+    gen_t *g;
+    int i = 0, j, res;
+    long cpus;
+
+    g = calloc(1, sizeof(*g));
+    if (!g)
+        return -1;
+
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    g->threads = cpus < 1 ? 1 : cpus > GEN_THREADS_MAX ? GEN_THREADS_MAX : cpus;
+    g->shards = 1;
+
+    while (i + 1 < argc) {
+        if (strcmp(argv[i], "threads") == 0) {
+            g->threads = atoi(argv[i + 1]);
+            if (g->threads < 1 || g->threads > GEN_THREADS_MAX) {
+                po("ERROR: gen: threads must be 1..%d\n", GEN_THREADS_MAX);
+                goto ERR;
+            }
+        } else if (strcmp(argv[i], "shards") == 0) {
+            g->shards = atoi(argv[i + 1]);
+            if (g->shards < 1) {
+                po("ERROR: gen: Invalid shard count: %s\n", argv[i + 1]);
+                goto ERR;
+            }
+        } else {
+            break;
+        }
+        i += 2;
+    }
+
+    argv += i;
+    argc -= i;
+
+    g->argv = calloc(argc ? argc : 1, sizeof(*g->argv));
+    for (j = 0; j < argc; ++j) {
+        g->argv[g->argc++] = strdup(argv[j]);
+        if (!gen_range_parse(argv[j], &first, &last))
+            continue;
+
+        if (first > last || g->dim_cnt == GEN_DIM_MAX) {
+            po("ERROR: gen: Invalid range: %s\n", argv[j]);
+            goto ERR;
+        }
+
+        g->dims[g->dim_cnt].argv_idx = j;
+        g->dims[g->dim_cnt].first = first;
+        g->dims[g->dim_cnt].cnt = last - first + 1;
+        g->dim_cnt++;
+    }
+
+    // The frame ends where the frame parser stops
+    gen_builder_init(&b, g, 0);
+    for (j = 0; j < g->dim_cnt; ++j)
+        snprintf(b.words[j], GEN_WORD_SIZE, "%" PRIu64, g->dims[j].first);
+
+    b.cur->frame = frame_alloc();
+    res = argc_frame(g->argc, b.argv, b.cur->frame);
+    gen_builder_uninit(&b);
+
+    if (res <= 0) {
+        po("ERROR: gen: Missing or invalid frame\n");
+        goto ERR;
+    }
+
+    for (j = res; j < g->argc; ++j)
+        free(g->argv[j]);
+    g->argc = res;
+
+    // Ranges of the following commands are not ours
+    while (g->dim_cnt && g->dims[g->dim_cnt - 1].argv_idx >= res)
+        g->dim_cnt--;
+
+    g->cnt = 1;
+    for (j = 0; j < g->dim_cnt; ++j) {
+        if (g->dims[j].cnt == 0 || g->cnt > UINT64_MAX / g->dims[j].cnt) {
+            po("ERROR: gen: Too many variants\n");
+            goto ERR;
+        }
+        g->cnt *= g->dims[j].cnt;
+    }
+
+    // The last value of all ranges must be valid too
+    gen_builder_init(&b, g, 0);
+    for (j = 0; j < g->dim_cnt; ++j)
+        val[j] = g->dims[j].first + g->dims[j].cnt - 1;
+    res = gen_builder_build(&b, val);
+    gen_builder_uninit(&b);
+    if (res < 0) {
+        po("ERROR: gen: Invalid frame\n");
+        goto ERR;
+    }
+
+    gen_builder_init(&b, g, 0);
+    gen_builder_init(&probe, g, 0);
+    for (j = 0; j < g->dim_cnt; ++j)
+        gen_dim_compile(g, &g->dims[j], &b, &probe);
+    gen_builder_uninit(&b);
+    gen_builder_uninit(&probe);
+
+    g->key_cnt = 1;
+    for (j = 0; j < g->dim_cnt; ++j) {
+        if (!g->dims[j].patch)
+            g->key_cnt *= g->dims[j].cnt;
+    }
+
+    *out = g;
+
+    return i + g->argc;
+
+ERR:
+    gen_free(g);
+    return -1;
+}
+
+uint64_t gen_cnt(const gen_t *g) {
+    return g->cnt;
+}
+
+static int gen_block_build(gen_builder_t *b, gen_block_t *blk,
+                           uint64_t first, uint64_t cnt) {
+    uint64_t val[GEN_DIM_MAX];
+    uint32_t i;
+    size_t len;
+
+    blk->cnt = 0;
+    blk->data_len = 0;
+
+    for (i = 0; i < cnt; ++i) {
+        if (gen_builder_prepare(b, first + i, val) < 0)
+            return -1;
+
+        len = b->cur->tmpl->size;
+        if (blk->data_size - blk->data_len < len) {
+            blk->data_size = 2 * (blk->data_len + len);
+            blk->data = realloc(blk->data, blk->data_size);
+            if (!blk->data)
+                return -1;
+        }
+
+        gen_builder_frame(b, val, blk->data + blk->data_len);
+        blk->len[i] = len;
+        blk->data_len += len;
+        blk->cnt++;
+    }
+
+    return 0;
+}
+
+static void *gen_worker(void *arg) {
+    gen_job_t *job = arg;
+    const gen_t *g = job->g;
+    gen_builder_t b;
+    gen_block_t *blk;
+    uint64_t seq, first;
+    int res;
+
+    gen_builder_init(&b, g, 1);
+
+    pthread_mutex_lock(&job->lock);
+    while (!job->err && job->seq_next < job->seq_cnt) {
+        seq = job->seq_next;
+        blk = &job->blocks[seq % job->block_cnt];
+
+        // Wait for the writer to be done with the slot
+        if (blk->seq != seq) {
+            pthread_cond_wait(&job->cond, &job->lock);
+            continue;
+        }
+
+        job->seq_next++;
+        pthread_mutex_unlock(&job->lock);
+
+        first = seq * GEN_BLOCK_FRAMES;
+        res = gen_block_build(&b, blk, first,
+                              g->cnt - first < GEN_BLOCK_FRAMES ?
+                              g->cnt - first : GEN_BLOCK_FRAMES);
+
+        pthread_mutex_lock(&job->lock);
+        if (res < 0)
+            job->err = 1;
+        blk->done = 1;
+        pthread_cond_broadcast(&job->cond);
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    gen_builder_uninit(&b);
+
+    return 0;
+}
+
+// Name of shard #idx: 'x.pcap' becomes 'x-000.pcap', 'x-001.pcap', ...
+static char *gen_shard_path(const char *path, int shards, int idx) {
+    const char *ext = strrchr(path, '.');
+    const char *dir = strrchr(path, '/');
+    size_t size = strlen(path) + 16;
+    char *s;
+
+    if (shards == 1)
+        return strdup(path);
+
+    if (!ext || (dir && dir > ext))
+        ext = path + strlen(path);
+
+    s = malloc(size);
+    if (s)
+        snprintf(s, size, "%.*s-%03d%s", (int)(ext - path), path, idx, ext);
+
+    return s;
+}
+
+// Write all variants to #path, in order. Frames are time stamped 1us apart.
+// Returns the number of frames written, or -1.
+int64_t gen_run(const gen_t *g, const char *path) {
+    pthread_t threads[GEN_THREADS_MAX];
+    pcap_writer_t *w = 0;
+    struct timespec ts;
+    gen_block_t *blk;
+    gen_job_t job = {};
+    uint64_t seq, idx = 0, shard_end = 0;
+    int i, t, if_id = 0, shard = -1, err = 0;
+    int shards = g->cnt < (uint64_t)g->shards ? (int)g->cnt : g->shards;
+    size_t off;
+    char *p;
+
+    job.g = g;
+    job.seq_cnt = DIV_ROUND(g->cnt, GEN_BLOCK_FRAMES);
+    job.block_cnt = 2 * g->threads;
+    job.blocks = calloc(job.block_cnt, sizeof(*job.blocks));
+    if (!job.blocks)
+        return -1;
+
+    for (i = 0; i < job.block_cnt; ++i)
+        job.blocks[i].seq = i;
+
+    pthread_mutex_init(&job.lock, 0);
+    pthread_cond_init(&job.cond, 0);
+
+    for (t = 0; t < g->threads; ++t) {
+        if (pthread_create(&threads[t], 0, gen_worker, &job) != 0)
+            break;
+    }
+
+    if (t == 0)
+        err = 1;
+
+    for (seq = 0; !err && seq < job.seq_cnt; ++seq) {
+        blk = &job.blocks[seq % job.block_cnt];
+
+        pthread_mutex_lock(&job.lock);
+        while (!blk->done && !job.err)
+            pthread_cond_wait(&job.cond, &job.lock);
+        err = job.err;
+        pthread_mutex_unlock(&job.lock);
+
+        for (i = 0, off = 0; !err && i < (int)blk->cnt; ++i, ++idx) {
+            if (idx == shard_end) {
+                if (w && pcap_writer_close(w) < 0)
+                    err = 1;
+
+                shard++;
+                shard_end = g->cnt / shards * (shard + 1) +
+                            (shard + 1 == shards ? g->cnt % shards : 0);
+                p = gen_shard_path(path, shards, shard);
+                w = p ? pcap_writer_open(p, 65535, 0) : 0;
+                free(p);
+                if (!w) {
+                    err = 1;
+                    break;
+                }
+                if_id = pcap_writer_if(w, 0);
+            }
+
+            ts.tv_sec = idx / 1000000;
+            ts.tv_nsec = idx % 1000000 * 1000;
+            if (pcap_writer_write(w, if_id, &ts, blk->data + off,
+                                  blk->len[i]) < 0) {
+                pe("ERROR: Failed to write %s: %m\n", path);
+                err = 1;
+            }
+            off += blk->len[i];
+        }
+
+        // Hand the slot to the block which is #block_cnt ahead
+        pthread_mutex_lock(&job.lock);
+        blk->done = 0;
+        blk->seq = seq + job.block_cnt;
+        if (err)
+            job.err = 1;
+        pthread_cond_broadcast(&job.cond);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    for (i = 0; i < t; ++i)
+        pthread_join(threads[i], 0);
+
+    if (w && pcap_writer_close(w) < 0)
+        err = 1;
+
+    for (i = 0; i < job.block_cnt; ++i)
+        free(job.blocks[i].data);
+
+    free(job.blocks);
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.cond);
+
+    return err ? -1 : (int64_t)idx;
+}
@@ -0,0 +1,210 @@
+#include "ef.h"
+#include <stdio.h>
+
+// Minimal perfect hash for a fixed set of names, using "hash and displace":
+// The names are first hashed into buckets, and each bucket is then assigned a
+// displacement which places all names in the bucket in distinct free slots.
+// A lookup is one pass over the name, two table reads and a single strcmp()
+// to reject unknown names.
+
+#define NAME_HASH_DISP_MAX 0xffff
+
+typedef struct {
+    const char *name;
+    int         idx;
+} name_hash_slot_t;
+
+struct name_hash {
+    uint32_t          bucket_mask;
+    uint32_t          slot_mask;
+    uint16_t         *disp;
+    name_hash_slot_t *slots;
+};
+
+static uint32_t fmix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+// 64-bit FNV-1a. The low half selects the bucket, the high half the slot.
+static uint64_t name_hash_fnv(const char *s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (; *s; s++) {
+        h ^= (uint8_t)*s;
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+static uint32_t name_hash_bucket(const name_hash_t *h, uint64_t hv) {
+    return fmix32((uint32_t)hv) & h->bucket_mask;
+}
+
+static uint32_t name_hash_slot(const name_hash_t *h, uint64_t hv, uint32_t d) {
+    return fmix32((uint32_t)(hv >> 32) + d * 0x9e3779b9) & h->slot_mask;
+}
+
+static uint32_t pow2_roundup(uint32_t v) {
+    uint32_t r = 1;
+
+    while (r < v)
+        r <<= 1;
+
+    return r;
+}
+
+typedef struct {
+    int      idx;
+    uint64_t hv;
+    uint32_t bucket;
+    int      bucket_size;
+} name_hash_key_t;
+
+static int name_hash_bucket_cmp(const void *a_, const void *b_) {
+    const name_hash_key_t *a = a_, *b = b_;
+
+    // Largest buckets first, they are the hardest to place
+    if (a->bucket_size != b->bucket_size)
+        return b->bucket_size - a->bucket_size;
+
+    if (a->bucket != b->bucket)
+        return a->bucket < b->bucket ? -1 : 1;
+
+    return a->idx - b->idx;
+}
+
+// Try to place all buckets. Returns 0 on success.
+static int name_hash_place(name_hash_t *h, const char * const names[],
+                           name_hash_key_t *keys, int key_cnt) {
+    int i, j, k, end;
+    uint32_t d, slot;
+
+    for (i = 0; i < key_cnt; i = end) {
+        for (end = i; end < key_cnt && keys[end].bucket == keys[i].bucket;)
+            end++;
+
+        for (d = 0; d <= NAME_HASH_DISP_MAX; ++d) {
+            for (j = i; j < end; ++j) {
+                slot = name_hash_slot(h, keys[j].hv, d);
+                if (h->slots[slot].name)
+                    break;
+
+                h->slots[slot].name = names[keys[j].idx];
+                h->slots[slot].idx = keys[j].idx;
+            }
+
+            if (j == end)
+                break;
+
+            // Collision, undo the slots taken by this bucket and retry
+            for (k = i; k < j; ++k) {
+                slot = name_hash_slot(h, keys[k].hv, d);
+                h->slots[slot].name = 0;
+            }
+        }
+
+        if (d > NAME_HASH_DISP_MAX)
+            return -1;
+
+        h->disp[keys[i].bucket] = d;
+    }
+
+    return 0;
+}
+
+// Build a perfect hash of 'names'. Null entries are skipped, and if a name is
+// present more than once, then the first index is used.
+name_hash_t *name_hash_new(const char * const names[], int cnt) {
+    int i, j, key_cnt = 0, *bucket_cnt = 0;
+    uint32_t slot_cnt, bucket_cnt_max;
+    name_hash_key_t *keys;
+    name_hash_t *h = 0;
+
+    keys = calloc(cnt ? cnt : 1, sizeof(*keys));
+    if (!keys)
+        return 0;
+
+    for (i = 0; i < cnt; ++i) {
+        if (!names[i])
+            continue;
+
+        for (j = 0; j < key_cnt; ++j)
+            if (strcmp(names[keys[j].idx], names[i]) == 0)
+                break;
+
+        if (j < key_cnt)
+            continue;
+
+        keys[key_cnt].idx = i;
+        keys[key_cnt].hv = name_hash_fnv(names[i]);
+        key_cnt++;
+    }
+
+    // Keep the load factor of the slot table below 0.5, and grow the table
+    // if the buckets can not be placed.
+    for (slot_cnt = pow2_roundup(2 * key_cnt + 2); slot_cnt <= (1 << 20);
+         slot_cnt <<= 1) {
+        bucket_cnt_max = pow2_roundup(key_cnt / 2 + 1);
+
+        h = calloc(1, sizeof(*h) + bucket_cnt_max * sizeof(uint16_t) +
+                   slot_cnt * sizeof(name_hash_slot_t));
+        bucket_cnt = calloc(bucket_cnt_max, sizeof(int));
+        if (!h || !bucket_cnt)
+            break;
+
+        h->bucket_mask = bucket_cnt_max - 1;
+        h->slot_mask = slot_cnt - 1;
+        h->slots = (name_hash_slot_t *)(h + 1);
+        h->disp = (uint16_t *)(h->slots + slot_cnt);
+
+        for (i = 0; i < key_cnt; ++i) {
+            keys[i].bucket = name_hash_bucket(h, keys[i].hv);
+            bucket_cnt[keys[i].bucket]++;
+        }
+
+        for (i = 0; i < key_cnt; ++i)
+            keys[i].bucket_size = bucket_cnt[keys[i].bucket];
+
+        qsort(keys, key_cnt, sizeof(*keys), name_hash_bucket_cmp);
+
+        if (name_hash_place(h, names, keys, key_cnt) == 0) {
+            free(bucket_cnt);
+            free(keys);
+            return h;
+        }
+
+        free(bucket_cnt);
+        bucket_cnt = 0;
+        free(h);
+        h = 0;
+    }
+
+    free(bucket_cnt);
+    free(h);
+    free(keys);
+
+    return 0;
+}
+
+// Returns the index of 'name' as given to name_hash_new(), or -1
+int name_hash_find(const name_hash_t *h, const char *name) {
+    uint64_t hv = name_hash_fnv(name);
+    const name_hash_slot_t *s;
+
+    s = &h->slots[name_hash_slot(h, hv, h->disp[name_hash_bucket(h, hv)])];
+    if (!s->name || strcmp(s->name, name) != 0)
+        return -1;
+
+    return s->idx;
+}
+
+void name_hash_free(name_hash_t *h) {
+    free(h);
+}
@@ -0,0 +1,299 @@
+#include "ef.h"
+#include <stdio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HEX_HAS_X86 1
+#endif
+
+// Hex encoding and decoding, shared by the parsers and the output layer.
+//
+// Both directions have a scalar implementation, and on x86 also SSSE3 and
+// AVX2 kernels which are selected at startup based on what the CPU supports.
+// The decoder accepts the delimiters '.', ':', '-' and '_' between bytes. The
+// vector kernels only handle runs of plain hex digits, everything else
+// (delimiters, errors, tails) is left to the scalar loop.
+
+typedef void (*hex_encode_fn_t)(char *o, const uint8_t *d, size_t len);
+typedef size_t (*hex_decode_run_fn_t)(uint8_t *o, const char *s, size_t len);
+
+static const char HEX_TBL[] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+// Value of each hex digit plus one, zero for all other characters
+static const uint8_t HEX_VAL[256] = {
+    ['0'] =  1, ['1'] =  2, ['2'] =  3, ['3'] =  4, ['4'] =  5,
+    ['5'] =  6, ['6'] =  7, ['7'] =  8, ['8'] =  9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+static int is_hex_delim(char c) {
+    return c == '.' || c == ':' || c == '-' || c == '_';
+}
+
+static void hex_encode_scalar(char *o, const uint8_t *d, size_t len) {
+    size_t i;
+
+    for (i = 0; i < len; ++i, o += 2)
+        memcpy(o, HEX_TBL + 2 * d[i], 2);
+}
+
+// Decode the longest prefix of s[0..len[ which is a whole number of vector
+// blocks of hex digits. Returns the number of characters consumed.
+static size_t hex_decode_run_scalar(uint8_t *o, const char *s, size_t len) {
+    return 0;
+}
+
+#ifdef HEX_HAS_X86
+__attribute__((target("ssse3")))
+static void hex_encode_ssse3(char *o, const uint8_t *d, size_t len) {
+    const __m128i lut = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                      '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i v, hi, lo;
+
+    for (; len >= 16; len -= 16, d += 16, o += 32) {
+        v = _mm_loadu_si128((const __m128i *)d);
+        hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *)o, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(o + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+
+    hex_encode_scalar(o, d, len);
+}
+
+__attribute__((target("avx2")))
+static void hex_encode_avx2(char *o, const uint8_t *d, size_t len) {
+    const __m256i lut = _mm256_setr_epi8(
+            '0', '1', '2', '3', '4', '5', '6', '7',
+            '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+            '0', '1', '2', '3', '4', '5', '6', '7',
+            '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i v, hi, lo, a, b;
+
+    for (; len >= 32; len -= 32, d += 32, o += 64) {
+        v = _mm256_loadu_si256((const __m256i *)d);
+        hi = _mm256_shuffle_epi8(lut,
+                _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+
+        // The unpacks work within each 128-bit lane, put the lanes in order
+        a = _mm256_unpacklo_epi8(hi, lo);
+        b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *)o, _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *)(o + 32),
+                            _mm256_permute2x128_si256(a, b, 0x31));
+    }
+
+    hex_encode_ssse3(o, d, len);
+}
+
+// Convert 16 hex digits to nibbles. Returns a mask with a bit set for each
+// character which is not a hex digit.
+__attribute__((target("ssse3")))
+static int hex_nibbles_ssse3(__m128i v, __m128i *nibbles) {
+    __m128i lower, digit, alpha, d, a;
+
+    // Folding to lower case does not change the digits
+    lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                          _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                          _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+    d = _mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0')));
+    a = _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+    *nibbles = _mm_or_si128(d, a);
+
+    return ~_mm_movemask_epi8(_mm_or_si128(digit, alpha)) & 0xffff;
+}
+
+__attribute__((target("ssse3")))
+static size_t hex_decode_run_ssse3(uint8_t *o, const char *s, size_t len) {
+    // Each 16-bit lane is (high nibble * 16 + low nibble)
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    __m128i n;
+    size_t done = 0;
+
+    for (; len - done >= 16; done += 16, o += 8) {
+        if (hex_nibbles_ssse3(_mm_loadu_si128((const __m128i *)(s + done)),
+                              &n))
+            break;
+
+        n = _mm_maddubs_epi16(n, weights);
+        _mm_storel_epi64((__m128i *)o, _mm_packus_epi16(n, n));
+    }
+
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t hex_decode_run_avx2(uint8_t *o, const char *s, size_t len) {
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    const __m256i c0 = _mm256_set1_epi8('0' - 1), c9 = _mm256_set1_epi8('9' + 1);
+    const __m256i ca = _mm256_set1_epi8('a' - 1), cf = _mm256_set1_epi8('f' + 1);
+    __m256i v, lower, digit, alpha, n;
+    size_t done = 0;
+
+    for (; len - done >= 32; done += 32, o += 16) {
+        v = _mm256_loadu_si256((const __m256i *)(s + done));
+        lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, c0),
+                                 _mm256_cmpgt_epi8(c9, v));
+        alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, ca),
+                                 _mm256_cmpgt_epi8(cf, lower));
+
+        if (_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != -1)
+            break;
+
+        n = _mm256_or_si256(
+                _mm256_and_si256(digit,
+                                 _mm256_sub_epi8(v, _mm256_set1_epi8('0'))),
+                _mm256_and_si256(alpha,
+                                 _mm256_sub_epi8(lower,
+                                                 _mm256_set1_epi8('a' - 10))));
+        n = _mm256_maddubs_epi16(n, weights);
+
+        // Packing works within each 128-bit lane, gather the two low halves
+        n = _mm256_permute4x64_epi64(_mm256_packus_epi16(n, n), 0xd8);
+        _mm_storeu_si128((__m128i *)o, _mm256_castsi256_si128(n));
+    }
+
+    return done + hex_decode_run_ssse3(o, s + done, len - done);
+}
+#endif
+
+static hex_encode_fn_t HEX_ENCODE = hex_encode_scalar;
+static hex_decode_run_fn_t HEX_DECODE_RUN = hex_decode_run_scalar;
+static const char *HEX_IMPL = "scalar";
+
+// Select the implementation, "scalar", "ssse3" or "avx2". Returns -1 if it is
+// not supported by the CPU.
+int hex_impl_select(const char *name) {
+    if (strcmp(name, "scalar") == 0) {
+        HEX_ENCODE = hex_encode_scalar;
+        HEX_DECODE_RUN = hex_decode_run_scalar;
+        HEX_IMPL = "scalar";
+        return 0;
+    }
+
+#ifdef HEX_HAS_X86
+    __builtin_cpu_init();
+
+    if (strcmp(name, "ssse3") == 0 && __builtin_cpu_supports("ssse3")) {
+        HEX_ENCODE = hex_encode_ssse3;
+        HEX_DECODE_RUN = hex_decode_run_ssse3;
+        HEX_IMPL = "ssse3";
+        return 0;
+    }
+
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        HEX_ENCODE = hex_encode_avx2;
+        HEX_DECODE_RUN = hex_decode_run_avx2;
+        HEX_IMPL = "avx2";
+        return 0;
+    }
+#endif
+
+    return -1;
+}
+
+const char *hex_impl_name() {
+    return HEX_IMPL;
+}
+
+static void hex_init() __attribute__ ((constructor));
+static void hex_init() {
+    if (hex_impl_select("avx2") == 0)
+        return;
+
+    hex_impl_select("ssse3");
+}
+
+// Write 2 * len hex characters (no termination) to o
+void hex_encode(char *o, const uint8_t *d, size_t len) {
+    HEX_ENCODE(o, d, len);
+}
+
+// Decode the hex string s[0..len[ into o, which has room for o_size bytes.
+// The number of decoded bytes is returned in o_len. Delimiters are allowed
+// between bytes, but not within a byte.
+//
+// Returns HEX_DECODE_INVALID if the string has other characters (or no hex
+// digits at all), else HEX_DECODE_ALIGN if a delimiter or the end of the
+// string splits a byte, else HEX_DECODE_SIZE if o_size is too small.
+int hex_decode(const char *s, size_t len, uint8_t *o, size_t o_size,
+               size_t *o_len) {
+    size_t i = 0, n = 0, run, simd_from = 0;
+    int err = 0;
+    uint8_t v, hi = 0;
+    int odd = 0;
+
+    while (i < len) {
+        // Try the vector kernel on byte boundaries, but back off for a while
+        // after a miss such that short delimited groups are cheap.
+        if (!odd && !err && i >= simd_from && n < o_size) {
+            run = HEX_DECODE_RUN(o + n, s + i,
+                                 (o_size - n) * 2 < len - i ?
+                                 (o_size - n) * 2 : len - i);
+            i += run;
+            n += run / 2;
+            simd_from = i + 32;
+
+            if (i == len)
+                break;
+        }
+
+        v = HEX_VAL[(uint8_t)s[i]];
+        if (v) {
+            if (!odd) {
+                hi = (v - 1) << 4;
+            } else {
+                if (n < o_size)
+                    o[n] = hi | (v - 1);
+                else if (!err)
+                    err = HEX_DECODE_SIZE;
+                n++;
+            }
+            odd = !odd;
+
+        } else if (is_hex_delim(s[i])) {
+            if (odd)
+                err = HEX_DECODE_ALIGN;
+
+        } else {
+            return HEX_DECODE_INVALID;
+        }
+
+        i++;
+    }
+
+    if (n == 0 && !odd)
+        return HEX_DECODE_INVALID;
+
+    if (odd)
+        err = HEX_DECODE_ALIGN;
+
+    *o_len = n;
+
+    return err;
+}
+
+// Print the error of hex_decode() in the way the parsers always did
+void hex_decode_err_print(const char *s, int err) {
+    if (err == HEX_DECODE_INVALID) {
+        po("ERROR: Could not parse >%s< as a hex string\n", s);
+    } else if (err == HEX_DECODE_ALIGN) {
+        po("ERROR: hex strings must be byte aligned, and if delimiters are then they must also be byte aligned.\n");
+    }
+}
@@ -1,15 +1,20 @@
 #include <stdio.h>
 #include "ef.h"
 
-// Borrow IPv6 pseudo header from ef-udp.c
-// It is already initialized in ef-udp.c
-extern hdr_t HDR_IPV6_PSEUDO;
+enum {
+    ICMP_FIELD_TYPE,
+    ICMP_FIELD_CODE,
+    ICMP_FIELD_CHKSUM,
+    ICMP_FIELD_HD,
+
+    ICMP_FIELD_LAST
+};
 
 static int icmp_fill_defaults(struct frame *f, int stack_idx) {
     int i, icmp_len = 0;
     char buf[16];
     hdr_t *h = f->stack[stack_idx];
-    field_t *chksum = find_field(h, "chksum");
+    field_t *chksum = &h->fields[ICMP_FIELD_CHKSUM];
 
     for (i = stack_idx; i < f->stack_size; ++i) {
         icmp_len += f->stack[i]->size;
@@ -28,18 +33,23 @@ static int icmp_fill_defaults(struct frame *f, int stack_idx) {
                 pseudo_hdr = hdr_clone(&HDR_IPV6_PSEUDO);
                 pseudo_hdr_size = pseudo_hdr->size;
 
-                // Clone selected parts of ip header into pseudo header
-                find_field(pseudo_hdr, "sip")->val = bclone(find_field(ll, "sip")->val);
-                find_field(pseudo_hdr, "dip")->val = bclone(find_field(ll, "dip")->val);
+                // Borrow the IPv6 pseudo header from ef-udp.c, and clone
+                // selected parts of ip header into it
+                pseudo_hdr->fields[IPV6_PSEUDO_FIELD_SIP].val =
+                        bclone(find_field(ll, "sip")->val);
+                pseudo_hdr->fields[IPV6_PSEUDO_FIELD_DIP].val =
+                        bclone(find_field(ll, "dip")->val);
 
                 // Set proto to ICMPv6 in pseudo header and update our own type
-                find_field(pseudo_hdr, "proto")->val = parse_bytes("58", 1);
+                field_val_parse(&pseudo_hdr->fields[IPV6_PSEUDO_FIELD_PROTO],
+                                "58", 1);
                 h->type = 58;
 
                 // Set len in pseudo header
                 snprintf(buf, 16, "%d", icmp_len);
                 buf[15] = 0;
-                find_field(pseudo_hdr, "len")->val = parse_bytes(buf, 4);
+                field_val_parse(&pseudo_hdr->fields[IPV6_PSEUDO_FIELD_LEN],
+                                buf, 4);
             }
         }
 
@@ -57,7 +67,7 @@ static int icmp_fill_defaults(struct frame *f, int stack_idx) {
         sum = inet_chksum(0, (uint16_t *)b->data, b->size);
         snprintf(buf, 16, "%d", sum);
         buf[15] = 0;
-        chksum->val = parse_bytes(buf, 2);
+        field_val_parse(chksum, buf, 2);
 
         bfree(b);
         if (pseudo_hdr)
@@ -67,15 +77,19 @@ static int icmp_fill_defaults(struct frame *f, int stack_idx) {
 }
 
 static field_t ICMP_FIELDS[] = {
+    [ICMP_FIELD_TYPE] =
     { .name = "type",
       .help = "ICMP type",
       .bit_width =   8 },
+    [ICMP_FIELD_CODE] =
     { .name = "code",
       .help = "ICMP subtype",
       .bit_width =   8 },
+    [ICMP_FIELD_CHKSUM] =
     { .name = "chksum",
       .help = "Checksum",
       .bit_width =  16 },
+    [ICMP_FIELD_HD] =
     { .name = "hd",
       .help = "Four-byte Header Data. Contents vary based on the ICMP type and code",
       .bit_width =  32 },
@@ -1,21 +1,39 @@
 #include <stdio.h>
 #include "ef.h"
 
+enum {
+    IGMP_FIELD_TYPE,
+    IGMP_FIELD_MAX_RESP,
+    IGMP_FIELD_CHKSUM,
+    IGMP_FIELD_GA,
+    IGMP_FIELD_QRESV,
+    IGMP_FIELD_S,
+    IGMP_FIELD_QRV,
+    IGMP_FIELD_QQIC,
+    IGMP_FIELD_NS,
+    IGMP_FIELD_RRESV,
+    IGMP_FIELD_NG,
+
+    IGMP_FIELD_LAST
+};
+
 static int igmp_fill_defaults(struct frame *f, int stack_idx) {
     size_t     i2;
     int        i, found = 0, offset = 0, sum = 0, igmp_len = 0;
     char       buf[16];
     hdr_t      *h = f->stack[stack_idx];
-    field_t    *chksum = find_field(h, "chksum"), *fld;
+    field_t    *chksum = &h->fields[IGMP_FIELD_CHKSUM], *fld;
     buf_t      *b;
-    const char *v3_query_fields[]  = {"qresv", "s", "qrv", "qqic", "ns"};
-    const char *v3_report_fields[] = {"rresv", "ng"};
+    const int   v3_query_fields[]  = {IGMP_FIELD_QRESV, IGMP_FIELD_S,
+                                      IGMP_FIELD_QRV, IGMP_FIELD_QQIC,
+                                      IGMP_FIELD_NS};
+    const int   v3_report_fields[] = {IGMP_FIELD_RRESV, IGMP_FIELD_NG};
 
     // If none of the fields "qresv", "s", qrv" "qqic", or "ns" are present,
     // we adjust the size to 4 bytes less. Otherwise the receiver will always
     // interpret this as an IGMPv3 query.
     for (i2 = 0; i2 < sizeof(v3_query_fields) / sizeof(v3_query_fields[0]); i2++) {
-        fld = find_field(h, v3_query_fields[i2]);
+        fld = &h->fields[v3_query_fields[i2]];
         if (fld->val || fld->def) {
             found = 1;
             break;
@@ -27,7 +45,7 @@ static int igmp_fill_defaults(struct frame *f, int stack_idx) {
 
         // Also adjust the bit-widths to 0 in order to support IGMPv3 reports.
         for (i2 = 0; i2 < sizeof(v3_query_fields) / sizeof(v3_query_fields[0]); i2++) {
-            fld = find_field(h, v3_query_fields[i2]);
+            fld = &h->fields[v3_query_fields[i2]];
             fld->bit_width = 0;
         }
 
@@ -39,7 +57,7 @@ static int igmp_fill_defaults(struct frame *f, int stack_idx) {
     // report.
     found = 0;
     for (i2 = 0; i2 < sizeof(v3_report_fields) / sizeof(v3_report_fields[0]); i2++) {
-        fld = find_field(h, v3_report_fields[i2]);
+        fld = &h->fields[v3_report_fields[i2]];
         if (fld->val || fld->def) {
             found = 1;
             break;
@@ -51,7 +69,7 @@ static int igmp_fill_defaults(struct frame *f, int stack_idx) {
 
         // Also adjust the bit-widths to 0 in order to support IGMPv3 Queries.
         for (i2 = 0; i2 < sizeof(v3_report_fields) / sizeof(v3_report_fields[0]); i2++) {
-            fld = find_field(h, v3_report_fields[i2]);
+            fld = &h->fields[v3_report_fields[i2]];
             fld->bit_width = 0;
         }
 
@@ -60,13 +78,13 @@ static int igmp_fill_defaults(struct frame *f, int stack_idx) {
         // At least one of the IGMPv3 report fields are present, so remove the
         // Group Address, which is then only used in queries.
         h->size -= 4;
-        fld = find_field(h, "ga");
+        fld = &h->fields[IGMP_FIELD_GA];
         fld->bit_width = 0;
 
         // And move the "rresv" and "ng" bit-offsets to where they belong
-        fld = find_field(h, "rresv");
+        fld = &h->fields[IGMP_FIELD_RRESV];
         fld->bit_offset = 32;
-        fld = find_field(h, "ng");
+        fld = &h->fields[IGMP_FIELD_NG];
         fld->bit_offset = 48;
 
         // po("Adjusted IGMPv1/IGMPv2 \"ga\" field's bit-width to 0, because it's not used in IGMPv3 reports\n");
@@ -94,7 +112,7 @@ static int igmp_fill_defaults(struct frame *f, int stack_idx) {
     // And write it to the checksum field.
     snprintf(buf, 16, "0x%x", sum);
     buf[15] = 0;
-    chksum->val = parse_bytes(buf, 2);
+    field_val_parse(chksum, buf, 2);
     bfree(b);
 
     return 0;
@@ -110,36 +128,47 @@ static int igmp_fill_defaults(struct frame *f, int stack_idx) {
 // To issue an IGMPv3 report, use either of the fields "rresv" or "ng" followed
 // by one or more igmpv3_group records.
 static field_t IGMP_FIELDS[] = {
+    [IGMP_FIELD_TYPE] =
     { .name = "type",
       .help = "IGMP type",
       .bit_width = 8},
+    [IGMP_FIELD_MAX_RESP] =
     { .name = "max_resp",
       .help = "Max Resp Time (IGMPv2) or Max Resp Code (IGMPv3), Queries only)",
       .bit_width = 8},
+    [IGMP_FIELD_CHKSUM] =
     { .name = "chksum",
       .help = "Checksum",
       .bit_width = 16},
+    [IGMP_FIELD_GA] =
     { .name = "ga",
       .help = "Group Address (not to be used in IGMPv3 reports)",
       .bit_width = 32},
+    [IGMP_FIELD_QRESV] =
     { .name = "qresv",
       .help = "Reserved (IGMPv3, Query, only)",
       .bit_width = 4},
+    [IGMP_FIELD_S] =
     { .name = "s",
       .help = "Suppress Router-Side Processing (IGMPv3, Query, only)",
       .bit_width = 1},
+    [IGMP_FIELD_QRV] =
     { .name = "qrv",
       .help = "Querier's Robustness Variable (IGMPv3, Query, only)",
       .bit_width = 3},
+    [IGMP_FIELD_QQIC] =
     { .name = "qqic",
       .help = "Querier's Query Interval Code (IGMPv3, Query, only)",
       .bit_width = 8},
+    [IGMP_FIELD_NS] =
     { .name = "ns",
       .help = "Number of Sources (IGMPv3, Query, only)",
       .bit_width = 16},
+    [IGMP_FIELD_RRESV] =
     { .name = "rresv",
       .help = "Reserved (IGMPv3, Report, only)",
       .bit_width = 16},
+    [IGMP_FIELD_NG] =
     { .name = "ng",
       .help = "Number of Group Records (IGMPv3, Report, only)",
       .bit_width = 16},
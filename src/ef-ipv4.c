@@ -1,12 +1,30 @@
 #include <stdio.h>
 #include "ef.h"
 
+enum {
+    IPV4_FIELD_VER,
+    IPV4_FIELD_IHL,
+    IPV4_FIELD_DSCP,
+    IPV4_FIELD_ECN,
+    IPV4_FIELD_LEN,
+    IPV4_FIELD_ID,
+    IPV4_FIELD_FLAGS,
+    IPV4_FIELD_OFFSET,
+    IPV4_FIELD_TTL,
+    IPV4_FIELD_PROTO,
+    IPV4_FIELD_CHKSUM,
+    IPV4_FIELD_SIP,
+    IPV4_FIELD_DIP,
+
+    IPV4_FIELD_LAST
+};
+
 static int ipv4_fill_defaults(struct frame *f, int stack_idx) {
     char buf[16];
     hdr_t *h = f->stack[stack_idx];
-    field_t *chksum = find_field(h, "chksum");
-    field_t *proto = find_field(h, "proto");
-    field_t *len = find_field(h, "len");
+    field_t *chksum = &h->fields[IPV4_FIELD_CHKSUM];
+    field_t *proto = &h->fields[IPV4_FIELD_PROTO];
+    field_t *len = &h->fields[IPV4_FIELD_LEN];
 
     if (!proto->val) {
         if (stack_idx + 1 < f->stack_size) {
@@ -16,7 +34,7 @@ static int ipv4_fill_defaults(struct frame *f, int stack_idx) {
             snprintf(buf, 16, "17");
         }
         buf[15] = 0;
-        proto->val = parse_bytes(buf, 1);
+        field_val_parse(proto, buf, 1);
     }
 
     if (!len->val) {
@@ -29,7 +47,7 @@ static int ipv4_fill_defaults(struct frame *f, int stack_idx) {
         //po("IP len: %d\n", ip_len);
         snprintf(buf, 16, "%d", ip_len);
         buf[15] = 0;
-        len->val = parse_bytes(buf, 2);
+        field_val_parse(len, buf, 2);
     }
 
     if (!chksum->val) {
@@ -41,7 +59,7 @@ static int ipv4_fill_defaults(struct frame *f, int stack_idx) {
 
         snprintf(buf, 16, "%d", sum);
         buf[15] = 0;
-        chksum->val = parse_bytes(buf, 2);
+        field_val_parse(chksum, buf, 2);
 
         bfree(b);
     }
@@ -50,42 +68,55 @@ static int ipv4_fill_defaults(struct frame *f, int stack_idx) {
 }
 
 static field_t IPV4_FIELDS[] = {
+    [IPV4_FIELD_VER] =
     { .name = "ver",
       .help = "Four-bit version field, e.g. 4 for IPv4",
       .bit_width =  4  },
+    [IPV4_FIELD_IHL] =
     { .name = "ihl",
       .help = "Internet Header Length, e.g. 5 for header without any options",
       .bit_width =  4  },
+    [IPV4_FIELD_DSCP] =
     { .name = "dscp",
       .help = "Differentiated Services Code Point",
       .bit_width =  6  },
+    [IPV4_FIELD_ECN] =
     { .name = "ecn",
       .help = "Explicit Congestion Notification",
       .bit_width =  2  },
+    [IPV4_FIELD_LEN] =
     { .name = "len",
       .help = "Total Length of the entire packet",
       .bit_width =  16 },
+    [IPV4_FIELD_ID] =
     { .name = "id",
       .help = "Identification",
       .bit_width =  16 },
+    [IPV4_FIELD_FLAGS] =
     { .name = "flags",
       .help = "Flags used for fragmentation",
       .bit_width =  3  },
+    [IPV4_FIELD_OFFSET] =
     { .name = "offset",
       .help = "Fragment offset",
       .bit_width =  13 },
+    [IPV4_FIELD_TTL] =
     { .name = "ttl",
       .help = "Time To Live",
       .bit_width =  8  },
+    [IPV4_FIELD_PROTO] =
     { .name = "proto",
       .help = "Protocol, e.g. 6 for TCP and 17 for UDP",
       .bit_width =  8  },
+    [IPV4_FIELD_CHKSUM] =
     { .name = "chksum",
       .help = "Header Checksum",
       .bit_width =  16 },
+    [IPV4_FIELD_SIP] =
     { .name = "sip",
       .help = "Source IP Address, e.g. 10.10.10.1",
       .bit_width =  32 },
+    [IPV4_FIELD_DIP] =
     { .name = "dip",
       .help = "Destination IP Address, e.g. 10.10.10.2",
       .bit_width =  32 },
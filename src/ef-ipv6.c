@@ -1,11 +1,25 @@
 #include <stdio.h>
 #include "ef.h"
 
+enum {
+    IPV6_FIELD_VER,
+    IPV6_FIELD_DSCP,
+    IPV6_FIELD_ECN,
+    IPV6_FIELD_FLOW,
+    IPV6_FIELD_LEN,
+    IPV6_FIELD_NEXT,
+    IPV6_FIELD_HLIM,
+    IPV6_FIELD_SIP,
+    IPV6_FIELD_DIP,
+
+    IPV6_FIELD_LAST
+};
+
 static int ipv6_fill_defaults(struct frame *f, int stack_idx) {
     char buf[16];
     hdr_t *h = f->stack[stack_idx];
-    field_t *next = find_field(h, "next");
-    field_t *len = find_field(h, "len");
+    field_t *next = &h->fields[IPV6_FIELD_NEXT];
+    field_t *len = &h->fields[IPV6_FIELD_LEN];
 
     if (!next->val) {
         if (stack_idx + 1 < f->stack_size) {
@@ -15,7 +29,7 @@ static int ipv6_fill_defaults(struct frame *f, int stack_idx) {
             snprintf(buf, 16, "17");
         }
         buf[15] = 0;
-        next->val = parse_bytes(buf, 1);
+        field_val_parse(next, buf, 1);
     }
 
     if (!len->val) {
@@ -28,37 +42,46 @@ static int ipv6_fill_defaults(struct frame *f, int stack_idx) {
         //po("IP len: %d\n", ip_len);
         snprintf(buf, 16, "%d", ip_len);
         buf[15] = 0;
-        len->val = parse_bytes(buf, 2);
+        field_val_parse(len, buf, 2);
     }
 
     return 0;
 }
 
 static field_t IPV6_FIELDS[] = {
+    [IPV6_FIELD_VER] =
     { .name = "ver",
       .help = "Four-bit version field, e.g. 6 for IPv6",
       .bit_width =  4  },
+    [IPV6_FIELD_DSCP] =
     { .name = "dscp",
       .help = "Differentiated Services Code Point",
       .bit_width =  6  },
+    [IPV6_FIELD_ECN] =
     { .name = "ecn",
       .help = "Explicit Congestion Notification",
       .bit_width =  2  },
+    [IPV6_FIELD_FLOW] =
     { .name = "flow",
       .help = "Flow label",
       .bit_width =  20 },
+    [IPV6_FIELD_LEN] =
     { .name = "len",
       .help = "Payload Length of Extension Headers and Upper Layer data",
       .bit_width =  16 },
+    [IPV6_FIELD_NEXT] =
     { .name = "next",
       .help = "Next Header, i.e. type of header that follows the IPv6 header",
       .bit_width =  8  },
+    [IPV6_FIELD_HLIM] =
     { .name = "hlim",
       .help = "Hop Limit - same as TTL in IPv4",
       .bit_width =  8  },
+    [IPV6_FIELD_SIP] =
     { .name = "sip",
       .help = "Source IP Address, e.g. 2001:db8::1",
       .bit_width = 128 },
+    [IPV6_FIELD_DIP] =
     { .name = "dip",
       .help = "Destination IP Address, e.g. 2001:db8::2",
       .bit_width = 128 },
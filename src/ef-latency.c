@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include "ef.h"
+
+// Latency signature, embedded in the last LAT_SIG_SIZE bytes of the payload
+// of each frame sent with 'tx ... latency'. All fields are big endian.
+//
+//    0: magic "EFL1"
+//    4: stream id
+//    8: sequence number
+//   16: TX time in ns (CLOCK_REALTIME)
+//   24: reserved, zero
+//   26: complement, which makes the 16 bit one's complement sum of the
+//       signature equal to the sum of the payload bytes it replaced. The
+//       checksums of the frame (UDP, TCP, ICMP...) are hereby still valid.
+#define LAT_MAGIC 0x45464c31
+
+#define NSEC_PER_SEC 1000000000ULL
+
+// The RX side decodes the signature from the end of the frame. A DUT which
+// removes a VLAN tag from a minimum size frame pads it again, so small frames
+// are searched.
+#define LAT_SEARCH_SIZE 64
+
+static void put_be32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void put_be64(uint8_t *p, uint64_t v) {
+    put_be32(p, v >> 32);
+    put_be32(p + 4, v);
+}
+
+static uint32_t get_be32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static uint64_t get_be64(const uint8_t *p) {
+    return (uint64_t)get_be32(p) << 32 | get_be32(p + 4);
+}
+
+// 16 bit one's complement sum, not inverted
+static uint16_t sum16(const uint8_t *p, int len) {
+    uint32_t sum = 0;
+    int i;
+
+    for (i = 0; i + 1 < len; i += 2)
+        sum += p[i] << 8 | p[i + 1];
+
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return sum;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Histogram in the style of HdrHistogram: values below LAT_SUB_CNT are
+// counted exactly, larger values in buckets with LAT_SUB_BITS - 1 bits of
+// precision, i.e. with an error below 1.6%.
+
+static int hist_idx(uint64_t v) {
+    int shift;
+
+    if (v < LAT_SUB_CNT)
+        return v;
+
+    if (v >> LAT_MAX_BITS)
+        v = (1ULL << LAT_MAX_BITS) - 1;
+
+    shift = 63 - __builtin_clzll(v) - (LAT_SUB_BITS - 1);
+
+    return LAT_SUB_CNT + (shift - 1) * LAT_HALF + (v >> shift) - LAT_HALF;
+}
+
+// The middle of the values counted in a bucket
+static uint64_t hist_val(int idx) {
+    int shift;
+
+    if (idx < LAT_SUB_CNT)
+        return idx;
+
+    idx -= LAT_SUB_CNT;
+    shift = idx / LAT_HALF + 1;
+
+    return ((uint64_t)(idx % LAT_HALF + LAT_HALF) << shift) +
+           (1ULL << (shift - 1));
+}
+
+void lat_hist_add(lat_hist_t *h, uint64_t v) {
+    if (!h->cnt || v < h->min)
+        h->min = v;
+
+    if (v > h->max)
+        h->max = v;
+
+    h->cnt++;
+    h->sum += v;
+    h->buckets[hist_idx(v)]++;
+}
+
+// The value at or below which #p percent of the values are
+uint64_t lat_hist_percentile(const lat_hist_t *h, double p) {
+    uint64_t n, seen = 0;
+    int i;
+
+    if (!h->cnt)
+        return 0;
+
+    n = (uint64_t)(p / 100.0 * h->cnt + 0.5);
+    if (n < 1)
+        n = 1;
+
+    for (i = 0; i < LAT_BUCKETS; ++i) {
+        seen += h->buckets[i];
+        if (seen < n)
+            continue;
+
+        // The bucket may be wider than the values counted in it
+        if (hist_val(i) > h->max)
+            return h->max;
+        if (hist_val(i) < h->min)
+            return h->min;
+
+        return hist_val(i);
+    }
+
+    return h->max;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TX side
+
+// Parses 'latency [<stream-id>]'. Returns the number of arguments consumed,
+// or -1.
+int argc_latency(int argc, const char *argv[], lat_tx_t **lat) {
+    lat_tx_t *t;
+    char *end;
+    int i = 1;
+
+    t = calloc(1, sizeof(*t));
+    if (!t)
+        return -1;
+
+    t->stream_auto = 1;
+    if (argc > 1 && isdigit((unsigned char)argv[1][0])) {
+        t->stream = strtoul(argv[1], &end, 0);
+        if (*end) {
+            po("ERROR: Invalid latency stream id: %s\n", argv[1]);
+            free(t);
+            return -1;
+        }
+        t->stream_auto = 0;
+        i++;
+    }
+
+    t->offset = -1;
+    *lat = t;
+
+    return i;
+}
+
+// Place the signature at the end of the payload ('data') of the frame, which
+// must not be followed by headers or padding.
+int lat_tx_prepare(lat_tx_t *t, const frame_t *f, const buf_t *b) {
+    int i, size = 0, payload = 0;
+
+    for (i = 0; i < f->stack_size; ++i) {
+        if (strcmp(f->stack[i]->name, "data") == 0) {
+            payload += f->stack[i]->size;
+        } else {
+            payload = 0;
+        }
+
+        size += f->stack[i]->size;
+    }
+
+    if (payload < LAT_SIG_SIZE || size != (int)b->size) {
+        po("ERROR: latency needs a frame of at least 60 bytes, ending with "
+           "%d bytes of data, e.g. 'data pattern cnt %d'\n", LAT_SIG_SIZE,
+           LAT_SIG_SIZE);
+        return -1;
+    }
+
+    t->offset = b->size - LAT_SIG_SIZE;
+    t->sum = sum16(b->data + t->offset, LAT_SIG_SIZE);
+
+    return 0;
+}
+
+// Give the commands without a stream id the index of the command. Streams
+// sharing an id would share the sequence numbers, so the frames of one would
+// be the duplicates of the other. Returns the number of errors.
+int lat_tx_streams(int cnt, cmd_t *cmds) {
+    int i, j, err = 0;
+
+    for (i = 0; i < cnt; i++) {
+        if (cmds[i].lat && cmds[i].lat->stream_auto)
+            cmds[i].lat->stream = cmds[i].idx;
+    }
+
+    for (i = 0; i < cnt; i++) {
+        if (!cmds[i].lat)
+            continue;
+
+        for (j = 0; j < i; j++) {
+            if (cmds[j].lat && cmds[j].lat->stream == cmds[i].lat->stream) {
+                po("ERROR: Latency stream %u is used by more than one 'tx', "
+                   "give each a stream id\n", cmds[i].lat->stream);
+                err++;
+                break;
+            }
+        }
+    }
+
+    return err;
+}
+
+// Write the signature of the next frame into #b
+void lat_tx_stamp(lat_tx_t *t, buf_t *b) {
+    uint8_t *p = b->data + t->offset;
+    struct timespec ts;
+    uint16_t sum;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    put_be32(p, LAT_MAGIC);
+    put_be32(p + 4, t->stream);
+    put_be64(p + 8, t->seq++);
+    put_be64(p + 16, ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec);
+    p[24] = p[25] = p[26] = p[27] = 0;
+
+    // one's complement: sum(sig) + comp == t->sum
+    sum = sum16(p, LAT_SIG_SIZE);
+    sum = ~sum;
+    sum = sum16((uint8_t[]){ sum >> 8, sum, t->sum >> 8, t->sum }, 4);
+    p[26] = sum >> 8;
+    p[27] = sum;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RX side
+
+lat_rx_t *lat_rx_new() {
+    return calloc(1, sizeof(lat_rx_t));
+}
+
+void lat_rx_free(lat_rx_t *r) {
+    int i;
+
+    if (!r)
+        return;
+
+    for (i = 0; i < r->cnt; ++i)
+        free(r->streams[i]);
+
+    free(r);
+}
+
+static lat_stream_t *lat_stream_get(lat_rx_t *r, uint32_t id) {
+    lat_stream_t *s;
+    int i;
+
+    for (i = 0; i < r->cnt; ++i) {
+        if (r->streams[i]->id == id)
+            return r->streams[i];
+    }
+
+    if (r->cnt >= LAT_STREAMS_MAX)
+        return 0;
+
+    s = calloc(1, sizeof(*s));
+    if (!s)
+        return 0;
+
+    s->id = id;
+    seq_win_start(&s->seq, 0);
+    r->streams[r->cnt++] = s;
+
+    return s;
+}
+
+static const uint8_t *lat_sig_find(const buf_t *b) {
+    int o = b->size - LAT_SIG_SIZE;
+
+    if (o < 0)
+        return 0;
+
+    if (get_be32(b->data + o) == LAT_MAGIC)
+        return b->data + o;
+
+    if (b->size > LAT_SEARCH_SIZE)
+        return 0;
+
+    for (o = o - 1; o >= 0; o--) {
+        if (get_be32(b->data + o) == LAT_MAGIC)
+            return b->data + o;
+    }
+
+    return 0;
+}
+
+// Account a received frame, if it has a signature. #ts must be in the domain
+// of CLOCK_REALTIME, like the TX time in the signature, hence not a hardware
+// timestamp (see rx_frame_recv_ts()). Returns 1 if it had.
+int lat_rx_frame(lat_rx_t *r, const buf_t *b, const struct timespec *ts) {
+    const uint8_t *p = lat_sig_find(b);
+    lat_stream_t *s;
+    int64_t transit, d;
+
+    if (!p)
+        return 0;
+
+    s = lat_stream_get(r, get_be32(p + 4));
+    if (!s)
+        return 1;
+
+    transit = (int64_t)(ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec) -
+              (int64_t)get_be64(p + 16);
+
+    // The TX and RX clocks are the same, unless the clock was stepped
+    if (transit < 0) {
+        s->negative++;
+        transit = 0;
+    }
+
+    lat_hist_add(&s->lat, transit);
+
+    // Jitter as in RFC 3550, and the IP packet delay variation (RFC 3393)
+    if (s->lat.cnt > 1) {
+        d = transit - s->last_transit;
+        if (d < 0)
+            d = -d;
+
+        s->jitter += (d - s->jitter) / 16;
+        lat_hist_add(&s->ipdv, d);
+    }
+
+    s->last_transit = transit;
+    s->last_seq = get_be64(p + 8);
+    seq_win_add(&s->seq, s->last_seq);
+
+    return 1;
+}
+
+// Tell how many frames a stream sent in this run, to find the frames lost
+// after the last one received
+void lat_rx_sent(lat_rx_t *r, const lat_tx_t *t) {
+    int i;
+
+    for (i = 0; i < r->cnt; ++i) {
+        if (r->streams[i]->id == t->stream && t->seq > r->streams[i]->seq_end)
+            r->streams[i]->seq_end = t->seq;
+    }
+}
+
+#define US(ns) ((ns) / 1000.0)
+
+// Print the latency and the sequence counters of each stream. Returns the
+// number of errors.
+int lat_rx_report(lat_rx_t *r, const char *ifname) {
+    lat_stream_t *s;
+    char what[32];
+    int i, err = 0;
+
+    if (!r->cnt) {
+        pe("LATENCY %15s: no frames with a latency signature\n", ifname);
+        return 1;
+    }
+
+    for (i = 0; i < r->cnt; ++i) {
+        s = r->streams[i];
+        po("LATENCY %15s: stream %u: %" PRIu64 " frames, min/avg/max "
+           "%.3f/%.3f/%.3f us\n", ifname, s->id, s->lat.cnt, US(s->lat.min),
+           US(s->lat.sum / s->lat.cnt), US(s->lat.max));
+        po("LATENCY %15s: stream %u: p50 %.3f p90 %.3f p99 %.3f p99.9 %.3f "
+           "p99.99 %.3f us\n", ifname, s->id,
+           US(lat_hist_percentile(&s->lat, 50)),
+           US(lat_hist_percentile(&s->lat, 90)),
+           US(lat_hist_percentile(&s->lat, 99)),
+           US(lat_hist_percentile(&s->lat, 99.9)),
+           US(lat_hist_percentile(&s->lat, 99.99)));
+        po("LATENCY %15s: stream %u: jitter %.3f us, ipdv p50 %.3f p99 %.3f "
+           "max %.3f us\n", ifname, s->id, US(s->jitter),
+           US(lat_hist_percentile(&s->ipdv, 50)),
+           US(lat_hist_percentile(&s->ipdv, 99)), US(s->ipdv.max));
+
+        if (s->negative)
+            pe("LATENCY %15s: stream %u: %" PRIu64 " frames received before "
+               "they were sent, the system clock was stepped\n", ifname, s->id,
+               s->negative);
+
+        snprintf(what, sizeof(what), "stream %u", s->id);
+        seq_win_end(&s->seq, s->seq_end);
+        err += seq_win_report(&s->seq, ifname, what);
+    }
+
+    return err;
+}
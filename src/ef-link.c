@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <inttypes.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include "ef.h"
+
+// Kernel link statistics of the interfaces used by a test, read with
+// RTM_GETSTATS (IFLA_STATS_LINK_64) before and after the run.
+
+static const char *LINK_CNT_NAMES[LINK_CNT_CNT] = {
+    [LINK_RX_FRAMES]  = "rx-frames",
+    [LINK_TX_FRAMES]  = "tx-frames",
+    [LINK_RX_BYTES]   = "rx-bytes",
+    [LINK_TX_BYTES]   = "tx-bytes",
+    [LINK_RX_DROPPED] = "rx-dropped",
+    [LINK_TX_DROPPED] = "tx-dropped",
+    [LINK_RX_ERRORS]  = "rx-errors",
+    [LINK_TX_ERRORS]  = "tx-errors",
+};
+
+static const char *LINK_OP_NAMES[] = {
+    [LINK_OP_EQ] = "==",
+    [LINK_OP_NE] = "!=",
+    [LINK_OP_GE] = ">=",
+    [LINK_OP_LE] = "<=",
+    [LINK_OP_GT] = ">",
+    [LINK_OP_LT] = "<",
+};
+
+#define LINK_OP_CNT (sizeof(LINK_OP_NAMES) / sizeof(LINK_OP_NAMES[0]))
+
+// The same operators, spelled such that a shell does not see a redirection
+static const char *LINK_OP_WORDS[LINK_OP_CNT] = {
+    [LINK_OP_EQ] = "eq",
+    [LINK_OP_NE] = "ne",
+    [LINK_OP_GE] = "ge",
+    [LINK_OP_LE] = "le",
+    [LINK_OP_GT] = "gt",
+    [LINK_OP_LT] = "lt",
+};
+
+int link_cnt_parse(const char *name) {
+    int i;
+
+    for (i = 0; i < LINK_CNT_CNT; ++i) {
+        if (strcmp(LINK_CNT_NAMES[i], name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+int link_socket() {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+    if (fd < 0)
+        po("%s:%d netlink socket error: %m\n", __FILE__, __LINE__);
+
+    return fd;
+}
+
+int link_stats_get(int fd, const char *ifname, link_stats_t *s) {
+    static uint32_t seq;
+    struct {
+        struct nlmsghdr     nlh;
+        struct if_stats_msg ifsm;
+    } req = {};
+    union {
+        struct nlmsghdr nlh;
+        uint8_t         buf[4096];
+    } rsp;
+    struct rtnl_link_stats64 st;
+    struct nlmsghdr *nlh;
+    struct nlmsgerr *nle;
+    struct rtattr *rta;
+    int res, len, found = 0;
+
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifsm));
+    req.nlh.nlmsg_type = RTM_GETSTATS;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST;
+    req.nlh.nlmsg_seq = ++seq;
+    req.ifsm.family = AF_UNSPEC;
+    req.ifsm.ifindex = if_nametoindex(ifname);
+    req.ifsm.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+
+    if (!req.ifsm.ifindex) {
+        pe("ERROR: No such interface: %s\n", ifname);
+        return -1;
+    }
+
+    res = send(fd, &req, req.nlh.nlmsg_len, 0);
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+    if (res < 0) {
+        po("%s:%d netlink send error: %m\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    res = recv(fd, rsp.buf, sizeof(rsp.buf), 0);
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+    if (res < 0) {
+        po("%s:%d netlink recv error: %m\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    for (nlh = &rsp.nlh; NLMSG_OK(nlh, res); nlh = NLMSG_NEXT(nlh, res)) {
+        if (nlh->nlmsg_seq != seq)
+            continue;
+
+        if (nlh->nlmsg_type == NLMSG_ERROR) {
+            nle = NLMSG_DATA(nlh);
+            errno = -nle->error;
+            pe("ERROR: RTM_GETSTATS %s: %m\n", ifname);
+            return -1;
+        }
+
+        if (nlh->nlmsg_type != RTM_NEWSTATS)
+            continue;
+
+        len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(struct if_stats_msg));
+        rta = (struct rtattr *)((uint8_t *)NLMSG_DATA(nlh) +
+                                NLMSG_ALIGN(sizeof(struct if_stats_msg)));
+        for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+            if (rta->rta_type != IFLA_STATS_LINK_64)
+                continue;
+
+            // Older kernels may send a shorter struct
+            memset(&st, 0, sizeof(st));
+            memcpy(&st, RTA_DATA(rta), RTA_PAYLOAD(rta) < sizeof(st) ?
+                   RTA_PAYLOAD(rta) : sizeof(st));
+            found = 1;
+        }
+    }
+
+    if (!found) {
+        pe("ERROR: No link statistics for %s\n", ifname);
+        return -1;
+    }
+
+    s->cnt[LINK_RX_FRAMES] = st.rx_packets;
+    s->cnt[LINK_TX_FRAMES] = st.tx_packets;
+    s->cnt[LINK_RX_BYTES] = st.rx_bytes;
+    s->cnt[LINK_TX_BYTES] = st.tx_bytes;
+    s->cnt[LINK_RX_DROPPED] = st.rx_dropped;
+    s->cnt[LINK_TX_DROPPED] = st.tx_dropped;
+    s->cnt[LINK_RX_ERRORS] = st.rx_errors;
+    s->cnt[LINK_TX_ERRORS] = st.tx_errors;
+
+    return 0;
+}
+
+// Parses '<op> <cnt>' of 'expect-<counter> <if> <op> <cnt>'. Returns the
+// number of arguments consumed, or -1.
+int argc_link_expect(int argc, const char *argv[], const char *counter,
+                     link_expect_t **expect) {
+    link_expect_t *e;
+    char *end;
+    int cnt, op;
+
+    cnt = link_cnt_parse(counter);
+    if (cnt < 0) {
+        po("ERROR: Unknown counter: %s\n", counter);
+        return -1;
+    }
+
+    if (argc < 2) {
+        po("ERROR: expect-%s <if> <op> <cnt>\n", counter);
+        return -1;
+    }
+
+    for (op = 0; op < (int)LINK_OP_CNT; ++op) {
+        if (strcmp(LINK_OP_NAMES[op], argv[0]) == 0 ||
+            strcmp(LINK_OP_WORDS[op], argv[0]) == 0)
+            break;
+    }
+
+    if (op == LINK_OP_CNT) {
+        po("ERROR: Invalid operator: %s\n", argv[0]);
+        return -1;
+    }
+
+    e = calloc(1, sizeof(*e));
+    if (!e)
+        return -1;
+
+    errno = 0;
+    e->val = strtoull(argv[1], &end, 0);
+    if (errno || end == argv[1] || *end || argv[1][0] == '-') {
+        po("ERROR: Invalid count: %s\n", argv[1]);
+        free(e);
+        return -1;
+    }
+
+    e->cnt = cnt;
+    e->op = op;
+    *expect = e;
+
+    return 2;
+}
+
+int link_expect_check(const link_expect_t *e, uint64_t val) {
+    switch (e->op) {
+        case LINK_OP_EQ: return val == e->val;
+        case LINK_OP_NE: return val != e->val;
+        case LINK_OP_GE: return val >= e->val;
+        case LINK_OP_LE: return val <= e->val;
+        case LINK_OP_GT: return val > e->val;
+        case LINK_OP_LT: return val < e->val;
+    }
+
+    return 0;
+}
+
+// The counters are read for runs which check them, or which send more
+// frames than are worth matching one by one ('rep', 'replay').
+static int link_snap_needed(int cnt, const cmd_t *cmds) {
+    int i;
+
+    for (i = 0; i < cnt; ++i) {
+        if (cmds[i].type == CMD_TYPE_EXPECT)
+            return 1;
+
+        if (cmds[i].type == CMD_TYPE_TX &&
+            (cmds[i].repeat > 1 || cmds[i].replay))
+            return 1;
+    }
+
+    return 0;
+}
+
+int link_snap_begin(int cnt, const cmd_t *cmds, link_snap_t *snaps,
+                    int snap_max) {
+    int i, j, fd, snap_cnt = 0;
+    const char *name;
+
+    if (!link_snap_needed(cnt, cmds))
+        return 0;
+
+    for (i = 0; i < cnt && snap_cnt < snap_max; ++i) {
+        if (cmds[i].type != CMD_TYPE_TX && cmds[i].type != CMD_TYPE_RX &&
+            cmds[i].type != CMD_TYPE_EXPECT)
+            continue;
+
+        name = cmds[i].arg0;
+        if (!name || strncmp(name, "file:", 5) == 0)
+            continue;
+
+        for (j = 0; j < snap_cnt; ++j) {
+            if (strcmp(snaps[j].ifname, name) == 0)
+                break;
+        }
+
+        if (j == snap_cnt) {
+            memset(&snaps[snap_cnt], 0, sizeof(snaps[snap_cnt]));
+            snaps[snap_cnt++].ifname = name;
+        }
+    }
+
+    fd = link_socket();
+    if (fd < 0)
+        return snap_cnt;
+
+    for (i = 0; i < snap_cnt; ++i)
+        snaps[i].valid = link_stats_get(fd, snaps[i].ifname,
+                                        &snaps[i].before) == 0;
+
+    close(fd);
+
+    return snap_cnt;
+}
+
+int link_snap_end(int cnt, const cmd_t *cmds, link_snap_t *snaps,
+                  int snap_cnt) {
+    int i, j, fd, err = 0;
+    link_stats_t after, *d;
+    const link_expect_t *e;
+
+    if (!snap_cnt)
+        return 0;
+
+    fd = link_socket();
+
+    for (i = 0; i < snap_cnt; ++i) {
+        if (!snaps[i].valid)
+            continue;
+
+        if (fd < 0 || link_stats_get(fd, snaps[i].ifname, &after) < 0) {
+            snaps[i].valid = 0;
+            continue;
+        }
+
+        d = &snaps[i].delta;
+        for (j = 0; j < LINK_CNT_CNT; ++j)
+            d->cnt[j] = after.cnt[j] - snaps[i].before.cnt[j];
+
+        po("LINK   %16s: rx %" PRIu64 " frames %" PRIu64 " bytes %" PRIu64
+           " dropped %" PRIu64 " errors, tx %" PRIu64 " frames %" PRIu64
+           " bytes %" PRIu64 " dropped %" PRIu64 " errors\n", snaps[i].ifname,
+           d->cnt[LINK_RX_FRAMES], d->cnt[LINK_RX_BYTES],
+           d->cnt[LINK_RX_DROPPED], d->cnt[LINK_RX_ERRORS],
+           d->cnt[LINK_TX_FRAMES], d->cnt[LINK_TX_BYTES],
+           d->cnt[LINK_TX_DROPPED], d->cnt[LINK_TX_ERRORS]);
+    }
+
+    if (fd >= 0)
+        close(fd);
+
+    for (i = 0; i < cnt; ++i) {
+        if (cmds[i].type != CMD_TYPE_EXPECT)
+            continue;
+
+        e = cmds[i].expect;
+        for (j = 0; j < snap_cnt; ++j) {
+            if (strcmp(snaps[j].ifname, cmds[i].arg0) == 0)
+                break;
+        }
+
+        if (j == snap_cnt || !snaps[j].valid) {
+            pe("EXPECT %16s: %s: no link statistics\n", cmds[i].arg0,
+               LINK_CNT_NAMES[e->cnt]);
+            err++;
+            continue;
+        }
+
+        if (link_expect_check(e, snaps[j].delta.cnt[e->cnt])) {
+            po("EXPECT %16s: %s %" PRIu64 " %s %" PRIu64 "\n", cmds[i].arg0,
+               LINK_CNT_NAMES[e->cnt], snaps[j].delta.cnt[e->cnt],
+               LINK_OP_NAMES[e->op], e->val);
+        } else {
+            pe("EXPECT-ERR %12s: %s %" PRIu64 " %s %" PRIu64 "\n",
+               cmds[i].arg0, LINK_CNT_NAMES[e->cnt],
+               snaps[j].delta.cnt[e->cnt], LINK_OP_NAMES[e->op], e->val);
+            err++;
+        }
+    }
+
+    return err;
+}
+
+int link_speed_get(const char *ifname) {
+    struct ethtool_cmd ec = { .cmd = ETHTOOL_GSET };
+    struct ifreq ifr = {};
+    uint32_t speed;
+    int fd, res;
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    ifr.ifr_data = (void *)&ec;
+    res = ioctl(fd, SIOCETHTOOL, &ifr);
+    TIMING_CNT(TIMING_CNT_SYSCALL, 3);
+    close(fd);
+
+    speed = ethtool_cmd_speed(&ec);
+    if (res < 0 || speed == 0 || speed == (uint32_t)SPEED_UNKNOWN)
+        return -1;
+
+    return speed;
+}
@@ -2,16 +2,36 @@
 #include <stdio.h>
 #include "ef.h"
 
+enum {
+    MLD_FIELD_TYPE,
+    MLD_FIELD_CODE,
+    MLD_FIELD_CHKSUM,
+    MLD_FIELD_MAX_RESP,
+    MLD_FIELD_RSV,
+    MLD_FIELD_GA,
+    MLD_FIELD_QRESV,
+    MLD_FIELD_S,
+    MLD_FIELD_QRV,
+    MLD_FIELD_QQIC,
+    MLD_FIELD_NS,
+    MLD_FIELD_RRESV,
+    MLD_FIELD_NG,
+
+    MLD_FIELD_LAST
+};
+
 static int mld_fill_defaults(struct frame *f, int stack_idx) {
     int        i, found = 0, offset = 0, sum, mld_len;
     size_t     i2;
     char       buf[16];
     hdr_t      *h = f->stack[stack_idx], *ip_hdr;
-    field_t    *chksum = find_field(h, "chksum"), *fld, *sip = NULL, *dip = NULL;
+    field_t    *chksum = &h->fields[MLD_FIELD_CHKSUM], *fld, *sip = NULL, *dip = NULL;
     uint8_t   *ptr;
     buf_t      *b;
-    const char *v2_query_fields[]  = {"qresv", "s", "qrv", "qqic", "ns"};
-    const char *v2_report_fields[] = {"rresv", "ng"};
+    const int   v2_query_fields[]  = {MLD_FIELD_QRESV, MLD_FIELD_S,
+                                      MLD_FIELD_QRV, MLD_FIELD_QQIC,
+                                      MLD_FIELD_NS};
+    const int   v2_report_fields[] = {MLD_FIELD_RRESV, MLD_FIELD_NG};
 
     struct {
         uint8_t     sip[16];
@@ -25,7 +45,7 @@ static int mld_fill_defaults(struct frame *f, int stack_idx) {
     // we adjust the size to 4 bytes less. Otherwise the receiver will always
     // interpret this as an MLDv2 query.
     for (i2 = 0; i2 < sizeof(v2_query_fields) / sizeof(v2_query_fields[0]); i2++) {
-        fld = find_field(h, v2_query_fields[i2]);
+        fld = &h->fields[v2_query_fields[i2]];
         if (fld->val || fld->def) {
             found = 1;
             break;
@@ -37,7 +57,7 @@ static int mld_fill_defaults(struct frame *f, int stack_idx) {
 
         // Also adjust the bit-widths to 0 in order to support MLDv2 reports.
         for (i2 = 0; i2 < sizeof(v2_query_fields) / sizeof(v2_query_fields[0]); i2++) {
-            fld = find_field(h, v2_query_fields[i2]);
+            fld = &h->fields[v2_query_fields[i2]];
             fld->bit_width = 0;
         }
 
@@ -49,7 +69,7 @@ static int mld_fill_defaults(struct frame *f, int stack_idx) {
     // report.
     found = 0;
     for (i2 = 0; i2 < sizeof(v2_report_fields) / sizeof(v2_report_fields[0]); i2++) {
-        fld = find_field(h, v2_report_fields[i2]);
+        fld = &h->fields[v2_report_fields[i2]];
         if (fld->val || fld->def) {
             found = 1;
             break;
@@ -61,7 +81,7 @@ static int mld_fill_defaults(struct frame *f, int stack_idx) {
 
         // Also adjust the bit-widths to 0 in order to support IGMPv3 Queries.
         for (i2 = 0; i2 < sizeof(v2_report_fields) / sizeof(v2_report_fields[0]); i2++) {
-            fld = find_field(h, v2_report_fields[i2]);
+            fld = &h->fields[v2_report_fields[i2]];
             fld->bit_width = 0;
         }
 
@@ -71,17 +91,17 @@ static int mld_fill_defaults(struct frame *f, int stack_idx) {
         // Group Address, Maximum Response Code, and Reserved, which are only
         // used in queries.
         h->size -= 20;
-        fld = find_field(h, "ga");
+        fld = &h->fields[MLD_FIELD_GA];
         fld->bit_width = 0;
-        fld = find_field(h, "max_resp");
+        fld = &h->fields[MLD_FIELD_MAX_RESP];
         fld->bit_width = 0;
-        fld = find_field(h, "rsv");
+        fld = &h->fields[MLD_FIELD_RSV];
         fld->bit_width = 0;
 
         // And move the "rresv" and "ng" bit-offsets to where they belong
-        fld = find_field(h, "rresv");
+        fld = &h->fields[MLD_FIELD_RRESV];
         fld->bit_offset = 32;
-        fld = find_field(h, "ng");
+        fld = &h->fields[MLD_FIELD_NG];
         fld->bit_offset = 48;
 
         // po("Adjusted MLDv1 \"ga\" field's bit-width to 0, because it's not used in MLDv2 reports\n");
@@ -174,7 +194,7 @@ static int mld_fill_defaults(struct frame *f, int stack_idx) {
     // And write it to the checksum field.
     snprintf(buf, 16, "0x%x", sum);
     buf[15] = 0;
-    chksum->val = parse_bytes(buf, 2);
+    field_val_parse(chksum, buf, 2);
     bfree(b);
 
     return 0;
@@ -188,42 +208,55 @@ static int mld_fill_defaults(struct frame *f, int stack_idx) {
 // To issue an MLDv3 report, use either of the fields "rresv" or "ng" followed
 // by one or more mldv2_group records.
 static field_t MLD_FIELDS[] = {
+    [MLD_FIELD_TYPE] =
     { .name = "type",
       .help = "MLD type",
       .bit_width = 8},
+    [MLD_FIELD_CODE] =
     { .name = "code",
       .help = "Code - initialized to zero by the sender, ignored by receivers",
       .bit_width = 8},
+    [MLD_FIELD_CHKSUM] =
     { .name = "chksum",
       .help = "Checksum",
       .bit_width = 16},
+    [MLD_FIELD_MAX_RESP] =
     { .name = "max_resp",
       .help = "Maximum Response Delay (MLDv1) or Maximum Response Code (MLDv2), Query, only",
       .bit_width = 16},
+    [MLD_FIELD_RSV] =
     { .name = "rsv",
       .help = "Reserved",
       .bit_width = 16},
+    [MLD_FIELD_GA] =
     { .name = "ga",
       .help = "Group Address (not to be used in MLDv2 reports)",
       .bit_width = 128},
+    [MLD_FIELD_QRESV] =
     { .name = "qresv",
       .help = "Reserved (MLDv2, Query, only)",
       .bit_width = 4},
+    [MLD_FIELD_S] =
     { .name = "s",
       .help = "Suppress Router-Side Processing (MLDv2, Query, only)",
       .bit_width = 1},
+    [MLD_FIELD_QRV] =
     { .name = "qrv",
       .help = "Querier's Robustness Variable (MLDv2, Query, only)",
       .bit_width = 3},
+    [MLD_FIELD_QQIC] =
     { .name = "qqic",
       .help = "Querier's Query Interval Code (MLDv2, Query, only)",
       .bit_width = 8},
+    [MLD_FIELD_NS] =
     { .name = "ns",
       .help = "Number of Sources (MLDv2, Query, only)",
       .bit_width = 16},
+    [MLD_FIELD_RRESV] =
     { .name = "rresv",
       .help = "Reserved (MLDv3, Report, only)",
       .bit_width = 16},
+    [MLD_FIELD_NG] =
     { .name = "ng",
       .help = "Number of Group Records (MLDv2, Report, only)",
       .bit_width = 16},
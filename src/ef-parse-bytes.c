@@ -1,33 +1,17 @@
 #include "ef.h"
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <endian.h>
 #include <arpa/inet.h>
 
-struct start_with {
-    uint32_t mask;
-    const char *s;
-};
-
 enum {
     START_WITH_0x = (1 << 0),
     START_WITH_0o = (1 << 1),
     START_WITH_0b = (1 << 2),
 };
 
-static struct start_with start_withs[] = {
-    {START_WITH_0x, "0x"},
-    {START_WITH_0o, "0o"},
-    {START_WITH_0b, "0b"},
-};
-
-struct has_char {
-    uint32_t    mask;
-    const char *char_set;
-    uint32_t    cnt;
-};
-
 enum {
     HAS_BASE_2     = (1 << 0),
     HAS_BASE_8     = (1 << 1),
@@ -37,25 +21,40 @@ enum {
     HAS_COLON      = (1 << 5),
 };
 
-#define HAS_HEX_COL (HAS_BASE_2 | HAS_BASE_8 | HAS_BASE_10 | HAS_BASE_16 | \
-                     HAS_COLON)
-#define HAS_HEX_DOT (HAS_BASE_2 | HAS_BASE_8 | HAS_BASE_10 | HAS_BASE_16 | \
-                     HAS_DOT)
-
-static struct has_char has_chars[] = {
-    {.mask = HAS_BASE_2,  .char_set = "01" },
-    {.mask = HAS_BASE_8,  .char_set = "234567" },
-    {.mask = HAS_BASE_10, .char_set = "89" },
-    {.mask = HAS_BASE_16, .char_set = "aAbBcCdDeEfF" },
-    {.mask = HAS_DOT,     .char_set = "." },
-    {.mask = HAS_COLON,   .char_set = ":" },
+#define HAS_BASE_ALL (HAS_BASE_2 | HAS_BASE_8 | HAS_BASE_10 | HAS_BASE_16)
+#define HAS_HEX_COL  (HAS_BASE_ALL | HAS_COLON)
+#define HAS_HEX_DOT  (HAS_BASE_ALL | HAS_DOT)
+
+// Character class of each input character. Zero means any other character.
+static const uint8_t CHAR_CLASS[256] = {
+    ['0'] = HAS_BASE_2,  ['1'] = HAS_BASE_2,
+    ['2'] = HAS_BASE_8,  ['3'] = HAS_BASE_8,  ['4'] = HAS_BASE_8,
+    ['5'] = HAS_BASE_8,  ['6'] = HAS_BASE_8,  ['7'] = HAS_BASE_8,
+    ['8'] = HAS_BASE_10, ['9'] = HAS_BASE_10,
+    ['a'] = HAS_BASE_16, ['b'] = HAS_BASE_16, ['c'] = HAS_BASE_16,
+    ['d'] = HAS_BASE_16, ['e'] = HAS_BASE_16, ['f'] = HAS_BASE_16,
+    ['A'] = HAS_BASE_16, ['B'] = HAS_BASE_16, ['C'] = HAS_BASE_16,
+    ['D'] = HAS_BASE_16, ['E'] = HAS_BASE_16, ['F'] = HAS_BASE_16,
+    ['.'] = HAS_DOT,
+    [':'] = HAS_COLON,
 };
 
-buf_t *parse_bytes_binary(const char *s, int size) {
-    buf_t *b;
-    uint8_t *p_o, tmp;
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+// Parse a binary string into the right-most bits of o[0..size[
+static int parse_bytes_binary_into(const char *s, uint8_t *o, int size) {
+    uint8_t *p_o;
     const char *p;
-    int cnt_bits, has_others, has_align_issues, valid;
+    int cnt_bits, has_others, has_align_issues;
 
     p = s;
     cnt_bits = 0;
@@ -76,519 +75,452 @@ buf_t *parse_bytes_binary(const char *s, int size) {
 
     if (has_others || cnt_bits == 0) {
         po("ERROR: Could not parse >%s< as a hex string\n", s);
-        return 0;
+        return -1;
     }
 
     if (has_align_issues) {
         po("ERROR: hex strings must be byte aligned, and if delimiters are then they must also be byte aligned.\n");
-        return 0;
+        return -1;
     }
 
-    b = balloc(size);
+    if (cnt_bits / 8 > size) {
+        po("ERROR: >%s< does not fit in %d bytes\n", s, size);
+        return -1;
+    }
 
-    p = s;
-    p_o = b->data + size - cnt_bits / 8;
+    memset(o, 0, size);
+    p_o = o + size - cnt_bits / 8;
     cnt_bits = 0;
 
-    for (; *p; ++p) {
-        if (*p == '0' || *p == '1') {
-            valid = 1;
-            tmp = *p - '0';
-        } else {
-            valid = 0;
-        }
+    for (p = s; *p; ++p) {
+        *p_o |= *p - '0';
+        cnt_bits++;
 
-        if (valid) {
-            *p_o |= tmp;
-            cnt_bits++;
-
-            if (cnt_bits % 8 == 0)
-                p_o ++;
-            else
-                *p_o <<= 1;
-        }
+        if (cnt_bits % 8 == 0)
+            p_o ++;
+        else
+            *p_o <<= 1;
     }
 
-    return b;
+    return 0;
 }
 
-buf_t *parse_bytes_hex(const char *s, int size) {
-    buf_t *b;
-    uint8_t *p_o, tmp;
-    const char *p;
-    int cnt_nibble, has_others, has_align_issues, valid;
-
-    p = s;
-    cnt_nibble = 0;
-    has_others = 0;
-    has_align_issues = 0;
+// Parse a hex string into the right-most bytes of o[0..size[
+static int parse_bytes_hex_into(const char *s, uint8_t *o, int size) {
+    size_t len;
+    int res;
 
-    for (; *p; ++p) {
-        if (*p >= '0' && *p <= '9') {
-            cnt_nibble ++;
-        } else if (*p >= 'a' && *p <= 'f') {
-            cnt_nibble ++;
-        } else if (*p >= 'A' && *p <= 'F') {
-            cnt_nibble ++;
-        } else if (*p == '.' || *p == ':' || *p == '-' || *p == '_') {
-            if (cnt_nibble % 2 != 0) {
-                has_align_issues = 1;
-            }
-        } else {
-            has_others = 1;
-        }
+    res = hex_decode(s, strlen(s), o, size, &len);
+    if (res == HEX_DECODE_SIZE) {
+        po("ERROR: >%s< does not fit in %d bytes\n", s, size);
+        return -1;
+    } else if (res < 0) {
+        hex_decode_err_print(s, res);
+        return -1;
     }
 
-    if (cnt_nibble % 2 != 0) {
-        has_align_issues = 1;
-    }
+    memmove(o + size - len, o, len);
+    memset(o, 0, size - len);
 
-    if (has_others || cnt_nibble == 0) {
-        po("ERROR: Could not parse >%s< as a hex string\n", s);
-        return 0;
-    }
+    return 0;
+}
 
-    if (has_align_issues) {
-        po("ERROR: hex strings must be byte aligned, and if delimiters are then they must also be byte aligned.\n");
-        return 0;
-    }
+// Dotted decimal IPv4 address, with the same rules as inet_pton(): exactly
+// four octets, and no leading zeros.
+static int parse_ipv4_into(const char *s, uint8_t *o) {
+    int octets = 0, digits = 0;
+    unsigned val = 0;
+    uint8_t tmp[4];
 
-    b = balloc(size);
+    for (;; ++s) {
+        if (*s >= '0' && *s <= '9') {
+            if (digits && val == 0)
+                return -1;
 
-    p = s;
-    p_o = b->data + size - cnt_nibble / 2;
-    cnt_nibble = 0;
+            val = val * 10 + (*s - '0');
+            if (val > 255)
+                return -1;
 
-    for (; *p; ++p) {
-        if (*p >= '0' && *p <= '9') {
-            valid = 1;
-            tmp = *p - '0';
+            digits++;
+
+        } else if (*s == '.' || *s == 0) {
+            if (!digits || octets == 4)
+                return -1;
 
-        } else if (*p >= 'a' && *p <= 'f') {
-            valid = 1;
-            tmp = (*p - 'a') + 10;
+            tmp[octets++] = val;
+            val = 0;
+            digits = 0;
 
-        } else if (*p >= 'A' && *p <= 'F') {
-            valid = 1;
-            tmp = (*p - 'A') + 10;
+            if (*s == 0)
+                break;
 
         } else {
-            valid = 0;
+            return -1;
         }
+    }
 
-        if (valid) {
-            *p_o |= tmp;
-            cnt_nibble++;
+    if (octets != 4)
+        return -1;
 
-            if (cnt_nibble % 2 == 1)
-                *p_o <<= 4;
-            else
-                p_o++;
-        }
-    }
+    memcpy(o, tmp, 4);
 
-    return b;
+    return 0;
 }
 
+// IPv6 address as specified by RFC 4291 section 2.2, including the embedded
+// IPv4 form. This follows the reference implementation of inet_pton().
+static int parse_ipv6_into(const char *s, uint8_t *o) {
+    uint8_t tmp[16] = {}, *tp = tmp, *endp = tmp + 16, *colonp = 0;
+    const char *curtok;
+    int val_cnt = 0, nibble, n;
+    unsigned val = 0;
+    char c;
 
-buf_t *parse_bytes(const char *s, int bytes) {
-    buf_t *b;
-    size_t i;
-    int base, s_size = strlen(s);
-    const char *s_begin = s, *data_begin = s;
-    const char *data_end = data_begin + s_size;
-    uint32_t has_mask = 0;
-    int has_other = 0;
-    uint32_t start_mask = 0;
+    if (*s == ':' && *++s != ':')
+        return -1;
 
-    // po("line: %d %s\n", __LINE__, s);
-    for (i = 0; i < sizeof(start_withs)/sizeof(start_withs[0]); ++i) {
-        int l = strlen(start_withs[i].s);
-        if (s_size >= l && strncmp(s, start_withs[i].s, l) == 0) {
-            start_mask |= start_withs[i].mask;
-            data_begin = s_begin + l;
-            break;
+    curtok = s;
+    while ((c = *s++)) {
+        nibble = hex_nibble(c);
+        if (nibble >= 0) {
+            val = (val << 4) | nibble;
+            if (++val_cnt > 4)
+                return -1;
+            continue;
         }
-    }
-
-    for (s = data_begin; *s; ++s) {
-        int match_found = 0;
-        for (i = 0; i < sizeof(has_chars)/sizeof(has_chars[0]); ++i) {
-            const char *set_i;
 
-            for (set_i = has_chars[i].char_set; *set_i; ++set_i) {
-                if (*s == *set_i) {
-                    has_mask |= has_chars[i].mask;
-                    match_found = 1;
-                    has_chars[i].cnt++;
-                }
+        if (c == ':') {
+            curtok = s;
+            if (!val_cnt) {
+                if (colonp)
+                    return -1;
+                colonp = tp;
+                continue;
+            } else if (*s == 0) {
+                return -1;
             }
-        }
-        if (!match_found) {
-            has_other = 1;
-        }
-    }
 
-    base = 0;
-    //po("line: %d %08x %08x %d %d\n", __LINE__, start_mask, has_mask, has_other, bytes);
-    if (start_mask == START_WITH_0x && !has_other &&
-        ((has_mask & ~(HAS_BASE_2 | HAS_BASE_8 | HAS_BASE_10 | HAS_BASE_16)) == 0)) {
-        //po("line: %d\n", __LINE__);
-        base = 16;
+            if (tp + 2 > endp)
+                return -1;
 
-    } else if (start_mask == 0 && !has_other &&
-               ((has_mask & ~(HAS_BASE_2 | HAS_BASE_8 | HAS_BASE_10)) == 0)) {
-        //po("line: %d\n", __LINE__);
-        base = 10;
-
-    } else if (start_mask == START_WITH_0o && !has_other &&
-               ((has_mask & ~(HAS_BASE_2 | HAS_BASE_8)) == 0)) {
-        //po("line: %d\n", __LINE__);
-        base = 8;
-
-    } else if (start_mask == START_WITH_0b && !has_other &&
-               ((has_mask & ~(HAS_BASE_2)) == 0)) {
-        //po("line: %d\n", __LINE__);
-        base = 2;
-    }
-
-    if (base && bytes <= 8) {
-        char *endptr, *o;
-        uint64_t val;
-
-        errno = 0;
-        val = strtoull(data_begin, &endptr, base);
-
-        if (endptr != data_end || errno) {
-            return 0;
+            *tp++ = val >> 8;
+            *tp++ = val;
+            val_cnt = 0;
+            val = 0;
+            continue;
         }
 
-        val = htobe64(val);
+        if (c == '.' && tp + 4 <= endp && parse_ipv4_into(curtok, tp) == 0) {
+            tp += 4;
+            val_cnt = 0;
+            break;
+        }
 
-        b = balloc(bytes);
-        if (!b)
-            return b;
+        return -1;
+    }
 
-        o = (char *)&val;
-        o += 8 - bytes;
-        memcpy(b->data, o, bytes);
+    if (val_cnt) {
+        if (tp + 2 > endp)
+            return -1;
 
-        return b;
-    } else if (base) {
-        if (base == 16) {
-            return parse_bytes_hex(data_begin, bytes);
-        }
-        if (base == 2) {
-            return parse_bytes_binary(data_begin, bytes);
-        }
+        *tp++ = val >> 8;
+        *tp++ = val;
     }
 
-    //po("line: %d %d %d\n", __LINE__, bytes, has_other);
-    //po("line: %d %d\n", __LINE__, has_mask & ~(HAS_HEX_COL));
-    //po("line: %d b2:  %d\n", __LINE__, has_mask & HAS_BASE_2);
-    //po("line: %d b8:  %d\n", __LINE__, has_mask & HAS_BASE_8);
-    //po("line: %d b10: %d\n", __LINE__, has_mask & HAS_BASE_10);
-    //po("line: %d b16: %d\n", __LINE__, has_mask & HAS_BASE_16);
-    //po("line: %d has colon: %d\n", __LINE__, has_mask & HAS_COLON);
-    //po("line: %d has dot:   %d\n", __LINE__, has_mask & HAS_DOT);
-    //po("line: %d has other:   %d\n", __LINE__, has_other);
+    if (colonp) {
+        if (tp == endp)
+            return -1;
 
-    if (start_mask == 0 && bytes == 4 && !has_other &&
-        ((has_mask & ~(HAS_HEX_DOT)) == 0) && (has_mask & HAS_DOT)) {
-        // This will be treated as an IPv4
-        unsigned char buf[sizeof(struct in6_addr)];
-        //po("line: %d\n", __LINE__);
+        n = tp - colonp;
+        memmove(endp - n, colonp, n);
+        memset(colonp, 0, endp - n - colonp);
+        tp = endp;
+    }
 
-        if (inet_pton(AF_INET, data_begin, buf) == 1) {
-            b = balloc(4);
-            if (!b)
-                return b;
-            memcpy(b->data, buf, 4);
+    if (tp != endp)
+        return -1;
 
-            return b;
+    memcpy(o, tmp, 16);
 
-        } else {
-            po("%s:%d: ERROR, could not parse input as an IPv4 address\n",
-                   __FILE__, __LINE__);
-            return 0;
-        }
+    return 0;
+}
 
-    } else if (start_mask == 0 && bytes == 6 && !has_other &&
-               ((has_mask & ~(HAS_HEX_COL)) == 0) && (has_mask & HAS_COLON)) {
-        // This will be treated as a mac-address
-        uint8_t m[6] = {};
-        const char *x;
-
-        // We want to be able to write something like this (like we RFC2373
-        // specifies for IPv6):
-        //
-        // ::      -> 00:00:00:00:00:00
-        // ::1     -> 00:00:00:00:00:01
-        // 1::     -> 01:00:00:00:00:00
-        // 01::20  -> 01:00:00:00:00:20
-        // 1::2    -> 01:00:00:00:00:02
-        // 1:2::3  -> 01:02:00:00:00:03
-
-        int idx = 0;
-        int split = 0;
-        int split_cnt = 0;
-        int val_cnt = 0;
-        int col_cnt = 0;
-        int element_cnt = 0;
-        int move_from, move_to, move_size;
-
-        //po("line: %d data_begin: %s\n", __LINE__, data_begin);
-
-        for (x = data_begin; *x; ++x) {
-            int colon = 0;
-            int val = 0;
-
-            if (*x >= '0' && *x <= '9') {
-                val = *x - '0';
-
-            } else if (*x >= 'a' && *x <= 'f') {
-                val = *x - 'a' + 0xa;
-
-            } else if (*x >= 'A' && *x <= 'F') {
-                val = *x - 'A' + 0xa;
-
-            } else if (*x == ':') {
+// MAC address, where (like RFC2373 specifies for IPv6) '::' may be used once
+// to fill in zeros:
+//
+// ::      -> 00:00:00:00:00:00
+// ::1     -> 00:00:00:00:00:01
+// 1::     -> 01:00:00:00:00:00
+// 01::20  -> 01:00:00:00:00:20
+// 1::2    -> 01:00:00:00:00:02
+// 1:2::3  -> 01:02:00:00:00:03
+static int parse_mac_into(const char *s, uint8_t *o) {
+    uint8_t m[6] = {};
+    const char *x;
+    int idx = 0;
+    int split = 0;
+    int split_cnt = 0;
+    int val_cnt = 0;
+    int col_cnt = 0;
+    int element_cnt = 0;
+    int move_from, move_to, move_size;
+
+    for (x = s; *x; ++x) {
+        int colon = 0;
+        int val = hex_nibble(*x);
+
+        if (val < 0) {
+            if (*x == ':') {
                 colon = 1;
-
             } else {
                 po("%s:%d: ERROR\n", __FILE__, __LINE__);
-                return 0;
-
-            }
-
-            //po("%d val:%x val_cnt:%d col_cnt:%d, idx:%d colon:%d\n",
-            //       __LINE__, val, val_cnt, col_cnt, idx, colon);
-
-            if (idx > 5) {
-                po("%s:%d: ERROR\n", __FILE__, __LINE__);
-                return 0;
+                return -1;
             }
+        }
 
-            if (colon) {
-                if (val_cnt != 0 && col_cnt == 0)
-                    idx++;
+        if (idx > 5) {
+            po("%s:%d: ERROR\n", __FILE__, __LINE__);
+            return -1;
+        }
 
-                val_cnt = 0;
-                col_cnt ++;
+        if (colon) {
+            if (val_cnt != 0 && col_cnt == 0)
+                idx++;
 
-                if (col_cnt == 2) {
-                    split_cnt ++;
+            val_cnt = 0;
+            col_cnt ++;
 
-                    if (split_cnt > 1) {
-                        po("%s:%d: ERROR\n", __FILE__, __LINE__);
-                        return 0;
-                    }
+            if (col_cnt == 2) {
+                split_cnt ++;
 
-                    if (split) {
-                        po("%s:%d: ERROR\n", __FILE__, __LINE__);
-                        return 0;
-                    } else {
-                        split = idx;
-                    }
-                } else if (col_cnt > 2) {
+                if (split_cnt > 1) {
                     po("%s:%d: ERROR\n", __FILE__, __LINE__);
-                    return 0;
+                    return -1;
                 }
 
-            } else {
-                val_cnt ++;
-                col_cnt = 0;
-
-                if (val_cnt > 2) {
+                if (split) {
                     po("%s:%d: ERROR\n", __FILE__, __LINE__);
-                    return 0;
+                    return -1;
+                } else {
+                    split = idx;
                 }
+            } else if (col_cnt > 2) {
+                po("%s:%d: ERROR\n", __FILE__, __LINE__);
+                return -1;
+            }
 
-                if (val_cnt == 1)
-                    element_cnt ++;
-                m[idx] <<= 4;
-                m[idx] |= val;
+        } else {
+            val_cnt ++;
+            col_cnt = 0;
 
-                //po("line: %d, idx: %d, %02x\n", __LINE__, idx, m[idx]);
+            if (val_cnt > 2) {
+                po("%s:%d: ERROR\n", __FILE__, __LINE__);
+                return -1;
             }
-        }
 
-        if (split_cnt > 1) {
-            po("%s:%d: ERROR\n", __FILE__, __LINE__);
-            return 0;
-        }
-
-        if (element_cnt > 6) {
-            po("%s:%d: ERROR\n", __FILE__, __LINE__);
-            return 0;
+            if (val_cnt == 1)
+                element_cnt ++;
+            m[idx] <<= 4;
+            m[idx] |= val;
         }
+    }
 
-        if (element_cnt >= 6 && split_cnt > 0) {
-            po("%s:%d: ERROR\n", __FILE__, __LINE__);
-            return 0;
-        }
+    if (split_cnt > 1) {
+        po("%s:%d: ERROR\n", __FILE__, __LINE__);
+        return -1;
+    }
 
-        move_from = split;
-        move_to = 6 - element_cnt + split;
-        move_size = element_cnt - split;
+    if (element_cnt > 6) {
+        po("%s:%d: ERROR\n", __FILE__, __LINE__);
+        return -1;
+    }
 
-        //po("%d split:%d element_cnt:%d from:%d, to:%d, size:%d\n",
-        //       __LINE__, split, element_cnt, move_from, move_to, move_size);
+    if (element_cnt >= 6 && split_cnt > 0) {
+        po("%s:%d: ERROR\n", __FILE__, __LINE__);
+        return -1;
+    }
 
-        //po("%02x:%02x:%02x:%02x:%02x:%02x\n", m[0],  m[1], m[2], m[3], m[4], m[5]);
+    move_from = split;
+    move_to = 6 - element_cnt + split;
+    move_size = element_cnt - split;
 
-        memmove(m + move_to, m + move_from, move_size);
-        //po("%02x:%02x:%02x:%02x:%02x:%02x\n", m[0],  m[1], m[2], m[3], m[4], m[5]);
-        memset(m + split, 0, move_to - move_from);
+    memmove(m + move_to, m + move_from, move_size);
+    memset(m + split, 0, move_to - move_from);
+    memcpy(o, m, 6);
 
-        //po("%02x:%02x:%02x:%02x:%02x:%02x\n", m[0],  m[1], m[2], m[3], m[4], m[5]);
+    return 0;
+}
 
-        b = balloc(6);
-        if (!b) {
-            po("%s:%d: ERROR\n", __FILE__, __LINE__);
-            return b;
+// Parse a value into the 'bytes' bytes at 'o', without allocating. The input
+// is classified in a single pass, and then handed to the parser of the
+// detected format. Returns 0 on success, and -1 if the input could not be
+// parsed.
+int parse_bytes_into(const char *s, uint8_t *o, int bytes) {
+    int base;
+    uint8_t c, has_mask = 0;
+    uint32_t start_mask = 0;
+    const char *data_begin = s, *p;
+
+    if (s[0] == '0') {
+        if (s[1] == 'x') {
+            start_mask = START_WITH_0x;
+        } else if (s[1] == 'o') {
+            start_mask = START_WITH_0o;
+        } else if (s[1] == 'b') {
+            start_mask = START_WITH_0b;
         }
-        memcpy(b->data, m, 6);
 
-        return b;
+        if (start_mask)
+            data_begin = s + 2;
+    }
 
+    for (p = data_begin; *p; ++p) {
+        c = CHAR_CLASS[(uint8_t)*p];
 
-    } else if (start_mask == 0 && bytes == 16 && !has_other &&
-               ((has_mask & ~(HAS_HEX_COL | HAS_DOT)) == 0) &&
-               (has_mask & HAS_COLON)) {
+        // None of the formats accept other characters
+        if (!c)
+            return -1;
 
-        // This will be treated as an IPv6
-        unsigned char buf[sizeof(struct in6_addr)];
-        //po("line: %d\n", __LINE__);
+        has_mask |= c;
+    }
 
-        if (inet_pton(AF_INET6, data_begin, buf) == 1) {
-            b = balloc(16);
-            if (!b) {
-                po("%s:%d: ERROR\n", __FILE__, __LINE__);
-                return b;
-            }
-            memcpy(b->data, buf, 16);
+    base = 0;
+    if (start_mask == START_WITH_0x &&
+        ((has_mask & ~HAS_BASE_ALL) == 0)) {
+        base = 16;
 
-            return b;
+    } else if (start_mask == 0 &&
+               ((has_mask & ~(HAS_BASE_2 | HAS_BASE_8 | HAS_BASE_10)) == 0)) {
+        base = 10;
 
-        } else {
-            po("%s:%d: ERROR\n", __FILE__, __LINE__);
-            return 0;
+    } else if (start_mask == START_WITH_0o &&
+               ((has_mask & ~(HAS_BASE_2 | HAS_BASE_8)) == 0)) {
+        base = 8;
 
-        }
+    } else if (start_mask == START_WITH_0b &&
+               ((has_mask & ~(HAS_BASE_2)) == 0)) {
+        base = 2;
     }
 
-    return 0;
-}
-
-buf_t *parse_var_bytes_hex(const char *s, int min_size) {
-    buf_t *b;
-    uint8_t *p_o, tmp;
-    const char *p;
-    int cnt_nibble, has_others, has_align_issues, valid;
+    if (base && bytes <= 8) {
+        char *endptr;
+        uint64_t val;
 
-    p = s;
-    cnt_nibble = 0;
-    has_others = 0;
-    has_align_issues = 0;
+        errno = 0;
+        val = strtoull(data_begin, &endptr, base);
 
-    for (; *p; ++p) {
-        if (*p >= '0' && *p <= '9') {
-            cnt_nibble ++;
-        } else if (*p >= 'a' && *p <= 'f') {
-            cnt_nibble ++;
-        } else if (*p >= 'A' && *p <= 'F') {
-            cnt_nibble ++;
-        } else if (*p == '.' || *p == ':' || *p == '-' || *p == '_') {
-            if (cnt_nibble % 2 != 0) {
-                has_align_issues = 1;
-            }
-        } else {
-            has_others = 1;
+        if (*endptr || errno) {
+            return -1;
         }
-    }
 
-    if (cnt_nibble % 2 != 0) {
-        has_align_issues = 1;
-    }
+        val = htobe64(val);
+        memcpy(o, (uint8_t *)&val + 8 - bytes, bytes);
 
-    if (has_others || cnt_nibble == 0) {
-        po("ERROR: Could not parse >%s< as a hex string\n", s);
         return 0;
+
+    } else if (base == 16) {
+        return parse_bytes_hex_into(data_begin, o, bytes);
+
+    } else if (base == 2) {
+        return parse_bytes_binary_into(data_begin, o, bytes);
+
+    } else if (base) {
+        return -1;
     }
 
-    if (has_align_issues) {
-        po("ERROR: hex strings must be byte aligned, and if delimiters are then they must also be byte aligned.\n");
+    if (start_mask)
+        return -1;
+
+    if (bytes == 4 && ((has_mask & ~(HAS_HEX_DOT)) == 0) &&
+        (has_mask & HAS_DOT)) {
+        if (parse_ipv4_into(data_begin, o) < 0) {
+            po("%s:%d: ERROR, could not parse input as an IPv4 address\n",
+                   __FILE__, __LINE__);
+            return -1;
+        }
+
         return 0;
-    }
 
-    if (cnt_nibble / 2 > min_size) {
-        b = balloc(cnt_nibble / 2);
-    } else {
-        b = balloc(min_size);
+    } else if (bytes == 6 && ((has_mask & ~(HAS_HEX_COL)) == 0) &&
+               (has_mask & HAS_COLON)) {
+        return parse_mac_into(data_begin, o);
+
+    } else if (bytes == 16 && ((has_mask & ~(HAS_HEX_COL | HAS_DOT)) == 0) &&
+               (has_mask & HAS_COLON)) {
+        if (parse_ipv6_into(data_begin, o) < 0) {
+            po("%s:%d: ERROR\n", __FILE__, __LINE__);
+            return -1;
+        }
+
+        return 0;
     }
 
-    p = s;
-    p_o = b->data;
-    cnt_nibble = 0;
+    return -1;
+}
 
-    for (; *p; ++p) {
-        if (*p >= '0' && *p <= '9') {
-            valid = 1;
-            tmp = *p - '0';
+buf_t *parse_bytes(const char *s, int bytes) {
+    buf_t *b = balloc(bytes);
 
-        } else if (*p >= 'a' && *p <= 'f') {
-            valid = 1;
-            tmp = (*p - 'a') + 10;
+    if (!b)
+        return 0;
 
-        } else if (*p >= 'A' && *p <= 'F') {
-            valid = 1;
-            tmp = (*p - 'A') + 10;
+    if (parse_bytes_into(s, b->data, bytes) < 0) {
+        bfree(b);
+        return 0;
+    }
 
-        } else {
-            valid = 0;
-        }
+    return b;
+}
+
+buf_t *parse_var_bytes_hex(const char *s, int min_size) {
+    buf_t *b;
+    size_t s_len = strlen(s), len;
+    int res;
 
-        if (valid) {
-            *p_o |= tmp;
-            cnt_nibble++;
+    // Every byte takes at least two characters
+    b = balloc(s_len / 2 > (size_t)min_size ? s_len / 2 : (size_t)min_size);
+    if (!b)
+        return 0;
 
-            if (cnt_nibble % 2 == 1)
-                *p_o <<= 4;
-            else
-                p_o++;
-        }
+    res = hex_decode(s, s_len, b->data, b->size, &len);
+    if (res < 0) {
+        hex_decode_err_print(s, res);
+        bfree(b);
+        return 0;
     }
 
+    if (len > (size_t)min_size)
+        b->size = len;
+    else
+        b->size = min_size;
+
     return b;
 }
 
 buf_t *parse_field_hex(struct hdr *hdr, int hdr_offset, const char *s, int bytes)
 {
     buf_t *b;
-    buf_t *b_ret = 0;
+    size_t len;
+    int res;
 
-    b_ret = balloc(bytes);
-    if (!b_ret) {
-        po("%s:%d: ERROR: Memory alloc\n", __FILE__, __LINE__);
-        return 0;
-    }
-    b = parse_var_bytes_hex(s, 0);
+    b = balloc(bytes);
     if (!b) {
-        bfree(b_ret);
+        po("%s:%d: ERROR: Memory alloc\n", __FILE__, __LINE__);
         return 0;
     }
 
-    if (b->size > (size_t)bytes) {
+    res = hex_decode(s, strlen(s), b->data, b->size, &len);
+    if (res == HEX_DECODE_SIZE) {
         po("%s:%d: ERROR: Parsed field size is too large\n", __FILE__, __LINE__);
+        bfree(b);
+        return 0;
+    } else if (res < 0) {
+        hex_decode_err_print(s, res);
+        bfree(b);
         return 0;
     }
 
-    memset(b_ret->data, 0, sizeof(bytes));
-    memcpy(b_ret->data, b->data, b->size);
-    bfree(b);
-
-    return(b_ret);
+    return b;
 }
 
 buf_t *parse_var_bytes_ascii(const char *s) {
@@ -686,9 +618,29 @@ buf_t *parse_var_bytes_pattern(const char *pat, const char *len_) {
     return b;
 }
 
+// The file is mapped rather than read, see bmap_file()
+buf_t *parse_var_bytes_file(const char *path, const char *offset_,
+                            const char *len_) {
+    uint32_t offset = 0, len = 0;
+
+    if (offset_ && parse_uint32(offset_, &offset) != 0)
+        return 0;
+
+    if (len_ && parse_uint32(len_, &len) != 0)
+        return 0;
+
+    if (len_ && !len) {
+        po("ERROR: The length of the data must not be zero\n");
+        return 0;
+    }
+
+    return bmap_file(path, offset, len);
+}
+
 // hex <hex-str>
 // repeat <cnt> <val>
 // pad cnt <cnt>
+// file <path> [<offset> <len>]
 int parse_var_bytes_(buf_t **b_out, int argc, const char *argv[]) {
     buf_t *b;
     int i = 0;
@@ -697,7 +649,7 @@ int parse_var_bytes_(buf_t **b_out, int argc, const char *argv[]) {
         return 0;
 
     if (strcmp(argv[i], "help") == 0) {
-        po("Supported sub-commands: hex <hex-str>, ascii <str>, ascii0 <str>, repeat <cnt> <val>, pattern (cnt|zero|ones) <cnt>\n");
+        po("Supported sub-commands: hex <hex-str>, ascii <str>, ascii0 <str>, repeat <cnt> <val>, pattern (cnt|zero|ones) <cnt>, file <path> [<offset> <len>]\n");
         return -1;
 
     } else if (strcmp(argv[i], "hex") == 0) {
@@ -745,6 +697,23 @@ int parse_var_bytes_(buf_t **b_out, int argc, const char *argv[]) {
         b = parse_var_bytes_pattern(argv[i], argv[i + 1]);
         i += 2;
 
+    } else if (strcmp(argv[i], "file") == 0) {
+        i++;
+        if (i >= argc) {
+            return -1;
+        }
+
+        // The offset and length are optional, and only taken if both are
+        // numbers - a following sub-command never starts with a digit.
+        if (i + 2 < argc && isdigit((unsigned char)argv[i + 1][0]) &&
+            isdigit((unsigned char)argv[i + 2][0])) {
+            b = parse_var_bytes_file(argv[i], argv[i + 1], argv[i + 2]);
+            i += 3;
+        } else {
+            b = parse_var_bytes_file(argv[i], 0, 0);
+            i += 1;
+        }
+
     } else {
         return 0;
     }
@@ -0,0 +1,617 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <byteswap.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ef.h"
+
+#define PCAP_MAGIC_USEC      0xa1b2c3d4
+#define PCAP_MAGIC_NSEC      0xa1b23c4d
+#define PCAP_VERSION_MAJOR   2
+#define PCAP_VERSION_MINOR   4
+#define PCAP_LINKTYPE_ETHER  1
+#define PCAP_WRITER_BUF_SIZE (1024 * 1024)
+
+#define PCAPNG_BLOCK_SHB     0x0a0d0d0a
+#define PCAPNG_BLOCK_IDB     0x00000001
+#define PCAPNG_BLOCK_SPB     0x00000003
+#define PCAPNG_BLOCK_EPB     0x00000006
+#define PCAPNG_BYTE_ORDER    0x1a2b3c4d
+#define PCAPNG_OPT_END       0
+#define PCAPNG_OPT_IF_NAME   2
+#define PCAPNG_OPT_TSRESOL   9
+
+#define PAD4(x) (((x) + 3) & ~3u)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t  thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+} pcap_file_hdr_t;
+
+typedef struct {
+    uint32_t ts_sec;
+    uint32_t ts_frac;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} pcap_rec_hdr_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t len;
+    uint32_t byte_order;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int64_t  section_len;
+    uint32_t len_trailer;
+} __attribute__((packed)) pcapng_shb_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t len;
+    uint32_t if_id;
+    uint32_t ts_high;
+    uint32_t ts_low;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} pcapng_epb_hdr_t;
+
+static int write_all(int fd, const uint8_t *d, size_t len) {
+    ssize_t res;
+
+    while (len) {
+        res = write(fd, d, len);
+        TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        d += res;
+        len -= res;
+    }
+
+    return 0;
+}
+
+int pcap_writer_flush(pcap_writer_t *w) {
+    int res;
+
+    if (!w->len)
+        return 0;
+
+    res = write_all(w->fd, w->buf, w->len);
+    w->len = 0;
+
+    return res;
+}
+
+// Reserve room for len bytes in the buffer, and return a pointer to it
+static uint8_t *pcap_writer_reserve(pcap_writer_t *w, size_t len) {
+    if (w->len + len > PCAP_WRITER_BUF_SIZE && pcap_writer_flush(w) < 0)
+        return 0;
+
+    return w->buf + w->len;
+}
+
+static int pcap_writer_append(pcap_writer_t *w, const void *d, size_t len) {
+    uint8_t *o;
+
+    // Does not fit in the buffer, write it directly
+    if (len > PCAP_WRITER_BUF_SIZE) {
+        if (pcap_writer_flush(w) < 0)
+            return -1;
+        return write_all(w->fd, d, len);
+    }
+
+    o = pcap_writer_reserve(w, len);
+    if (!o)
+        return -1;
+
+    memcpy(o, d, len);
+    w->len += len;
+
+    return 0;
+}
+
+static int pcapng_write_shb(pcap_writer_t *w) {
+    pcapng_shb_t shb = {};
+
+    shb.type = PCAPNG_BLOCK_SHB;
+    shb.len = sizeof(shb);
+    shb.byte_order = PCAPNG_BYTE_ORDER;
+    shb.version_major = 1;
+    shb.version_minor = 0;
+    shb.section_len = -1;
+    shb.len_trailer = sizeof(shb);
+
+    return pcap_writer_append(w, &shb, sizeof(shb));
+}
+
+// Interface description block, with nanosecond time stamps
+static int pcapng_write_idb(pcap_writer_t *w, const char *name) {
+    uint8_t blk[128] = {};
+    uint32_t *p32 = (uint32_t *)blk;
+    uint16_t *opt;
+    size_t name_len = name ? strlen(name) : 0, len;
+
+    if (name_len > 64)
+        name_len = 64;
+
+    p32[0] = PCAPNG_BLOCK_IDB;
+    *(uint16_t *)(blk + 8) = PCAP_LINKTYPE_ETHER;
+    p32[3] = w->snaplen;
+    len = 16;
+
+    if (name_len) {
+        opt = (uint16_t *)(blk + len);
+        opt[0] = PCAPNG_OPT_IF_NAME;
+        opt[1] = name_len;
+        memcpy(blk + len + 4, name, name_len);
+        len += 4 + PAD4(name_len);
+    }
+
+    opt = (uint16_t *)(blk + len);
+    opt[0] = PCAPNG_OPT_TSRESOL;
+    opt[1] = 1;
+    blk[len + 4] = 9;
+    len += 8;
+
+    // opt_endofopt
+    len += 4;
+
+    // Trailing block length
+    len += 4;
+    p32[1] = len;
+    *(uint32_t *)(blk + len - 4) = len;
+
+    return pcap_writer_append(w, blk, len);
+}
+
+// Use the ts resolution and snaplen of an existing classic pcap file
+static int pcap_writer_adopt(pcap_writer_t *w, const char *path) {
+    pcap_file_hdr_t hdr;
+
+    if (pread(w->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+        (hdr.magic != PCAP_MAGIC_USEC && hdr.magic != PCAP_MAGIC_NSEC) ||
+        hdr.linktype != PCAP_LINKTYPE_ETHER) {
+        po("ERROR: %s is not an ethernet pcap file in host byte order\n",
+           path);
+        return -1;
+    }
+
+    w->nsec = hdr.magic == PCAP_MAGIC_NSEC;
+    w->snaplen = hdr.snaplen;
+
+    return 0;
+}
+
+// Open a capture file for writing. The file is pcapng if the name ends with
+// ".pcapng", else classic pcap with nanosecond time stamps and ethernet link
+// type. Records are buffered, and only written when the buffer is full or on
+// flush/close.
+//
+// If append is set and the file exists, then records are added to it. For
+// pcapng, this starts a new section.
+pcap_writer_t *pcap_writer_open(const char *path, uint32_t snaplen,
+                                int append) {
+    pcap_writer_t *w;
+    pcap_file_hdr_t hdr = {};
+    size_t path_len = strlen(path);
+    off_t end;
+    int res;
+
+    w = calloc(1, sizeof(*w) + PCAP_WRITER_BUF_SIZE);
+    if (!w)
+        return 0;
+
+    w->buf = (uint8_t *)(w + 1);
+    w->snaplen = snaplen;
+    w->nsec = 1;
+    w->ng = path_len >= 7 && strcmp(path + path_len - 7, ".pcapng") == 0;
+    w->fd = open(path, O_RDWR | O_CREAT | (append ? 0 : O_TRUNC), 0644);
+    if (w->fd < 0) {
+        po("ERROR: Could not open %s: %m\n", path);
+        free(w);
+        return 0;
+    }
+
+    end = lseek(w->fd, 0, SEEK_END);
+    if (end > 0 && !w->ng) {
+        res = pcap_writer_adopt(w, path);
+    } else if (w->ng) {
+        res = pcapng_write_shb(w);
+    } else {
+        hdr.magic = PCAP_MAGIC_NSEC;
+        hdr.version_major = PCAP_VERSION_MAJOR;
+        hdr.version_minor = PCAP_VERSION_MINOR;
+        hdr.snaplen = snaplen;
+        hdr.linktype = PCAP_LINKTYPE_ETHER;
+        res = pcap_writer_append(w, &hdr, sizeof(hdr));
+    }
+
+    if (res < 0) {
+        close(w->fd);
+        free(w);
+        return 0;
+    }
+
+    return w;
+}
+
+// Returns the id of the interface with the given name (which may be null),
+// adding an interface description to pcapng files the first time it is used.
+// Classic pcap files have no interfaces, and always use id 0.
+int pcap_writer_if(pcap_writer_t *w, const char *name) {
+    int i;
+
+    if (!w->ng)
+        return 0;
+
+    for (i = 0; i < w->if_cnt; ++i) {
+        if ((!name && !w->if_names[i][0]) ||
+            (name && strcmp(w->if_names[i], name) == 0))
+            return i;
+    }
+
+    if (w->if_cnt == PCAP_WRITER_IF_MAX) {
+        po("ERROR: Too many interfaces in one pcapng file\n");
+        return -1;
+    }
+
+    if (pcapng_write_idb(w, name) < 0)
+        return -1;
+
+    w->if_names[w->if_cnt] = strdup(name ? name : "");
+
+    return w->if_cnt++;
+}
+
+int pcap_writer_write(pcap_writer_t *w, int if_id, const struct timespec *ts,
+                      const uint8_t *data, uint32_t len) {
+    pcap_rec_hdr_t rec;
+    pcapng_epb_hdr_t epb;
+    uint64_t ns;
+    uint32_t incl_len, pad = 0;
+
+    incl_len = len < w->snaplen ? len : w->snaplen;
+
+    if (!w->ng) {
+        rec.ts_sec = ts->tv_sec;
+        rec.ts_frac = w->nsec ? ts->tv_nsec : ts->tv_nsec / 1000;
+        rec.orig_len = len;
+        rec.incl_len = incl_len;
+
+        if (pcap_writer_append(w, &rec, sizeof(rec)) < 0)
+            return -1;
+
+        return pcap_writer_append(w, data, incl_len);
+    }
+
+    ns = (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+    epb.type = PCAPNG_BLOCK_EPB;
+    epb.len = sizeof(epb) + PAD4(incl_len) + 4;
+    epb.if_id = if_id;
+    epb.ts_high = ns >> 32;
+    epb.ts_low = (uint32_t)ns;
+    epb.incl_len = incl_len;
+    epb.orig_len = len;
+
+    if (pcap_writer_append(w, &epb, sizeof(epb)) < 0 ||
+        pcap_writer_append(w, data, incl_len) < 0 ||
+        pcap_writer_append(w, &pad, PAD4(incl_len) - incl_len) < 0 ||
+        pcap_writer_append(w, &epb.len, 4) < 0)
+        return -1;
+
+    return 0;
+}
+
+int pcap_writer_close(pcap_writer_t *w) {
+    int i, res;
+
+    if (!w)
+        return 0;
+
+    res = pcap_writer_flush(w);
+    if (close(w->fd) < 0)
+        res = -1;
+
+    for (i = 0; i < w->if_cnt; ++i)
+        free(w->if_names[i]);
+
+    free(w);
+
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reading. The file is mapped, and records are returned as pointers into the
+// mapping. Files in either byte order are accepted.
+
+#define PCAP_READ_IF_MAX 64
+
+struct pcap_file {
+    char          *path;
+    void          *addr;
+    size_t         size;
+    const uint8_t *begin;
+    const uint8_t *p;
+    const uint8_t *end;
+    int            swap;
+    int            ng;
+    int            nsec;
+
+    // pcapng: time stamp units per second of each interface
+    int            if_cnt;
+    uint64_t       units[PCAP_READ_IF_MAX];
+};
+
+static uint32_t rd32(const pcap_file_t *f, const uint8_t *p) {
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return f->swap ? bswap_32(v) : v;
+}
+
+static uint16_t rd16(const pcap_file_t *f, const uint8_t *p) {
+    uint16_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return f->swap ? bswap_16(v) : v;
+}
+
+// Convert a time stamp in 'units' per second
+static void pcap_ts(struct timespec *ts, uint64_t t, uint64_t units) {
+    uint64_t rem = t % units;
+
+    ts->tv_sec = t / units;
+    if (units <= 1000000000ULL)
+        ts->tv_nsec = rem * 1000000000ULL / units;
+    else
+        ts->tv_nsec = rem / (units / 1000000000ULL);
+}
+
+static int pcap_next_classic(pcap_file_t *f, pcap_rec_t *rec) {
+    const uint8_t *p = f->p;
+    uint64_t units = f->nsec ? 1000000000ULL : 1000000;
+
+    if (p + sizeof(pcap_rec_hdr_t) > f->end)
+        return 0;
+
+    rec->len = rd32(f, p + 8);
+    rec->orig_len = rd32(f, p + 12);
+    if (rec->len > (size_t)(f->end - p) - sizeof(pcap_rec_hdr_t)) {
+        po("ERROR: %s: Truncated record at offset %zu\n", f->path,
+           (size_t)(p - f->begin));
+        return -1;
+    }
+
+    pcap_ts(&rec->ts, (uint64_t)rd32(f, p) * units + rd32(f, p + 4), units);
+    rec->data = p + sizeof(pcap_rec_hdr_t);
+    f->p = rec->data + rec->len;
+
+    return 1;
+}
+
+// Time stamp units per second of an interface, from the if_tsresol option
+static uint64_t pcapng_if_units(const pcap_file_t *f, const uint8_t *opt,
+                                const uint8_t *end) {
+    uint16_t code, len;
+    uint64_t units = 1000000;
+    int i;
+
+    while (opt + 4 <= end) {
+        code = rd16(f, opt);
+        len = rd16(f, opt + 2);
+        if (code == PCAPNG_OPT_END || opt + 4 + len > end)
+            break;
+
+        if (code == PCAPNG_OPT_TSRESOL && len >= 1) {
+            units = 1;
+            if (opt[4] & 0x80) {
+                units <<= (opt[4] & 0x7f) > 63 ? 63 : (opt[4] & 0x7f);
+            } else {
+                for (i = 0; i < opt[4] && i < 19; ++i)
+                    units *= 10;
+            }
+        }
+
+        opt += 4 + PAD4(len);
+    }
+
+    return units;
+}
+
+static int pcap_next_ng(pcap_file_t *f, pcap_rec_t *rec) {
+    const uint8_t *p;
+    uint32_t type, len, if_id, bom;
+
+    for (p = f->p; p + 12 <= f->end; p += len) {
+        type = rd32(f, p);
+
+        // A new section may change the byte order, and resets the interfaces
+        if (type == PCAPNG_BLOCK_SHB) {
+            if (p + 28 > f->end)
+                break;
+
+            memcpy(&bom, p + 8, sizeof(bom));
+            if (bom == PCAPNG_BYTE_ORDER) {
+                f->swap = 0;
+            } else if (bom == bswap_32(PCAPNG_BYTE_ORDER)) {
+                f->swap = 1;
+            } else {
+                po("ERROR: %s: Invalid section header\n", f->path);
+                return -1;
+            }
+
+            f->if_cnt = 0;
+        }
+
+        len = rd32(f, p + 4);
+        if (len < 12 || len % 4 || len > (size_t)(f->end - p)) {
+            po("ERROR: %s: Invalid block at offset %zu\n", f->path,
+               (size_t)(p - f->begin));
+            return -1;
+        }
+
+        if (type == PCAPNG_BLOCK_IDB && len >= 20) {
+            if (f->if_cnt == PCAP_READ_IF_MAX) {
+                po("ERROR: %s: Too many interfaces\n", f->path);
+                return -1;
+            }
+
+            if (rd16(f, p + 8) != PCAP_LINKTYPE_ETHER) {
+                po("ERROR: %s: Only ethernet link type is supported\n",
+                   f->path);
+                return -1;
+            }
+
+            f->units[f->if_cnt++] = pcapng_if_units(f, p + 16, p + len - 4);
+
+        } else if (type == PCAPNG_BLOCK_EPB && len >= 32) {
+            if_id = rd32(f, p + 8);
+            rec->len = rd32(f, p + 20);
+            rec->orig_len = rd32(f, p + 24);
+            if (if_id >= (uint32_t)f->if_cnt || rec->len > len - 32) {
+                po("ERROR: %s: Invalid packet block at offset %zu\n", f->path,
+                   (size_t)(p - f->begin));
+                return -1;
+            }
+
+            pcap_ts(&rec->ts,
+                    ((uint64_t)rd32(f, p + 12) << 32) | rd32(f, p + 16),
+                    f->units[if_id]);
+            rec->data = p + 28;
+            f->p = p + len;
+            return 1;
+
+        } else if (type == PCAPNG_BLOCK_SPB && len >= 16) {
+            // Simple packet blocks have no time stamp
+            rec->orig_len = rd32(f, p + 8);
+            rec->len = rec->orig_len < len - 16 ? rec->orig_len : len - 16;
+            memset(&rec->ts, 0, sizeof(rec->ts));
+            rec->data = p + 12;
+            f->p = p + len;
+            return 1;
+        }
+    }
+
+    f->p = f->end;
+
+    return 0;
+}
+
+// Returns 1 and the next record, 0 at the end of the file or -1 on errors
+int pcap_file_next(pcap_file_t *f, pcap_rec_t *rec) {
+    return f->ng ? pcap_next_ng(f, rec) : pcap_next_classic(f, rec);
+}
+
+// Start over from the first record
+void pcap_file_rewind(pcap_file_t *f) {
+    f->p = f->ng ? f->begin : f->begin + sizeof(pcap_file_hdr_t);
+    f->if_cnt = 0;
+}
+
+void pcap_file_close(pcap_file_t *f) {
+    if (!f)
+        return;
+
+    munmap(f->addr, f->size);
+    free(f->path);
+    free(f);
+}
+
+pcap_file_t *pcap_file_open(const char *path) {
+    pcap_file_t *f;
+    struct stat st;
+    uint32_t magic;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        po("ERROR: Could not open %s: %m\n", path);
+        return 0;
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(pcap_file_hdr_t)) {
+        po("ERROR: %s is not a pcap file\n", path);
+        close(fd);
+        return 0;
+    }
+
+    f = calloc(1, sizeof(*f));
+    if (!f) {
+        close(fd);
+        return 0;
+    }
+
+    f->size = st.st_size;
+    f->addr = mmap(0, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (f->addr == MAP_FAILED) {
+        po("ERROR: Could not map %s: %m\n", path);
+        free(f);
+        return 0;
+    }
+
+    madvise(f->addr, f->size, MADV_SEQUENTIAL);
+
+    f->path = strdup(path);
+    f->begin = f->addr;
+    f->end = f->begin + f->size;
+    memcpy(&magic, f->begin, sizeof(magic));
+
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+        f->nsec = magic == PCAP_MAGIC_NSEC;
+    } else if (magic == bswap_32(PCAP_MAGIC_USEC) ||
+               magic == bswap_32(PCAP_MAGIC_NSEC)) {
+        f->swap = 1;
+        f->nsec = magic == bswap_32(PCAP_MAGIC_NSEC);
+    } else if (magic == PCAPNG_BLOCK_SHB) {
+        f->ng = 1;
+    } else {
+        po("ERROR: %s is not a pcap file\n", path);
+        pcap_file_close(f);
+        return 0;
+    }
+
+    if (!f->ng && rd32(f, f->begin + offsetof(pcap_file_hdr_t, linktype)) !=
+                  PCAP_LINKTYPE_ETHER) {
+        po("ERROR: %s: Only ethernet link type is supported\n", path);
+        pcap_file_close(f);
+        return 0;
+    }
+
+    pcap_file_rewind(f);
+
+    return f;
+}
+
+// Read all records of a pcap or pcapng file, and call cb for each of them.
+// Returns the number of records, or -1 if the file could not be read.
+int pcap_file_read(const char *path, pcap_read_cb_t cb, void *ctx) {
+    pcap_file_t *f;
+    pcap_rec_t rec;
+    int res, cnt = 0;
+
+    f = pcap_file_open(path);
+    if (!f)
+        return -1;
+
+    while ((res = pcap_file_next(f, &rec)) > 0) {
+        cb(ctx, &rec.ts, rec.data, rec.len, rec.orig_len);
+        cnt++;
+    }
+
+    pcap_file_close(f);
+
+    return res < 0 ? -1 : cnt;
+}
@@ -3,13 +3,39 @@
 #include <stdlib.h>
 #include "ef.h"
 
+// The common PTP header, which all messages start with
+enum {
+    PTP_HDR_FIELD_TRANSPORT_SPECIFIC,
+    PTP_HDR_FIELD_MESSAGE_TYPE,
+    PTP_HDR_FIELD_MINOR_VERSION_PTP,
+    PTP_HDR_FIELD_VERSION_PTP,
+    PTP_HDR_FIELD_MESSAGE_LENGTH,
+    PTP_HDR_FIELD_DOMAIN_NUMBER,
+    PTP_HDR_FIELD_RESERVED1,
+    PTP_HDR_FIELD_FLAG_FIELD,
+    PTP_HDR_FIELD_CORRECTION_FIELD,
+    PTP_HDR_FIELD_RESERVED2,
+    PTP_HDR_FIELD_CLOCK_ID,
+    PTP_HDR_FIELD_PORT_NUMBER,
+    PTP_HDR_FIELD_SEQUENCE_ID,
+    PTP_HDR_FIELD_CONTROL_FIELD,
+    PTP_HDR_FIELD_LOG_MESSAGE_INTERVAL,
+
+    PTP_HDR_FIELD_LAST
+};
+
+enum {
+    PTP_TLV_FIELD_TYPE,
+    PTP_TLV_FIELD_LENGTH,
+};
+
 static int fill_defaults(struct frame *f, int stack_idx) {
     char buf[16];
     int i, hdr_len;
     hdr_t *h = f->stack[stack_idx];
-    field_t *len = find_field(h, "hdr-messageLength");
+    field_t *len = &h->fields[PTP_HDR_FIELD_MESSAGE_LENGTH];
 
-    if (!len || len->val)
+    if (len->val)
         return 0;
 
     hdr_len = 0;
@@ -20,7 +46,7 @@ static int fill_defaults(struct frame *f, int stack_idx) {
 
     snprintf(buf, 16, "%d", hdr_len);
     buf[15] = 0;
-    len->val = parse_bytes(buf, 2);
+    field_val_parse(len, buf, 2);
 
     return 0;
 }
@@ -29,9 +55,9 @@ static int tlv_fill_defaults(struct frame *f, int stack_idx) {
     char buf[16];
     int i, hdr_len;
     hdr_t *h = f->stack[stack_idx];
-    field_t *len = find_field(h, "tlv-length");
+    field_t *len = &h->fields[PTP_TLV_FIELD_LENGTH];
 
-    if (!len || len->val)
+    if (len->val)
         return 0;
 
     hdr_len = 0;
@@ -45,68 +71,83 @@ static int tlv_fill_defaults(struct frame *f, int stack_idx) {
 
     snprintf(buf, 16, "%d", hdr_len);
     buf[15] = 0;
-    len->val = parse_bytes(buf, 2);
+    field_val_parse(len, buf, 2);
 
     return 0;
 }
 
 static field_t SYNC_FIELDS[] = {
     /* HEADER - All fields are prefixed with "hdr-" */
+    [PTP_HDR_FIELD_TRANSPORT_SPECIFIC] =
     { .name = "hdr-transportSpecific",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_TYPE] =
     { .name = "hdr-messageType",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MINOR_VERSION_PTP] =
     { .name = "hdr-minorVersionPTP",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_VERSION_PTP] =
     { .name = "hdr-versionPTP",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_LENGTH] =
     { .name = "hdr-messageLength",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_DOMAIN_NUMBER] =
     { .name = "hdr-domainNumber",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_RESERVED1] =
     { .name = "hdr-reserved1",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_FLAG_FIELD] =
     { .name = "hdr-flagField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CORRECTION_FIELD] =
     { .name = "hdr-correctionField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   64 },
+    [PTP_HDR_FIELD_RESERVED2] =
     { .name = "hdr-reserved2",
       .help = "",
       .bit_offset =  0,
       .bit_width =   32 },
+    [PTP_HDR_FIELD_CLOCK_ID] =
     { .name = "hdr-clockId",
       .help = "",
       .bit_offset =  0,
       .bit_width =    64 },
+    [PTP_HDR_FIELD_PORT_NUMBER] =
     { .name = "hdr-portNumber",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_SEQUENCE_ID] =
     { .name = "hdr-sequenceId",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CONTROL_FIELD] =
     { .name = "hdr-controlField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_LOG_MESSAGE_INTERVAL] =
     { .name = "hdr-logMessageInterval",
       .help = "",
       .bit_offset =  0,
@@ -140,61 +181,76 @@ static hdr_t HDR_SYNC = {
 
 static field_t FOLLOW_UP_FIELDS[] = {
     /* HEADER - All fields are prefixed with "hdr-" */
+    [PTP_HDR_FIELD_TRANSPORT_SPECIFIC] =
     { .name = "hdr-transportSpecific",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_TYPE] =
     { .name = "hdr-messageType",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MINOR_VERSION_PTP] =
     { .name = "hdr-minorVersionPTP",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_VERSION_PTP] =
     { .name = "hdr-versionPTP",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_LENGTH] =
     { .name = "hdr-messageLength",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_DOMAIN_NUMBER] =
     { .name = "hdr-domainNumber",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_RESERVED1] =
     { .name = "hdr-reserved1",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_FLAG_FIELD] =
     { .name = "hdr-flagField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CORRECTION_FIELD] =
     { .name = "hdr-correctionField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   64 },
+    [PTP_HDR_FIELD_RESERVED2] =
     { .name = "hdr-reserved2",
       .help = "",
       .bit_offset =  0,
       .bit_width =   32 },
+    [PTP_HDR_FIELD_CLOCK_ID] =
     { .name = "hdr-clockId",
       .help = "",
       .bit_offset =  0,
       .bit_width =    64 },
+    [PTP_HDR_FIELD_PORT_NUMBER] =
     { .name = "hdr-portNumber",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_SEQUENCE_ID] =
     { .name = "hdr-sequenceId",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CONTROL_FIELD] =
     { .name = "hdr-controlField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_LOG_MESSAGE_INTERVAL] =
     { .name = "hdr-logMessageInterval",
       .help = "",
       .bit_offset =  0,
@@ -223,61 +279,76 @@ static hdr_t HDR_FOLLOW_UP = {
 
 static field_t REQ_FIELDS[] = {
     /* HEADER - All fields are prefixed with "hdr-" */
+    [PTP_HDR_FIELD_TRANSPORT_SPECIFIC] =
     { .name = "hdr-transportSpecific",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_TYPE] =
     { .name = "hdr-messageType",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MINOR_VERSION_PTP] =
     { .name = "hdr-minorVersionPTP",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_VERSION_PTP] =
     { .name = "hdr-versionPTP",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_LENGTH] =
     { .name = "hdr-messageLength",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_DOMAIN_NUMBER] =
     { .name = "hdr-domainNumber",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_RESERVED1] =
     { .name = "hdr-reserved1",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_FLAG_FIELD] =
     { .name = "hdr-flagField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CORRECTION_FIELD] =
     { .name = "hdr-correctionField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   64 },
+    [PTP_HDR_FIELD_RESERVED2] =
     { .name = "hdr-reserved2",
       .help = "",
       .bit_offset =  0,
       .bit_width =   32 },
+    [PTP_HDR_FIELD_CLOCK_ID] =
     { .name = "hdr-clockId",
       .help = "",
       .bit_offset =  0,
       .bit_width =    64 },
+    [PTP_HDR_FIELD_PORT_NUMBER] =
     { .name = "hdr-portNumber",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_SEQUENCE_ID] =
     { .name = "hdr-sequenceId",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CONTROL_FIELD] =
     { .name = "hdr-controlField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_LOG_MESSAGE_INTERVAL] =
     { .name = "hdr-logMessageInterval",
       .help = "",
       .bit_offset =  0,
@@ -306,48 +377,63 @@ static hdr_t HDR_REQUEST = {
 
 static field_t RESPONSE_FIELDS[] = {
     /* HEADER - All fields are prefixed with "hdr-" */
+    [PTP_HDR_FIELD_TRANSPORT_SPECIFIC] =
     { .name = "hdr-transportSpecific",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_TYPE] =
     { .name = "hdr-messageType",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MINOR_VERSION_PTP] =
     { .name = "hdr-minotrVersionPTP",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_VERSION_PTP] =
     { .name = "hdr-versionPTP",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_LENGTH] =
     { .name = "hdr-messageLength",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_DOMAIN_NUMBER] =
     { .name = "hdr-domainNumber",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_RESERVED1] =
     { .name = "hdr-reserved1",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_FLAG_FIELD] =
     { .name = "hdr-flagField",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CORRECTION_FIELD] =
     { .name = "hdr-correctionField",
       .help = "",
       .bit_width =   64 },
+    [PTP_HDR_FIELD_RESERVED2] =
     { .name = "hdr-reserved2",
       .help = "",
       .bit_width =   32 },
+    [PTP_HDR_FIELD_CLOCK_ID] =
     { .name = "hdr-clockId",
       .help = "",
       .bit_width =    64 },
+    [PTP_HDR_FIELD_PORT_NUMBER] =
     { .name = "hdr-portNumber",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_SEQUENCE_ID] =
     { .name = "hdr-sequenceId",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CONTROL_FIELD] =
     { .name = "hdr-controlField",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_LOG_MESSAGE_INTERVAL] =
     { .name = "hdr-logMessageInterval",
       .help = "",
       .bit_width =   8 },
@@ -381,61 +467,76 @@ static hdr_t HDR_RESPONSE = {
 
 static field_t PEER_REQUEST_FIELDS[] = {
     /* HEADER - All fields are prefixed with "hdr-" */
+    [PTP_HDR_FIELD_TRANSPORT_SPECIFIC] =
     { .name = "hdr-transportSpecific",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_TYPE] =
     { .name = "hdr-messageType",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MINOR_VERSION_PTP] =
     { .name = "hdr-minorVersionPTP",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_VERSION_PTP] =
     { .name = "hdr-versionPTP",
       .help = "",
       .bit_offset =  0,
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_LENGTH] =
     { .name = "hdr-messageLength",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_DOMAIN_NUMBER] =
     { .name = "hdr-domainNumber",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_RESERVED1] =
     { .name = "hdr-reserved1",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_FLAG_FIELD] =
     { .name = "hdr-flagField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CORRECTION_FIELD] =
     { .name = "hdr-correctionField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   64 },
+    [PTP_HDR_FIELD_RESERVED2] =
     { .name = "hdr-reserved2",
       .help = "",
       .bit_offset =  0,
       .bit_width =   32 },
+    [PTP_HDR_FIELD_CLOCK_ID] =
     { .name = "hdr-clockId",
       .help = "",
       .bit_offset =  0,
       .bit_width =    64 },
+    [PTP_HDR_FIELD_PORT_NUMBER] =
     { .name = "hdr-portNumber",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_SEQUENCE_ID] =
     { .name = "hdr-sequenceId",
       .help = "",
       .bit_offset =  0,
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CONTROL_FIELD] =
     { .name = "hdr-controlField",
       .help = "",
       .bit_offset =  0,
       .bit_width =   8 },
+    [PTP_HDR_FIELD_LOG_MESSAGE_INTERVAL] =
     { .name = "hdr-logMessageInterval",
       .help = "",
       .bit_offset =  0,
@@ -459,48 +560,63 @@ static hdr_t HDR_PEER_REQUEST = {
 
 static field_t PEER_RESPONSE_FIELDS[] = {
     /* HEADER - All fields are prefixed with "hdr-" */
+    [PTP_HDR_FIELD_TRANSPORT_SPECIFIC] =
     { .name = "hdr-transportSpecific",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_TYPE] =
     { .name = "hdr-messageType",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MINOR_VERSION_PTP] =
     { .name = "hdr-minorVersionPTP",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_VERSION_PTP] =
     { .name = "hdr-versionPTP",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_LENGTH] =
     { .name = "hdr-messageLength",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_DOMAIN_NUMBER] =
     { .name = "hdr-domainNumber",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_RESERVED1] =
     { .name = "hdr-reserved1",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_FLAG_FIELD] =
     { .name = "hdr-flagField",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CORRECTION_FIELD] =
     { .name = "hdr-correctionField",
       .help = "",
       .bit_width =   64 },
+    [PTP_HDR_FIELD_RESERVED2] =
     { .name = "hdr-reserved2",
       .help = "",
       .bit_width =   32 },
+    [PTP_HDR_FIELD_CLOCK_ID] =
     { .name = "hdr-clockId",
       .help = "",
       .bit_width =    64 },
+    [PTP_HDR_FIELD_PORT_NUMBER] =
     { .name = "hdr-portNumber",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_SEQUENCE_ID] =
     { .name = "hdr-sequenceId",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CONTROL_FIELD] =
     { .name = "hdr-controlField",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_LOG_MESSAGE_INTERVAL] =
     { .name = "hdr-logMessageInterval",
       .help = "",
       .bit_width =   8 },
@@ -534,48 +650,63 @@ static hdr_t HDR_PEER_RESPONSE = {
 
 static field_t PEER_RESPONSE_FOLLOW_UP_FIELDS[] = {
     /* HEADER - All fields are prefixed with "hdr-" */
+    [PTP_HDR_FIELD_TRANSPORT_SPECIFIC] =
     { .name = "hdr-transportSpecific",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_TYPE] =
     { .name = "hdr-messageType",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MINOR_VERSION_PTP] =
     { .name = "hdr-minorVersionPTP",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_VERSION_PTP] =
     { .name = "hdr-versionPTP",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_LENGTH] =
     { .name = "hdr-messageLength",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_DOMAIN_NUMBER] =
     { .name = "hdr-domainNumber",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_RESERVED1] =
     { .name = "hdr-reserved1",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_FLAG_FIELD] =
     { .name = "hdr-flagField",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CORRECTION_FIELD] =
     { .name = "hdr-correctionField",
       .help = "",
       .bit_width =   64 },
+    [PTP_HDR_FIELD_RESERVED2] =
     { .name = "hdr-reserved2",
       .help = "",
       .bit_width =   32 },
+    [PTP_HDR_FIELD_CLOCK_ID] =
     { .name = "hdr-clockId",
       .help = "",
       .bit_width =    64 },
+    [PTP_HDR_FIELD_PORT_NUMBER] =
     { .name = "hdr-portNumber",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_SEQUENCE_ID] =
     { .name = "hdr-sequenceId",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CONTROL_FIELD] =
     { .name = "hdr-controlField",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_LOG_MESSAGE_INTERVAL] =
     { .name = "hdr-logMessageInterval",
       .help = "",
       .bit_width =   8 },
@@ -610,48 +741,63 @@ static hdr_t HDR_PEER_RESPONSE_FOLLOW_UP = {
 
 static field_t ANNOUNCE_FIELDS[] = {
     /* HEADER - All fields are prefixed with "hdr-" */
+    [PTP_HDR_FIELD_TRANSPORT_SPECIFIC] =
     { .name = "hdr-transportSpecific",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_TYPE] =
     { .name = "hdr-messageType",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MINOR_VERSION_PTP] =
     { .name = "hdr-minorVersionPTP",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_VERSION_PTP] =
     { .name = "hdr-versionPTP",
       .help = "",
       .bit_width =   4 },
+    [PTP_HDR_FIELD_MESSAGE_LENGTH] =
     { .name = "hdr-messageLength",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_DOMAIN_NUMBER] =
     { .name = "hdr-domainNumber",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_RESERVED1] =
     { .name = "hdr-reserved1",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_FLAG_FIELD] =
     { .name = "hdr-flagField",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CORRECTION_FIELD] =
     { .name = "hdr-correctionField",
       .help = "",
       .bit_width =   64 },
+    [PTP_HDR_FIELD_RESERVED2] =
     { .name = "hdr-reserved2",
       .help = "",
       .bit_width =   32 },
+    [PTP_HDR_FIELD_CLOCK_ID] =
     { .name = "hdr-clockId",
       .help = "",
       .bit_width =    64 },
+    [PTP_HDR_FIELD_PORT_NUMBER] =
     { .name = "hdr-portNumber",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_SEQUENCE_ID] =
     { .name = "hdr-sequenceId",
       .help = "",
       .bit_width =   16 },
+    [PTP_HDR_FIELD_CONTROL_FIELD] =
     { .name = "hdr-controlField",
       .help = "",
       .bit_width =   8 },
+    [PTP_HDR_FIELD_LOG_MESSAGE_INTERVAL] =
     { .name = "hdr-logMessageInterval",
       .help = "",
       .bit_width =   8 },
@@ -703,9 +849,11 @@ static hdr_t HDR_ANNOUNCE = {
 };
 
 static field_t TLV_ORG_FIELDS[] = {
+    [PTP_TLV_FIELD_TYPE] =
     { .name = "tlv-type",
       .help = "",
       .bit_width =   16 },
+    [PTP_TLV_FIELD_LENGTH] =
     { .name = "tlv-length",
       .help = "",
       .bit_width =   16 },
@@ -746,9 +894,11 @@ static hdr_t HDR_TLV_ORG = {
 };
 
 static field_t TLV_PATH_FIELDS[] = {
+    [PTP_TLV_FIELD_TYPE] =
     { .name = "tlv-type",
       .help = "",
       .bit_width =   16 },
+    [PTP_TLV_FIELD_LENGTH] =
     { .name = "tlv-length",
       .help = "",
       .bit_width =   16 },
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ef.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+uint64_t replay_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+void replay_free(replay_t *r) {
+    if (!r)
+        return;
+
+    pcap_file_close(r->f);
+    free(r->path);
+    free(r);
+}
+
+// Parse 'replay <file> [speed [x]<factor> | pps <cnt> | asap] [loop <cnt>]'.
+// Returns the number of arguments consumed, or -1.
+int argc_replay(int argc, const char *argv[], replay_t **out) {
+    replay_t *r;
+    const char *s;
+    char *end;
+    int i = 1;
+
+    if (argc < 2) {
+        po("ERROR: replay: Missing file name\n");
+        return -1;
+    }
+
+    r = calloc(1, sizeof(*r));
+    if (!r)
+        return -1;
+
+    r->mode = REPLAY_ORIG;
+    r->speed = 1;
+    r->loop = 1;
+    r->path = strdup(argv[i++]);
+
+    while (i < argc) {
+        if (strcmp(argv[i], "asap") == 0) {
+            r->mode = REPLAY_ASAP;
+            i += 1;
+
+        } else if (i + 1 < argc && strcmp(argv[i], "speed") == 0) {
+            s = argv[i + 1];
+            if (*s == 'x')
+                s++;
+
+            r->mode = REPLAY_ORIG;
+            r->speed = strtod(s, &end);
+            if (end == s || *end || !(r->speed > 0)) {
+                po("ERROR: replay: Invalid speed: %s\n", argv[i + 1]);
+                goto ERR;
+            }
+            i += 2;
+
+        } else if (i + 1 < argc && strcmp(argv[i], "pps") == 0) {
+            r->mode = REPLAY_PPS;
+            r->pps = strtoull(argv[i + 1], &end, 0);
+            if (end == argv[i + 1] || *end || r->pps == 0) {
+                po("ERROR: replay: Invalid pps: %s\n", argv[i + 1]);
+                goto ERR;
+            }
+            i += 2;
+
+        } else if (i + 1 < argc && strcmp(argv[i], "loop") == 0) {
+            r->loop = strtoul(argv[i + 1], &end, 0);
+            if (end == argv[i + 1] || *end || r->loop == 0) {
+                po("ERROR: replay: Invalid loop count: %s\n", argv[i + 1]);
+                goto ERR;
+            }
+            i += 2;
+
+        } else {
+            break;
+        }
+    }
+
+    r->f = pcap_file_open(r->path);
+    if (!r->f)
+        goto ERR;
+
+    *out = r;
+
+    return i;
+
+ERR:
+    replay_free(r);
+    return -1;
+}
+
+// The records and bytes of one pass of the file. The file is rewound, so this
+// is only to be called before the replay is started.
+void replay_size(replay_t *r, uint64_t *frames, uint64_t *bytes) {
+    pcap_rec_t rec;
+
+    *frames = 0;
+    *bytes = 0;
+    while (pcap_file_next(r->f, &rec) > 0) {
+        (*frames)++;
+        *bytes += rec.len;
+    }
+
+    pcap_file_rewind(r->f);
+}
+
+// Load the next record and compute its deadline. Deadlines are absolute
+// (relative to the start of the replay, not to the previous frame), such
+// that the time spent sending, and the wake-up latency, does not add up.
+static void replay_fetch(replay_t *r) {
+    uint64_t ts, deadline, idx;
+    int res;
+
+    res = pcap_file_next(r->f, &r->rec);
+    while (res == 0 && ++r->pass < r->loop) {
+        // The next pass starts where the previous one ended
+        pcap_file_rewind(r->f);
+        r->pass_base = r->last;
+        r->pass_first = 1;
+        res = pcap_file_next(r->f, &r->rec);
+    }
+
+    if (res <= 0) {
+        r->err += res < 0;
+        r->done = 1;
+        return;
+    }
+
+    ts = (uint64_t)r->rec.ts.tv_sec * NSEC_PER_SEC + r->rec.ts.tv_nsec;
+    if (r->pass_first) {
+        r->pass_ts = ts;
+        r->pass_first = 0;
+    }
+
+    switch (r->mode) {
+        case REPLAY_ORIG:
+            // Records out of order are sent right away
+            deadline = r->pass_base;
+            if (ts > r->pass_ts)
+                deadline += (uint64_t)((double)(ts - r->pass_ts) / r->speed);
+            break;
+
+        case REPLAY_PPS:
+            idx = r->sent;
+            deadline = r->start + idx / r->pps * NSEC_PER_SEC +
+                       idx % r->pps * NSEC_PER_SEC / r->pps;
+            break;
+
+        default:
+            deadline = r->start;
+    }
+
+    r->deadline = deadline > r->last ? deadline : r->last;
+    r->last = r->deadline;
+    r->pending = 1;
+}
+
+// Returns the next record if it is due at #now. Otherwise NULL is returned,
+// and #wait is set to the time until the next record is due, if any.
+const pcap_rec_t *replay_next(replay_t *r, uint64_t now, uint64_t *wait) {
+    if (!r->started) {
+        r->started = 1;
+        r->start = now;
+        r->pass_base = now;
+        r->last = now;
+        r->pass_first = 1;
+    }
+
+    if (!r->pending && !r->done)
+        replay_fetch(r);
+
+    if (r->done)
+        return 0;
+
+    if (r->deadline <= now)
+        return &r->rec;
+
+    if (wait)
+        *wait = r->deadline - now;
+
+    return 0;
+}
+
+// Consume the record returned by replay_next(). Records which could not be
+// transmitted are counted in 'failed' by the caller.
+void replay_sent(replay_t *r) {
+    r->pending = 0;
+    r->sent++;
+}
@@ -0,0 +1,422 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "ef.h"
+
+#define RESULT_RECS_MAX     4096
+#define RESULT_LINE_MAX     512
+#define RESULT_OUT_BUF_SIZE (64 * 1024)
+
+// Header of the binary result stream, followed by result_rec_t records in
+// host byte order.
+#define RESULT_BIN_MAGIC    0x45465231 // "EFR1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t rec_size;
+} result_bin_hdr_t;
+
+typedef enum {
+    RESULT_FMT_JSONL,
+    RESULT_FMT_BIN,
+} result_fmt_t;
+
+// Records are added to one of two buffers by the thread running the test.
+// When it is full, it is handed to the writer thread, which formats and writes
+// it while the other buffer is filled, such that writing to the sink does not
+// stall the RX loop. Only if the writer is a full buffer behind, result_add()
+// waits for it.
+typedef struct {
+    int             fd;
+    result_fmt_t    fmt;
+    int             cur;        // The buffer being filled
+    size_t          cnt;        // Records in the buffer being filled
+    int             pending;    // The buffer handed to the writer, or -1
+    size_t          pending_cnt;
+    int             stop;
+    int             err;        // errno of a failed write, or 0
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    result_rec_t    recs[2][RESULT_RECS_MAX];
+} result_sink_t;
+
+static result_sink_t *SINK = 0;
+
+// The records of the job being served in daemon mode, see result_job_begin()
+static struct {
+    int           active;
+    size_t        cnt;
+    size_t        cap;
+    result_rec_t *recs;
+} JOB;
+
+static const char *RESULT_TYPE_NAMES[] = {
+    [RESULT_TX]     = "tx",
+    [RESULT_RX_OK]  = "rx-ok",
+    [RESULT_RX_ERR] = "rx-err",
+    [RESULT_NO_RX]  = "no-rx",
+};
+
+static const char *TS_SRC_NAMES[] = {
+    [TS_SRC_HOST] = "host",
+    [TS_SRC_SW]   = "sw",
+    [TS_SRC_HW]   = "hw",
+};
+
+const char *ts_src_name(ts_src_t src) {
+    if (src > TS_SRC_HW)
+        return "?";
+
+    return TS_SRC_NAMES[src];
+}
+
+static int write_all(int fd, const void *d, size_t len) {
+    const uint8_t *p = (const uint8_t *)d;
+    ssize_t res;
+
+    while (len) {
+        res = write(fd, p, len);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        p += res;
+        len -= res;
+    }
+
+    return 0;
+}
+
+static char *json_str(char *o, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    unsigned char c;
+
+    *o++ = '"';
+    for (; *s; s++) {
+        c = *s;
+        if (c == '"' || c == '\\') {
+            *o++ = '\\';
+            *o++ = c;
+        } else if (c < 0x20) {
+            memcpy(o, "\\u00", 4);
+            o += 4;
+            *o++ = hex[c >> 4];
+            *o++ = hex[c & 0xf];
+        } else {
+            *o++ = c;
+        }
+    }
+    *o++ = '"';
+
+    return o;
+}
+
+// Format a record as a JSON object and a newline into #o, which must have room
+// for RESULT_LINE_MAX bytes. Returns the length.
+static int result_jsonl_line(char *o, const result_rec_t *r) {
+    char *p = o;
+
+    p += sprintf(p, "{\"type\":\"%s\",\"cmd\":%d,\"if\":",
+                 RESULT_TYPE_NAMES[r->type], r->cmd_idx);
+    p = json_str(p, r->ifname);
+    p += sprintf(p, ",\"ts\":%llu.%09u,\"ts_src\":\"%s\",\"len\":%u",
+                 (unsigned long long)r->ts_sec, r->ts_nsec,
+                 ts_src_name(r->ts_src), r->frame_len);
+
+    if (r->name[0]) {
+        p += sprintf(p, ",\"name\":");
+        p = json_str(p, r->name);
+    }
+
+    p += sprintf(p, "}\n");
+
+    return p - o;
+}
+
+static int result_write_jsonl(int fd, const result_rec_t *recs, size_t cnt) {
+    char *buf;
+    size_t i, len = 0;
+    int res = 0;
+
+    buf = malloc(RESULT_OUT_BUF_SIZE);
+    if (!buf)
+        return -1;
+
+    for (i = 0; i < cnt && res == 0; ++i) {
+        if (len + RESULT_LINE_MAX > RESULT_OUT_BUF_SIZE) {
+            res = write_all(fd, buf, len);
+            len = 0;
+        }
+
+        len += result_jsonl_line(buf + len, &recs[i]);
+    }
+
+    if (res == 0 && len)
+        res = write_all(fd, buf, len);
+
+    free(buf);
+
+    return res;
+}
+
+static void *result_writer(void *arg) {
+    const result_rec_t *recs;
+    size_t cnt;
+    int res;
+
+    pthread_mutex_lock(&SINK->lock);
+    while (1) {
+        while (SINK->pending < 0 && !SINK->stop)
+            pthread_cond_wait(&SINK->cond, &SINK->lock);
+
+        if (SINK->pending < 0)
+            break;
+
+        recs = SINK->recs[SINK->pending];
+        cnt = SINK->pending_cnt;
+        pthread_mutex_unlock(&SINK->lock);
+
+        if (SINK->fmt == RESULT_FMT_BIN) {
+            res = write_all(SINK->fd, recs, cnt * sizeof(result_rec_t));
+        } else {
+            res = result_write_jsonl(SINK->fd, recs, cnt);
+        }
+
+        pthread_mutex_lock(&SINK->lock);
+        if (res < 0 && !SINK->err)
+            SINK->err = errno ? errno : EIO;
+
+        SINK->pending = -1;
+        pthread_cond_broadcast(&SINK->cond);
+    }
+    pthread_mutex_unlock(&SINK->lock);
+
+    return 0;
+}
+
+// Hand the buffer being filled to the writer, and continue in the other one
+static void result_handoff() {
+    pthread_mutex_lock(&SINK->lock);
+    while (SINK->pending >= 0)
+        pthread_cond_wait(&SINK->cond, &SINK->lock);
+
+    SINK->pending = SINK->cur;
+    SINK->pending_cnt = SINK->cnt;
+    pthread_cond_broadcast(&SINK->cond);
+    pthread_mutex_unlock(&SINK->lock);
+
+    SINK->cur ^= 1;
+    SINK->cnt = 0;
+}
+
+static void result_sink_free() {
+    pthread_cond_destroy(&SINK->cond);
+    pthread_mutex_destroy(&SINK->lock);
+    free(SINK);
+    SINK = 0;
+}
+
+// Open the result sink given as <format>:<file>, where format is 'jsonl' or
+// 'bin'. The file is truncated.
+int result_sink_open(const char *spec) {
+    result_fmt_t fmt;
+    const char *path;
+    result_bin_hdr_t hdr;
+
+    if (strncmp(spec, "jsonl:", 6) == 0) {
+        fmt = RESULT_FMT_JSONL;
+        path = spec + 6;
+    } else if (strncmp(spec, "bin:", 4) == 0) {
+        fmt = RESULT_FMT_BIN;
+        path = spec + 4;
+    } else {
+        po("ERROR: Invalid result sink: %s (expected jsonl:<file> or "
+           "bin:<file>)\n", spec);
+        return -1;
+    }
+
+    if (SINK) {
+        po("ERROR: Only one result sink is supported\n");
+        return -1;
+    }
+
+    SINK = calloc(1, sizeof(*SINK));
+    if (!SINK)
+        return -1;
+
+    SINK->fmt = fmt;
+    SINK->pending = -1;
+    pthread_mutex_init(&SINK->lock, 0);
+    pthread_cond_init(&SINK->cond, 0);
+
+    SINK->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (SINK->fd < 0) {
+        po("ERROR: Could not open %s: %m\n", path);
+        result_sink_free();
+        return -1;
+    }
+
+    if (fmt == RESULT_FMT_BIN) {
+        hdr.magic = RESULT_BIN_MAGIC;
+        hdr.rec_size = sizeof(result_rec_t);
+        if (write_all(SINK->fd, &hdr, sizeof(hdr)) < 0) {
+            po("ERROR: Could not write %s: %m\n", path);
+            close(SINK->fd);
+            result_sink_free();
+            return -1;
+        }
+    }
+
+    if (pthread_create(&SINK->thread, 0, result_writer, 0)) {
+        po("ERROR: Failed to start the result writer\n");
+        close(SINK->fd);
+        result_sink_free();
+        return -1;
+    }
+
+    return 0;
+}
+
+int result_sink_active() {
+    return SINK != 0;
+}
+
+// Record a result. This is called from the RX/TX loop, and only copies the
+// event into the record buffer - formatting and writing is done by the writer
+// thread. If ts is null, the current time is used.
+void result_add(result_type_t type, int cmd_idx, const char *ifname,
+                const struct timespec *ts, ts_src_t ts_src,
+                uint32_t frame_len, const char *name) {
+    struct timespec now;
+    result_rec_t *r, *n, rec;
+
+    if (!SINK && !JOB.active)
+        return;
+
+    if (!ts) {
+        clock_gettime(CLOCK_REALTIME, &now);
+        ts = &now;
+        ts_src = TS_SRC_HOST;
+    }
+
+    if (SINK) {
+        if (SINK->cnt == RESULT_RECS_MAX)
+            result_handoff();
+
+        r = &SINK->recs[SINK->cur][SINK->cnt++];
+    } else {
+        r = &rec;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->ts_sec = ts->tv_sec;
+    r->ts_nsec = ts->tv_nsec;
+    r->frame_len = frame_len;
+    r->cmd_idx = cmd_idx;
+    r->type = type;
+    r->ts_src = ts_src;
+
+    if (ifname)
+        strncpy(r->ifname, ifname, sizeof(r->ifname) - 1);
+
+    if (name)
+        strncpy(r->name, name, sizeof(r->name) - 1);
+
+    if (!JOB.active)
+        return;
+
+    if (JOB.cnt == JOB.cap) {
+        n = realloc(JOB.recs, (JOB.cap ? 2 * JOB.cap : 256) * sizeof(*n));
+        if (!n)
+            return;
+
+        JOB.recs = n;
+        JOB.cap = JOB.cap ? 2 * JOB.cap : 256;
+    }
+
+    JOB.recs[JOB.cnt++] = *r;
+}
+
+// Write all buffered records to the sink, and wait for them to be written
+int result_flush() {
+    int err;
+
+    if (!SINK)
+        return 0;
+
+    if (SINK->cnt)
+        result_handoff();
+
+    pthread_mutex_lock(&SINK->lock);
+    while (SINK->pending >= 0)
+        pthread_cond_wait(&SINK->cond, &SINK->lock);
+
+    err = SINK->err;
+    SINK->err = 0;
+    pthread_mutex_unlock(&SINK->lock);
+
+    if (err) {
+        errno = err;
+        pe("ERROR: Could not write results: %m\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int result_sink_close() {
+    int res;
+
+    if (!SINK)
+        return 0;
+
+    res = result_flush();
+
+    pthread_mutex_lock(&SINK->lock);
+    SINK->stop = 1;
+    pthread_cond_broadcast(&SINK->cond);
+    pthread_mutex_unlock(&SINK->lock);
+    pthread_join(SINK->thread, 0);
+
+    if (close(SINK->fd) < 0)
+        res = -1;
+
+    result_sink_free();
+
+    return res;
+}
+
+// Collect the records of a job, in addition to writing them to the sink
+void result_job_begin() {
+    JOB.active = 1;
+    JOB.cnt = 0;
+}
+
+// The records of the job so far
+const result_rec_t *result_job_recs(size_t *cnt) {
+    *cnt = JOB.cnt;
+
+    return JOB.recs;
+}
+
+// Write the records of the job as JSON lines to #fd through po()/pe()
+// buffering, such that they follow the text output of the job. With a
+// negative #fd, they are dropped.
+void result_job_end(int fd) {
+    char line[RESULT_LINE_MAX];
+    size_t i;
+    int len;
+
+    for (i = 0; i < JOB.cnt && fd >= 0; ++i) {
+        len = result_jsonl_line(line, &JOB.recs[i]);
+        out_write(fd, line, len);
+    }
+
+    JOB.active = 0;
+    JOB.cnt = 0;
+}
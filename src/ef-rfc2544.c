@@ -0,0 +1,785 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <poll.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include "ef.h"
+
+// RFC 2544 benchmark: throughput, latency, frame loss rate and back-to-back
+// frames, for each of a list of frame sizes.
+//
+// A trial sends frames paced at a rate for a fixed time (or a burst as fast as
+// possible), reads the frames received while it waits for the next send slot,
+// and counts them when the settle time (-t) has passed. Frames with room for
+// a latency signature (see ef-latency.c) are counted by the stream id of the
+// trial, such that frames of an earlier trial arriving late are not counted;
+// smaller frames are counted by comparing them with the frame sent.
+//
+// A trial in which the host could not send at the rate (the line rate for a
+// burst), or dropped frames itself, is host limited: it tells nothing about the DUT, so it stops the
+// searches and is reported as such, and the benchmark fails.
+
+#define RFC2544_SIZES_MAX 16
+
+// Preamble, SFD and inter frame gap, which count when a rate is converted to
+// frames per second
+#define L1_OVERHEAD 20
+
+// A trial is host limited if the host sent below 99% of the frame rate
+#define RATE_TOLERANCE 0.99
+
+// The frames received are read at least every RX_EVERY frames sent, also when
+// the host is behind the schedule of the rate
+#define RX_EVERY 64
+
+#ifndef MIN
+#define MIN(a, b) (a < b ? a : b)
+#endif
+
+enum {
+    RFC2544_THROUGHPUT = 1,
+    RFC2544_LATENCY    = 2,
+    RFC2544_LOSS       = 4,
+    RFC2544_B2B        = 8,
+};
+
+static const char *TEST_NAMES[] = {
+    "throughput", "latency", "loss", "b2b",
+};
+
+struct rfc2544 {
+    char     *rx_if;
+    int       tests;
+    int       sizes[RFC2544_SIZES_MAX];
+    int       size_cnt;
+    int       rate;         // Mbps, 0 for the speed of the TX link
+    int       duration_ms;
+    double    resolution;   // Percent
+    uint64_t  burst;        // Longest back-to-back burst, 0 for duration
+    int       argc;
+    char    **argv;
+    int       hdr_size;     // Of the frame, without padding
+};
+
+typedef struct {
+    int      fd_tx;
+    int      fd_rx;
+    uint32_t trial_id;
+    stats_if_t *stats_tx;
+    stats_if_t *stats_rx;
+} rfc2544_ctx_t;
+
+// A frame of one size
+typedef struct {
+    int       size;         // With FCS
+    frame_t  *frame;
+    buf_t    *buf;
+    buf_t    *rx_buf;
+    lat_tx_t  lat;
+    int       sig;          // The frame has room for a latency signature
+    double    fps_max;      // At the line rate
+} rfc2544_frame_t;
+
+// The results of one frame size
+typedef struct {
+    double   throughput;    // Percent of the line rate, -1 if not run
+    double   loss[10];      // Percent, at 100%, 90%... of the line rate, -1
+                            // if the host could not send at the rate
+    int      loss_cnt;
+    int      lat_valid;
+    uint64_t lat_min;
+    uint64_t lat_avg;
+    uint64_t lat_max;
+    uint64_t lat_p99;
+    int64_t  b2b;           // -1 if not run
+    int      host_limited;  // The tests (RFC2544_*) with host limited trials
+} rfc2544_result_t;
+
+static uint64_t rfc2544_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void rfc2544_free(rfc2544_t *r) {
+    int i;
+
+    if (!r)
+        return;
+
+    for (i = 0; i < r->argc; ++i)
+        free(r->argv[i]);
+
+    free(r->argv);
+    free(r->rx_if);
+    free(r);
+}
+
+static int parse_sizes(rfc2544_t *r, const char *s) {
+    char *end;
+    long v;
+
+    r->size_cnt = 0;
+    while (*s) {
+        v = strtol(s, &end, 0);
+        if (end == s || v < 64 || v > 9018 || (*end && *end != ',') ||
+            r->size_cnt == RFC2544_SIZES_MAX) {
+            po("ERROR: rfc2544: Invalid frame sizes: %s\n", s);
+            return -1;
+        }
+
+        r->sizes[r->size_cnt++] = v;
+        s = *end ? end + 1 : end;
+    }
+
+    return 0;
+}
+
+static int parse_tests(rfc2544_t *r, const char *s) {
+    const char *end;
+    size_t len;
+    int i;
+
+    r->tests = 0;
+    while (*s) {
+        end = strchr(s, ',');
+        len = end ? (size_t)(end - s) : strlen(s);
+
+        for (i = 0; i < 4; ++i) {
+            if (strlen(TEST_NAMES[i]) == len &&
+                strncmp(TEST_NAMES[i], s, len) == 0)
+                break;
+        }
+
+        if (i == 4) {
+            po("ERROR: rfc2544: Invalid test: %.*s\n", (int)len, s);
+            return -1;
+        }
+
+        r->tests |= 1 << i;
+        s += len + (end ? 1 : 0);
+    }
+
+    return 0;
+}
+
+// Parses '<rx-if> [<option> <val>]... FRAME' of 'rfc2544 <tx-if> ...'.
+// Returns the number of arguments consumed, or -1.
+int argc_rfc2544(int argc, const char *argv[], rfc2544_t **out) {
+    static const int SIZES[] = { 64, 128, 256, 512, 1024, 1280, 1518 };
+    frame_t *f;
+    rfc2544_t *r;
+    int i = 1, j, res;
+
+    if (argc < 1) {
+        po("ERROR: rfc2544 <tx-if> <rx-if> [options] FRAME\n");
+        return -1;
+    }
+
+    r = calloc(1, sizeof(*r));
+    if (!r)
+        return -1;
+
+    r->rx_if = strdup(argv[0]);
+    r->tests = RFC2544_THROUGHPUT | RFC2544_LATENCY | RFC2544_LOSS |
+               RFC2544_B2B;
+    r->duration_ms = 1000;
+    r->resolution = 0.5;
+    r->size_cnt = sizeof(SIZES) / sizeof(SIZES[0]);
+    memcpy(r->sizes, SIZES, sizeof(SIZES));
+
+    while (i + 1 < argc) {
+        if (strcmp(argv[i], "sizes") == 0) {
+            if (parse_sizes(r, argv[i + 1]) < 0)
+                goto ERR;
+        } else if (strcmp(argv[i], "tests") == 0) {
+            if (parse_tests(r, argv[i + 1]) < 0)
+                goto ERR;
+        } else if (strcmp(argv[i], "rate") == 0) {
+            r->rate = atoi(argv[i + 1]);
+            if (r->rate <= 0) {
+                po("ERROR: rfc2544: Invalid rate: %s\n", argv[i + 1]);
+                goto ERR;
+            }
+        } else if (strcmp(argv[i], "duration") == 0) {
+            r->duration_ms = atoi(argv[i + 1]);
+            if (r->duration_ms <= 0) {
+                po("ERROR: rfc2544: Invalid duration: %s\n", argv[i + 1]);
+                goto ERR;
+            }
+        } else if (strcmp(argv[i], "resolution") == 0) {
+            r->resolution = atof(argv[i + 1]);
+            if (r->resolution <= 0 || r->resolution >= 100) {
+                po("ERROR: rfc2544: Invalid resolution: %s\n", argv[i + 1]);
+                goto ERR;
+            }
+        } else if (strcmp(argv[i], "burst") == 0) {
+            r->burst = strtoull(argv[i + 1], 0, 0);
+            if (!isdigit((unsigned char)argv[i + 1][0]) || !r->burst) {
+                po("ERROR: rfc2544: Invalid burst: %s\n", argv[i + 1]);
+                goto ERR;
+            }
+        } else {
+            break;
+        }
+        i += 2;
+    }
+
+    // The frame ends where the frame parser stops
+    f = frame_alloc();
+    res = argc_frame(argc - i, argv + i, f);
+    if (res <= 0) {
+        po("ERROR: rfc2544: Missing or invalid frame\n");
+        frame_free(f);
+        goto ERR;
+    }
+
+    for (j = 0; j < f->stack_size; ++j)
+        r->hdr_size += f->stack[j]->size;
+    frame_free(f);
+
+    r->argv = calloc(res, sizeof(*r->argv));
+    if (!r->argv)
+        goto ERR;
+
+    for (j = 0; j < res; ++j)
+        r->argv[r->argc++] = strdup(argv[i + j]);
+
+    *out = r;
+
+    return i + res;
+
+ERR:
+    rfc2544_free(r);
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Frames
+
+// The frame, with data up to the size (minus the FCS)
+static int rfc2544_frame_init(const rfc2544_t *r, int size, int rate,
+                              rfc2544_frame_t *fr) {
+    const char **argv;
+    char cnt[16];
+    int data = size - 4 - r->hdr_size, argc = r->argc, res;
+
+    memset(fr, 0, sizeof(*fr));
+    fr->size = size;
+    fr->fps_max = rate * 1e6 / ((size + L1_OVERHEAD) * 8);
+
+    if (data < 0) {
+        pe("ERROR: rfc2544: The frame is larger than %d bytes\n", size);
+        return -1;
+    }
+
+    argv = calloc(argc + 4, sizeof(*argv));
+    if (!argv)
+        return -1;
+
+    memcpy(argv, r->argv, argc * sizeof(*argv));
+    if (data) {
+        snprintf(cnt, sizeof(cnt), "%d", data);
+        argv[argc++] = "data";
+        argv[argc++] = "pattern";
+        argv[argc++] = "cnt";
+        argv[argc++] = cnt;
+    }
+
+    fr->frame = frame_alloc();
+    res = argc_frame(argc, argv, fr->frame);
+    free(argv);
+    if (res != argc) {
+        pe("ERROR: rfc2544: Failed to build a frame of %d bytes\n", size);
+        return -1;
+    }
+
+    fr->buf = frame_to_buf(fr->frame);
+    fr->rx_buf = balloc(fr->buf->size + 64);
+    if (!fr->buf || !fr->rx_buf)
+        return -1;
+
+    fr->sig = data >= LAT_SIG_SIZE &&
+              lat_tx_prepare(&fr->lat, fr->frame, fr->buf) == 0;
+
+    return 0;
+}
+
+static void rfc2544_frame_uninit(rfc2544_frame_t *fr) {
+    if (fr->frame)
+        frame_free(fr->frame);
+
+    bfree(fr->buf);
+    bfree(fr->rx_buf);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Trials
+
+static void rfc2544_rx(rfc2544_ctx_t *c, rfc2544_frame_t *fr,
+                       rfc2544_trial_t *t) {
+    struct timespec ts;
+    buf_t *b = fr->rx_buf;
+    int res;
+
+    while (1) {
+        b->size = fr->buf->size + 64;
+        res = rx_frame_recv_ts(c->fd_rx, b, 0, 0, &ts, MSG_DONTWAIT);
+        if (res <= 0)
+            return;
+
+        STATS_ADD(c->stats_rx, rx_frames, 1);
+        STATS_ADD(c->stats_rx, rx_bytes, res);
+
+        if (fr->sig) {
+            lat_rx_frame(t->lat, b, &ts);
+        } else if (b->size == fr->buf->size &&
+                   memcmp(b->data, fr->buf->data, b->size) == 0) {
+            t->received++;
+        }
+    }
+}
+
+// Send #cnt frames at #fps frames per second (0 for as fast as possible), and
+// count the frames received.
+static int rfc2544_trial(rfc2544_ctx_t *c, rfc2544_frame_t *fr, double fps,
+                         uint64_t cnt, rfc2544_trial_t *t) {
+    struct tpacket_stats st;
+    uint64_t i, t0, now, last = 0, deadline;
+    double interval = fps > 0 ? 1e9 / fps : 0;
+    struct pollfd pfd = { .fd = c->fd_rx, .events = POLLIN };
+    const seq_win_t *s;
+    int res, j;
+
+    memset(t, 0, sizeof(*t));
+    if (fr->sig) {
+        t->lat = lat_rx_new();
+        if (!t->lat)
+            return -1;
+
+        fr->lat.stream = ++c->trial_id;
+        fr->lat.seq = 0;
+    }
+
+    // Frames of an earlier trial, and their drops, do not count
+    rfc2544_rx(c, fr, t);
+    t->received = 0;
+    raw_socket_drops(c->fd_rx, &st);
+
+    t0 = rfc2544_now();
+    for (i = 0; i < cnt;) {
+        if (interval) {
+            now = rfc2544_now();
+            if (now < t0 + (uint64_t)(i * interval)) {
+                rfc2544_rx(c, fr, t);
+                continue;
+            }
+        }
+
+        if (i % RX_EVERY == 0)
+            rfc2544_rx(c, fr, t);
+
+        if (fr->sig)
+            lat_tx_stamp(&fr->lat, fr->buf);
+
+        res = send(c->fd_tx, fr->buf->data, fr->buf->size, 0);
+        TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+        if ((size_t)res == fr->buf->size) {
+            t->sent++;
+            STATS_ADD(c->stats_tx, tx_frames, 1);
+            STATS_ADD(c->stats_tx, tx_bytes, res);
+        } else {
+            t->tx_err++;
+            STATS_ADD(c->stats_tx, tx_drop, 1);
+            if (fr->sig)
+                fr->lat.seq--;
+        }
+        i++;
+    }
+    last = rfc2544_now();
+
+    if (t->sent > 1 && last > t0)
+        t->fps = (t->sent - 1) * 1e9 / (last - t0);
+
+    // Wait for the frames in flight
+    deadline = last + TIME_OUT_MS * 1000000ULL;
+    while ((now = rfc2544_now()) < deadline) {
+        rfc2544_rx(c, fr, t);
+        poll(&pfd, 1, (deadline - now) / 1000000 + 1);
+    }
+    rfc2544_rx(c, fr, t);
+
+    if (raw_socket_drops(c->fd_rx, &st) == 0)
+        t->host_drops = st.tp_drops;
+
+    // Duplicates do not make up for lost frames
+    if (fr->sig) {
+        for (j = 0; j < t->lat->cnt; ++j) {
+            s = &t->lat->streams[j]->seq;
+            if (t->lat->streams[j]->id == fr->lat.stream)
+                t->received = s->frames - s->duplicates - s->late;
+        }
+    }
+
+    // A burst is sent at the line rate
+    t->res = rfc2544_trial_res(t, fps ? fps : fr->fps_max, cnt);
+
+    return 0;
+}
+
+// The result of a trial of #cnt frames, which were to be sent at #fps frames
+// per second
+rfc2544_res_t rfc2544_trial_res(const rfc2544_trial_t *t, double fps,
+                                uint64_t cnt) {
+    if (t->sent < cnt || t->host_drops ||
+        (t->sent > 1 && t->fps < fps * RATE_TOLERANCE))
+        return RFC2544_HOST_LIMITED;
+
+    return t->received >= t->sent ? RFC2544_PASS : RFC2544_FAIL;
+}
+
+static void rfc2544_trial_free(rfc2544_trial_t *t) {
+    lat_rx_free(t->lat);
+    t->lat = 0;
+}
+
+static void rfc2544_trial_print(const char *test, rfc2544_frame_t *fr,
+                                double pct, const rfc2544_trial_t *t) {
+    po("RFC2544 %-10s: size %4d, ", test, fr->size);
+    if (pct >= 0)
+        po("rate %7.3f%%, ", pct);
+    po("sent %" PRIu64 ", received %" PRIu64 ", loss %.3f%%",
+       t->sent, t->received,
+       t->sent ? (t->sent - MIN(t->received, t->sent)) * 100.0 / t->sent : 0);
+
+    if (t->sent > 1 &&
+        t->fps < fr->fps_max * (pct >= 0 ? pct : 100) / 100 * RATE_TOLERANCE)
+        po(", the host sent only %.0f fps", t->fps);
+    if (t->tx_err)
+        po(", %" PRIu64 " send errors", t->tx_err);
+    if (t->host_drops)
+        po(", the host dropped %" PRIu64, t->host_drops);
+
+    if (t->res == RFC2544_FAIL)
+        po(" (fail)");
+    else if (t->res == RFC2544_HOST_LIMITED)
+        po(" (host-limited)");
+    po("\n");
+}
+
+static uint64_t trial_cnt(const rfc2544_t *r, double fps) {
+    uint64_t cnt = fps * r->duration_ms / 1000;
+
+    return cnt ? cnt : 1;
+}
+
+// Trial at #pct percent of the line rate
+static int rfc2544_rate(const rfc2544_t *r, rfc2544_ctx_t *c,
+                        rfc2544_frame_t *fr, const char *test, double pct,
+                        rfc2544_trial_t *t) {
+    double fps = fr->fps_max * pct / 100;
+
+    if (rfc2544_trial(c, fr, fps, trial_cnt(r, fps), t) < 0)
+        return -1;
+
+    rfc2544_trial_print(test, fr, pct, t);
+
+    return 0;
+}
+
+// Account the result of the trial at s->cur. Returns 1 if the search goes on
+// at the new s->cur, or 0 when it is done. A host limited trial ends the
+// search, as a lower #hi would not be a limit of the DUT.
+int rfc2544_search_next(rfc2544_search_t *s, rfc2544_res_t res) {
+    if (res == RFC2544_HOST_LIMITED) {
+        s->host_limited = 1;
+        return 0;
+    }
+
+    if (res == RFC2544_PASS)
+        s->lo = s->cur;
+    else
+        s->hi = s->cur;
+
+    if (s->hi - s->lo <= s->step)
+        return 0;
+
+    s->cur = (s->lo + s->hi) / 2;
+    if (s->whole)
+        s->cur = (uint64_t)s->cur;
+
+    return 1;
+}
+
+// Binary search of the highest rate without loss
+static int rfc2544_throughput(const rfc2544_t *r, rfc2544_ctx_t *c,
+                              rfc2544_frame_t *fr, rfc2544_result_t *res) {
+    rfc2544_search_t s = { .hi = 100, .cur = 100, .step = r->resolution };
+    rfc2544_trial_t t;
+    int more;
+
+    do {
+        if (rfc2544_rate(r, c, fr, "throughput", s.cur, &t) < 0)
+            return -1;
+
+        more = rfc2544_search_next(&s, t.res);
+        rfc2544_trial_free(&t);
+    } while (more);
+
+    res->throughput = s.lo;
+    if (s.host_limited)
+        res->host_limited |= RFC2544_THROUGHPUT;
+
+    return 0;
+}
+
+// Latency at the throughput rate
+static int rfc2544_latency(const rfc2544_t *r, rfc2544_ctx_t *c,
+                           rfc2544_frame_t *fr, rfc2544_result_t *res) {
+    rfc2544_trial_t t;
+    lat_stream_t *s = 0;
+    int i;
+
+    if (!fr->sig) {
+        po("RFC2544 %-10s: size %4d, no room for a latency signature\n",
+           "latency", fr->size);
+        return 0;
+    }
+
+    if (res->throughput <= 0 || (res->host_limited & RFC2544_THROUGHPUT)) {
+        po("RFC2544 %-10s: size %4d, no throughput to measure at\n",
+           "latency", fr->size);
+        return 0;
+    }
+
+    if (rfc2544_rate(r, c, fr, "latency", res->throughput, &t) < 0)
+        return -1;
+
+    if (t.res == RFC2544_HOST_LIMITED) {
+        res->host_limited |= RFC2544_LATENCY;
+        rfc2544_trial_free(&t);
+        return 0;
+    }
+
+    for (i = 0; i < t.lat->cnt; ++i) {
+        if (t.lat->streams[i]->id == fr->lat.stream)
+            s = t.lat->streams[i];
+    }
+
+    if (s && s->lat.cnt) {
+        res->lat_valid = 1;
+        res->lat_min = s->lat.min;
+        res->lat_avg = s->lat.sum / s->lat.cnt;
+        res->lat_max = s->lat.max;
+        res->lat_p99 = lat_hist_percentile(&s->lat, 99);
+    }
+
+    rfc2544_trial_free(&t);
+
+    return 0;
+}
+
+// Frame loss rate from 100% of the line rate, in steps of 10%, until two
+// trials in a row have no loss
+static int rfc2544_loss(const rfc2544_t *r, rfc2544_ctx_t *c,
+                        rfc2544_frame_t *fr, rfc2544_result_t *res) {
+    rfc2544_trial_t t;
+    int i, ok = 0;
+
+    for (i = 0; i < 10 && ok < 2; ++i) {
+        if (rfc2544_rate(r, c, fr, "loss", 100 - i * 10, &t) < 0)
+            return -1;
+
+        if (t.res == RFC2544_HOST_LIMITED) {
+            res->loss[res->loss_cnt++] = -1;
+            res->host_limited |= RFC2544_LOSS;
+        } else {
+            res->loss[res->loss_cnt++] = t.sent ?
+                (t.sent - MIN(t.received, t.sent)) * 100.0 / t.sent : 100;
+        }
+
+        ok = t.res == RFC2544_PASS ? ok + 1 : 0;
+        rfc2544_trial_free(&t);
+    }
+
+    return 0;
+}
+
+// Binary search of the longest burst at the line rate without loss
+static int rfc2544_b2b(const rfc2544_t *r, rfc2544_ctx_t *c,
+                       rfc2544_frame_t *fr, rfc2544_result_t *res) {
+    rfc2544_search_t s = { .whole = 1 };
+    rfc2544_trial_t t;
+    int more;
+
+    s.hi = s.cur = r->burst ? r->burst : trial_cnt(r, fr->fps_max);
+    s.step = (uint64_t)(s.hi * r->resolution / 100);
+    if (s.step < 1)
+        s.step = 1;
+
+    do {
+        if (rfc2544_trial(c, fr, 0, s.cur, &t) < 0)
+            return -1;
+
+        rfc2544_trial_print("b2b", fr, -1, &t);
+        more = rfc2544_search_next(&s, t.res);
+        rfc2544_trial_free(&t);
+    } while (more);
+
+    res->b2b = s.lo;
+    if (s.host_limited)
+        res->host_limited |= RFC2544_B2B;
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Print the table of the results. Returns the number of frame sizes with host
+// limited trials.
+static int rfc2544_report(const rfc2544_t *r, const char *tx_if, int rate,
+                          rfc2544_result_t *res) {
+    double fps;
+    int i, j, host_limited = 0;
+
+    po("RFC2544 RESULTS %s -> %s, %d Mbps, trials of %d ms\n", tx_if,
+       r->rx_if, rate, r->duration_ms);
+    po("RFC2544 %5s %11s %10s %10s %9s %9s %9s %9s %10s\n", "size",
+       "throughput", "fps", "Mbps", "lat-min", "lat-avg", "lat-max",
+       "lat-p99", "b2b");
+
+    for (i = 0; i < r->size_cnt; ++i) {
+        po("RFC2544 %5d ", r->sizes[i]);
+        if (res[i].throughput >= 0) {
+            fps = rate * 1e6 / ((r->sizes[i] + L1_OVERHEAD) * 8) *
+                  res[i].throughput / 100;
+            po("%10.3f%% %10.0f %10.3f ", res[i].throughput, fps,
+               fps * r->sizes[i] * 8 / 1e6);
+        } else {
+            po("%11s %10s %10s ", "-", "-", "-");
+        }
+
+        if (res[i].lat_valid) {
+            po("%9.3f %9.3f %9.3f %9.3f ", res[i].lat_min / 1e3,
+               res[i].lat_avg / 1e3, res[i].lat_max / 1e3,
+               res[i].lat_p99 / 1e3);
+        } else {
+            po("%9s %9s %9s %9s ", "-", "-", "-", "-");
+        }
+
+        if (res[i].b2b >= 0)
+            po("%10" PRId64, res[i].b2b);
+        else
+            po("%10s", "-");
+
+        if (res[i].host_limited) {
+            po(" host-limited:");
+            for (j = 0; j < 4; ++j) {
+                if (res[i].host_limited & 1 << j)
+                    po(" %s", TEST_NAMES[j]);
+            }
+            host_limited++;
+        }
+        po("\n");
+    }
+
+    for (i = 0; i < r->size_cnt; ++i) {
+        if (!res[i].loss_cnt)
+            continue;
+
+        po("RFC2544 LOSS  %5d:", r->sizes[i]);
+        for (j = 0; j < res[i].loss_cnt; ++j) {
+            po(" %d%% ", 100 - j * 10);
+            if (res[i].loss[j] < 0)
+                po("host-limited");
+            else
+                po("%.3f%%", res[i].loss[j]);
+            po("%s", j + 1 < res[i].loss_cnt ? "," : "");
+        }
+        po("\n");
+    }
+
+    po("RFC2544 (Mbps is the layer 2 rate of the frames, latency in us)\n");
+    if (host_limited)
+        po("RFC2544 (host-limited: the host could not keep up in a trial of "
+           "the test, its result is a lower bound or missing)\n");
+
+    return host_limited;
+}
+
+int rfc2544_run(rfc2544_t *r, const char *tx_if) {
+    rfc2544_result_t res[RFC2544_SIZES_MAX];
+    rfc2544_ctx_t c = { .fd_tx = -1, .fd_rx = -1 };
+    rfc2544_frame_t fr;
+    int i, rate = r->rate, err = 0;
+
+    if (!rate) {
+        rate = link_speed_get(tx_if);
+        if (rate <= 0) {
+            pe("ERROR: rfc2544: The speed of %s is unknown, use 'rate "
+               "<mbps>'\n", tx_if);
+            return -1;
+        }
+    }
+
+    c.fd_tx = raw_socket(tx_if);
+    c.fd_rx = raw_socket(r->rx_if);
+    if (c.fd_tx < 0 || c.fd_rx < 0) {
+        err = -1;
+        goto OUT;
+    }
+
+    // A burst is queued while it is sent
+    raw_socket_rcvbuf(c.fd_rx, RCVBUF_MAX);
+
+#ifdef PACKET_IGNORE_OUTGOING
+    // The frames sent do not count, if the DUT loops them back on the port
+    i = 1;
+    setsockopt(c.fd_rx, SOL_PACKET, PACKET_IGNORE_OUTGOING, &i, sizeof(i));
+    TIMING_CNT(TIMING_CNT_SYSCALL, 1);
+#endif
+    c.stats_tx = stats_if_get(tx_if);
+    c.stats_rx = stats_if_get(r->rx_if);
+
+    for (i = 0; i < r->size_cnt; ++i) {
+        memset(&res[i], 0, sizeof(res[i]));
+        res[i].throughput = -1;
+        res[i].b2b = -1;
+
+        if (rfc2544_frame_init(r, r->sizes[i], rate, &fr) < 0) {
+            rfc2544_frame_uninit(&fr);
+            err = -1;
+            goto OUT;
+        }
+
+        if (((r->tests & (RFC2544_THROUGHPUT | RFC2544_LATENCY)) &&
+             rfc2544_throughput(r, &c, &fr, &res[i]) < 0) ||
+            ((r->tests & RFC2544_LATENCY) &&
+             rfc2544_latency(r, &c, &fr, &res[i]) < 0) ||
+            ((r->tests & RFC2544_LOSS) &&
+             rfc2544_loss(r, &c, &fr, &res[i]) < 0) ||
+            ((r->tests & RFC2544_B2B) &&
+             rfc2544_b2b(r, &c, &fr, &res[i]) < 0))
+            err = -1;
+
+        rfc2544_frame_uninit(&fr);
+        if (err)
+            goto OUT;
+    }
+
+    if (rfc2544_report(r, tx_if, rate, res)) {
+        pe("ERROR: rfc2544: The host limited the results\n");
+        err = -1;
+    }
+
+OUT:
+    if (c.fd_tx >= 0)
+        close(c.fd_tx);
+    if (c.fd_rx >= 0)
+        close(c.fd_rx);
+
+    return err;
+}
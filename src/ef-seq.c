@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include "ef.h"
+
+// Sequence number tracking with a sliding bitmap window. The window holds a
+// bit for each of the last SEQ_WIN_BITS sequence numbers before w->next (the
+// highest received + 1), so the memory used is the same for a stream of ten
+// frames and a stream of billions.
+//
+// A sequence number below w->next is reordered, if it is not yet in the
+// bitmap, or a duplicate, if it is. A sequence number which leaves the window
+// without having been received is lost, and if it arrives later anyway, it is
+// late instead.
+
+#define SEQ_IDX(s)  ((s) % SEQ_WIN_BITS / 64)
+#define SEQ_BIT(s)  (1ULL << ((s) % 64))
+
+static int seq_win_test(const seq_win_t *w, uint64_t s) {
+    return !!(w->bits[SEQ_IDX(s)] & SEQ_BIT(s));
+}
+
+void seq_win_start(seq_win_t *w, uint64_t first) {
+    memset(w, 0, sizeof(*w));
+    w->started = 1;
+    w->first = first;
+    w->next = first;
+}
+
+// The sequence numbers in the window which have not been received
+static uint64_t seq_win_holes(const seq_win_t *w) {
+    uint64_t s, holes = 0;
+
+    s = w->next - w->first > SEQ_WIN_BITS ? w->next - SEQ_WIN_BITS : w->first;
+    for (; s < w->next; ++s) {
+        if (!seq_win_test(w, s))
+            holes++;
+    }
+
+    return holes;
+}
+
+// Slide the window up to #to
+static void seq_win_advance(seq_win_t *w, uint64_t to) {
+    uint64_t s;
+
+    if (to - w->next >= SEQ_WIN_BITS) {
+        w->lost += seq_win_holes(w) + to - SEQ_WIN_BITS - w->next;
+        memset(w->bits, 0, sizeof(w->bits));
+        w->next = to;
+        return;
+    }
+
+    for (s = w->next; s < to; ++s) {
+        if (s - w->first >= SEQ_WIN_BITS && !seq_win_test(w, s))
+            w->lost++;
+
+        w->bits[SEQ_IDX(s)] &= ~SEQ_BIT(s);
+    }
+
+    w->next = to;
+}
+
+void seq_win_add(seq_win_t *w, uint64_t s) {
+    if (!w->started)
+        seq_win_start(w, s);
+
+    w->frames++;
+
+    if (s >= w->next) {
+        seq_win_advance(w, s + 1);
+        w->bits[SEQ_IDX(s)] |= SEQ_BIT(s);
+        return;
+    }
+
+    if (s < w->first) {
+        w->late++;
+        return;
+    }
+
+    // Counted as lost when it left the window, unless it is a duplicate of
+    // one received in time, which can no longer be told
+    if (w->next - s > SEQ_WIN_BITS) {
+        w->late++;
+        if (w->lost)
+            w->lost--;
+        return;
+    }
+
+    if (seq_win_test(w, s)) {
+        w->duplicates++;
+        return;
+    }
+
+    w->bits[SEQ_IDX(s)] |= SEQ_BIT(s);
+    w->reordered++;
+    if (w->next - 1 - s > w->reorder_max)
+        w->reorder_max = w->next - 1 - s;
+}
+
+// Add a sequence number of #bits bits, which wraps around
+void seq_win_add_wrap(seq_win_t *w, uint64_t v, int bits) {
+    uint64_t mask = bits < 64 ? (1ULL << bits) - 1 : ~0ULL, d;
+
+    if (!w->started || bits >= 64) {
+        seq_win_add(w, v);
+        return;
+    }
+
+    // Closest to the last one received, in either direction
+    d = (v - w->next) & mask;
+    if (d <= mask / 2) {
+        seq_win_add(w, w->next + d);
+    } else if (mask + 1 - d <= w->next) {
+        seq_win_add(w, w->next - (mask + 1 - d));
+    } else {
+        w->frames++;
+        w->late++;
+    }
+}
+
+// Close the window. The sequence numbers up to #end (the next one which would
+// have been sent, or 0 if unknown) which have not been received are lost.
+void seq_win_end(seq_win_t *w, uint64_t end) {
+    if (!w->started)
+        return;
+
+    if (end > w->next)
+        seq_win_advance(w, end);
+
+    w->lost += seq_win_holes(w);
+    memset(w->bits, 0, sizeof(w->bits));
+    w->first = w->next;
+}
+
+// Print the counters of a closed window. Returns the number of errors.
+int seq_win_report(const seq_win_t *w, const char *ifname, const char *what) {
+    if (!w->lost && !w->duplicates && !w->late) {
+        po("SEQ    %16s: %s: %" PRIu64 " frames, %" PRIu64 " reordered "
+           "(max distance %" PRIu64 ")\n", ifname, what, w->frames,
+           w->reordered, w->reorder_max);
+        return 0;
+    }
+
+    pe("SEQ-ERR %15s: %s: %" PRIu64 " frames, %" PRIu64 " lost, %" PRIu64
+       " reordered (max distance %" PRIu64 "), %" PRIu64 " duplicates, %"
+       PRIu64 " late\n", ifname, what, w->frames, w->lost, w->reordered,
+       w->reorder_max, w->duplicates, w->late);
+
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// 'rx <if> seq ...', sequence numbers of frames sent by others
+
+static const char *SEQ_SRC_NAMES[] = {
+    [SEQ_SRC_RTAG]   = "rtag",
+    [SEQ_SRC_HTAG]   = "htag",
+    [SEQ_SRC_OFFSET] = "offset",
+};
+
+// Parses 'seq (rtag | htag | offset <offset> [bytes <cnt>])'. Returns the
+// number of arguments consumed, or -1.
+int argc_seq(int argc, const char *argv[], seq_rx_t **seq) {
+    seq_rx_t *r;
+    char *end;
+    int i = 1;
+
+    if (argc < 2) {
+        po("ERROR: seq rtag|htag|offset <offset> [bytes <cnt>]\n");
+        return -1;
+    }
+
+    r = calloc(1, sizeof(*r));
+    if (!r)
+        return -1;
+
+    if (strcmp(argv[i], "rtag") == 0) {
+        r->src = SEQ_SRC_RTAG;
+        r->bytes = 2;
+        i++;
+    } else if (strcmp(argv[i], "htag") == 0) {
+        r->src = SEQ_SRC_HTAG;
+        r->bytes = 2;
+        i++;
+    } else if (strcmp(argv[i], "offset") == 0 && i + 1 < argc &&
+               isdigit((unsigned char)argv[i + 1][0])) {
+        r->src = SEQ_SRC_OFFSET;
+        r->offset = strtoul(argv[i + 1], &end, 0);
+        r->bytes = 2;
+        if (*end) {
+            po("ERROR: Invalid offset: %s\n", argv[i + 1]);
+            free(r);
+            return -1;
+        }
+        i += 2;
+
+        if (i + 1 < argc && strcmp(argv[i], "bytes") == 0) {
+            r->bytes = atoi(argv[i + 1]);
+            if (r->bytes != 1 && r->bytes != 2 && r->bytes != 4 &&
+                r->bytes != 8) {
+                po("ERROR: The sequence number must be 1, 2, 4 or 8 bytes\n");
+                free(r);
+                return -1;
+            }
+            i += 2;
+        }
+    } else {
+        po("ERROR: Invalid sequence number source: %s\n", argv[i]);
+        free(r);
+        return -1;
+    }
+
+    *seq = r;
+
+    return i;
+}
+
+// Find the sequence number of a frame. Returns -1 if it has none.
+static int seq_rx_offset(const seq_rx_t *r, const buf_t *b) {
+    int o = 12;
+    uint16_t et;
+
+    if (r->src == SEQ_SRC_OFFSET)
+        return r->offset + r->bytes <= (int)b->size ? r->offset : -1;
+
+    // The tag may follow VLAN tags
+    while (o + 6 <= (int)b->size) {
+        et = b->data[o] << 8 | b->data[o + 1];
+        if (et == 0x8100 || et == 0x88a8) {
+            o += 4;
+            continue;
+        }
+
+        if ((r->src == SEQ_SRC_RTAG && et == 0xf1c1) ||
+            (r->src == SEQ_SRC_HTAG && et == 0x892f))
+            return o + 4;
+
+        break;
+    }
+
+    return -1;
+}
+
+// Account a received frame, if it has a sequence number. Returns 1 if it had.
+int seq_rx_frame(seq_rx_t *r, const buf_t *b) {
+    uint64_t v = 0;
+    int i, o = seq_rx_offset(r, b);
+
+    if (o < 0)
+        return 0;
+
+    for (i = 0; i < r->bytes; ++i)
+        v = v << 8 | b->data[o + i];
+
+    seq_win_add_wrap(&r->win, v, r->bytes * 8);
+
+    return 1;
+}
+
+int seq_rx_report(seq_rx_t *r, const char *ifname) {
+    if (!r->win.started) {
+        pe("SEQ-ERR %15s: %s: no frames with a sequence number\n", ifname,
+           SEQ_SRC_NAMES[r->src]);
+        return 1;
+    }
+
+    seq_win_end(&r->win, 0);
+
+    return seq_win_report(&r->win, ifname, SEQ_SRC_NAMES[r->src]);
+}
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include "ef.h"
+
+#define STATS_IF_MAX 64
+
+// The counters of the previous print, to compute the rates
+typedef struct {
+    uint64_t tx_frames;
+    uint64_t tx_bytes;
+    uint64_t rx_frames;
+    uint64_t rx_bytes;
+} stats_last_t;
+
+static stats_if_t IFS[STATS_IF_MAX];
+static stats_last_t LAST[STATS_IF_MAX];
+static int IFS_CNT;
+
+static int INTERVAL_MS;
+static int ENABLED;
+static int RUNNING;
+static int STOP;
+static pthread_t THREAD;
+static pthread_mutex_t LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t COND;
+
+static uint64_t stats_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+
+// Print a line per interface. The output is written directly to stderr, as
+// the buffered po()/pe() output belongs to the thread running the test.
+static void stats_print(uint64_t ns) {
+    char line[256];
+    stats_last_t now;
+    stats_if_t *s;
+    double sec = ns / 1e9;
+    int i, len, cnt = __atomic_load_n(&IFS_CNT, __ATOMIC_ACQUIRE);
+
+    for (i = 0; i < cnt; ++i) {
+        s = &IFS[i];
+        now.tx_frames = LOAD(s->tx_frames);
+        now.tx_bytes = LOAD(s->tx_bytes);
+        now.rx_frames = LOAD(s->rx_frames);
+        now.rx_bytes = LOAD(s->rx_bytes);
+
+        len = snprintf(line, sizeof(line),
+                       "STATS  %16s: tx %.0f pps %.3f Mbps, rx %.0f pps "
+                       "%.3f Mbps, match %" PRIu64 ", unexpected %" PRIu64
+                       ", drop %" PRIu64 "\n", s->name,
+                       (now.tx_frames - LAST[i].tx_frames) / sec,
+                       (now.tx_bytes - LAST[i].tx_bytes) * 8 / sec / 1e6,
+                       (now.rx_frames - LAST[i].rx_frames) / sec,
+                       (now.rx_bytes - LAST[i].rx_bytes) * 8 / sec / 1e6,
+                       LOAD(s->rx_match), LOAD(s->rx_unexpected),
+                       LOAD(s->tx_drop));
+        LAST[i] = now;
+
+        if (len > (int)sizeof(line))
+            len = sizeof(line);
+        if (write(STDERR_FILENO, line, len) < 0)
+            return;
+    }
+}
+
+static void *stats_thread(void *arg) {
+    uint64_t deadline, last = stats_now(), now;
+    struct timespec ts;
+    int stop = 0;
+
+    deadline = last;
+    while (!stop) {
+        deadline += INTERVAL_MS * 1000000ULL;
+        ts.tv_sec = deadline / 1000000000ULL;
+        ts.tv_nsec = deadline % 1000000000ULL;
+
+        pthread_mutex_lock(&LOCK);
+        while (!STOP &&
+               pthread_cond_timedwait(&COND, &LOCK, &ts) != ETIMEDOUT)
+            ;
+        stop = STOP;
+        pthread_mutex_unlock(&LOCK);
+
+        now = stats_now();
+        if (now > last)
+            stats_print(now - last);
+        last = now;
+    }
+
+    return 0;
+}
+
+// Count per interface, for a caller which reads the counters itself (see
+// stats_if_get()). stats_start() also prints them.
+void stats_enable() {
+    ENABLED = 1;
+}
+
+int stats_start(int interval_ms) {
+    pthread_condattr_t attr;
+
+    if (RUNNING)
+        return 0;
+
+    if (interval_ms <= 0) {
+        pe("ERROR: Invalid stats interval\n");
+        return -1;
+    }
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&COND, &attr);
+    pthread_condattr_destroy(&attr);
+
+    INTERVAL_MS = interval_ms;
+    STOP = 0;
+    if (pthread_create(&THREAD, 0, stats_thread, 0) != 0) {
+        pe("ERROR: Failed to start the stats thread\n");
+        return -1;
+    }
+    RUNNING = 1;
+    ENABLED = 1;
+
+    return 0;
+}
+
+// Stops the thread, which prints the last (partial) interval
+void stats_stop() {
+    ENABLED = 0;
+    if (!RUNNING)
+        return;
+
+    pthread_mutex_lock(&LOCK);
+    STOP = 1;
+    pthread_cond_signal(&COND);
+    pthread_mutex_unlock(&LOCK);
+
+    pthread_join(THREAD, 0);
+    pthread_cond_destroy(&COND);
+    RUNNING = 0;
+}
+
+stats_if_t *stats_if_get(const char *name) {
+    stats_if_t *s;
+    int i;
+
+    if (!ENABLED || !name)
+        return 0;
+
+    // Only the thread running the tests adds interfaces
+    for (i = 0; i < IFS_CNT; ++i) {
+        if (strcmp(IFS[i].name, name) == 0)
+            return &IFS[i];
+    }
+
+    if (IFS_CNT >= STATS_IF_MAX)
+        return 0;
+
+    s = &IFS[IFS_CNT];
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    __atomic_store_n(&IFS_CNT, IFS_CNT + 1, __ATOMIC_RELEASE);
+
+    return s;
+}
@@ -2,6 +2,22 @@
 #include <stdio.h>
 #include "ef.h"
 
+enum {
+    SV_FIELD_PATH,
+    SV_FIELD_VER,
+    SV_FIELD_SEQN,
+    SV_FIELD_TLV1_TYPE,
+    SV_FIELD_TLV1_LEN,
+    SV_FIELD_TLV1_MAC,
+    SV_FIELD_TLV2_TYPE,
+    SV_FIELD_TLV2_LEN,
+    SV_FIELD_TLV2_MAC,
+    SV_FIELD_TLV0_TYPE,
+    SV_FIELD_TLV0_LEN,
+
+    SV_FIELD_LAST
+};
+
 // This file provides handles to create PRP and HSR Supervision frames.
 // PRP and HSR and the accompanying supervision frames are defined in the
 // IEC 62439-3 standard.
@@ -11,12 +27,13 @@ static int sv_fill_defaults(struct frame *f, int stack_idx) {
     size_t     i;
     hdr_t      *h = f->stack[stack_idx];
     field_t    *fld;
-    const char *tlv2_fields[]  = {"tlv2_type", "tlv2_len", "tlv2_mac"};
+    const int   tlv2_fields[]  = {SV_FIELD_TLV2_TYPE, SV_FIELD_TLV2_LEN,
+                                  SV_FIELD_TLV2_MAC};
 
     // If none of the tlv2_fields are present, we adjust the size to 8 bytes
     // less.
     for (i = 0; i < sizeof(tlv2_fields) / sizeof(tlv2_fields[0]); i++) {
-        fld = find_field(h, tlv2_fields[i]);
+        fld = &h->fields[tlv2_fields[i]];
         if (fld->val) {
             found = 1;
             break;
@@ -28,7 +45,7 @@ static int sv_fill_defaults(struct frame *f, int stack_idx) {
 
         // Also adjust the bit-widths to 0
         for (i = 0; i < sizeof(tlv2_fields) / sizeof(tlv2_fields[0]); i++) {
-            fld = find_field(h, tlv2_fields[i]);
+            fld = &h->fields[tlv2_fields[i]];
             fld->bit_width = 0;
         }
     }
@@ -37,36 +54,47 @@ static int sv_fill_defaults(struct frame *f, int stack_idx) {
 }
 
 static field_t SV_FIELDS[] = {
+    [SV_FIELD_PATH] =
     { .name = "path",
       .help = "SupPath (0)",
       .bit_width = 4},
+    [SV_FIELD_VER] =
     { .name = "ver",
       .help = "SupVersion (1)",
       .bit_width = 12},
+    [SV_FIELD_SEQN] =
     { .name = "seqn",
       .help = "Sequence Number",
       .bit_width = 16},
+    [SV_FIELD_TLV1_TYPE] =
     { .name = "tlv1_type",
       .help = "TLV1.Type (20 = PRP-DD, 21 = PRP-DA, 23 = HSR)",
       .bit_width = 8},
+    [SV_FIELD_TLV1_LEN] =
     { .name = "tlv1_len",
       .help = "TLV1.Length (6)",
       .bit_width = 8},
+    [SV_FIELD_TLV1_MAC] =
     { .name = "tlv1_mac",
       .help = "TLV1.MacAddress (MAC of DANP/DANH)",
       .bit_width = 48},
+    [SV_FIELD_TLV2_TYPE] =
     { .name = "tlv2_type",
       .help = "TLV2.Type (30). Don't specify if not a RedBox SV frame",
       .bit_width = 8},
+    [SV_FIELD_TLV2_LEN] =
     { .name = "tlv2_len",
       .help = "TLV2.Length (6)",
       .bit_width = 8},
+    [SV_FIELD_TLV2_MAC] =
     { .name = "tlv2_mac",
       .help = "TLV2.RedBoxMacAddress",
       .bit_width = 48},
+    [SV_FIELD_TLV0_TYPE] =
     { .name = "tlv0_type",
       .help = "TLV0.Type (0)",
       .bit_width = 8},
+    [SV_FIELD_TLV0_LEN] =
     { .name = "tlv0_len",
       .help = "TLV0.Length (0)",
       .bit_width = 8},
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "ef.h"
+
+#define TIMING_STACK_MAX 16
+#define TIMING_IF_MAX    32
+#define TIMING_IF_NONE   -1
+
+typedef struct {
+    char     name[32];
+    uint64_t ns[TIMING_PHASE_CNT];
+    uint64_t frames[2];  // Indexed by tx
+    uint64_t bytes[2];
+} timing_if_t;
+
+typedef struct {
+    timing_phase_t phase;
+    int            if_idx;
+} timing_frame_t;
+
+static const char *PHASE_NAMES[TIMING_PHASE_CNT] = {
+    [TIMING_OTHER]     = "other",
+    [TIMING_PARSE]     = "parse",
+    [TIMING_CLONE]     = "clone",
+    [TIMING_FRAME_BUF] = "frame-buf",
+    [TIMING_SOCKET]    = "socket",
+    [TIMING_CAPTURE]   = "capture",
+    [TIMING_TX]        = "tx",
+    [TIMING_WAIT]      = "wait",
+    [TIMING_RX]        = "rx",
+    [TIMING_TEARDOWN]  = "teardown",
+};
+
+int TIMING = 0;
+__thread uint64_t TIMING_CNTS[TIMING_CNT_CNT];
+
+static __thread uint64_t T_BEGIN, T_LAST;
+static __thread uint64_t PHASE_NS[TIMING_PHASE_CNT];
+static __thread uint64_t PHASE_CALLS[TIMING_PHASE_CNT];
+static __thread timing_frame_t STACK[TIMING_STACK_MAX];
+static __thread int STACK_CNT, STACK_LOST;
+static __thread timing_if_t IFS[TIMING_IF_MAX];
+static __thread int IFS_CNT, IF_LAST;
+static __thread struct rusage RU_BEGIN;
+
+static uint64_t timing_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int timing_if(const char *name) {
+    int i;
+
+    if (!name)
+        return TIMING_IF_NONE;
+
+    // Consecutive probes are most often on the same interface
+    if (IF_LAST < IFS_CNT && strcmp(IFS[IF_LAST].name, name) == 0)
+        return IF_LAST;
+
+    for (i = 0; i < IFS_CNT; ++i) {
+        if (strcmp(IFS[i].name, name) == 0)
+            return IF_LAST = i;
+    }
+
+    if (IFS_CNT >= TIMING_IF_MAX)
+        return TIMING_IF_NONE;
+
+    snprintf(IFS[IFS_CNT].name, sizeof(IFS[IFS_CNT].name), "%s", name);
+    return IF_LAST = IFS_CNT++;
+}
+
+// Charge the time since the last probe to the phase on top of the stack
+static void timing_charge() {
+    uint64_t now = timing_now(), ns = now - T_LAST;
+    timing_frame_t *top = &STACK[STACK_CNT - 1];
+
+    PHASE_NS[top->phase] += ns;
+    if (top->if_idx != TIMING_IF_NONE)
+        IFS[top->if_idx].ns[top->phase] += ns;
+
+    T_LAST = now;
+}
+
+int timing_enable() {
+#ifdef EF_TIMING
+    if (TIMING)
+        return 0;
+
+    getrusage(RUSAGE_SELF, &RU_BEGIN);
+    T_BEGIN = T_LAST = timing_now();
+    STACK[0].phase = TIMING_OTHER;
+    STACK[0].if_idx = TIMING_IF_NONE;
+    STACK_CNT = 1;
+    TIMING = 1;
+
+    return 0;
+#else
+    pe("ERROR: -T is not supported, ef is built without TIMING_ENABLE\n");
+    return -1;
+#endif
+}
+
+void timing_enter_(timing_phase_t phase, const char *ifname) {
+    if (STACK_CNT == 0)
+        return;
+
+    // Too deep, the time is charged to the outer phase
+    if (STACK_CNT >= TIMING_STACK_MAX) {
+        STACK_LOST++;
+        return;
+    }
+
+    timing_charge();
+    STACK[STACK_CNT].phase = phase;
+    STACK[STACK_CNT].if_idx = timing_if(ifname);
+    STACK_CNT++;
+    PHASE_CALLS[phase]++;
+}
+
+void timing_leave_() {
+    if (STACK_LOST) {
+        STACK_LOST--;
+        return;
+    }
+
+    if (STACK_CNT <= 1)
+        return;
+
+    timing_charge();
+    STACK_CNT--;
+}
+
+void timing_io_(const char *ifname, int tx, size_t bytes) {
+    int i = timing_if(ifname);
+
+    if (i == TIMING_IF_NONE || STACK_CNT == 0)
+        return;
+
+    IFS[i].frames[!!tx]++;
+    IFS[i].bytes[!!tx] += bytes;
+}
+
+static double tv_ms(const struct timeval *a, const struct timeval *b) {
+    return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_usec - a->tv_usec) / 1e3;
+}
+
+void timing_report() {
+    struct rusage ru;
+    uint64_t total;
+    int i, p;
+
+    if (!TIMING || STACK_CNT == 0)
+        return;
+
+    timing_charge();
+    getrusage(RUSAGE_SELF, &ru);
+    total = T_LAST - T_BEGIN;
+
+    pe("TIMING: total %.3f ms\n", total / 1e6);
+    pe("TIMING: %-10s %8s %12s %6s\n", "phase", "calls", "ms", "%");
+    for (p = 0; p < TIMING_PHASE_CNT; ++p) {
+        if (!PHASE_NS[p] && !PHASE_CALLS[p])
+            continue;
+
+        pe("TIMING: %-10s %8" PRIu64 " %12.3f %6.1f\n", PHASE_NAMES[p],
+           PHASE_CALLS[p], PHASE_NS[p] / 1e6,
+           total ? PHASE_NS[p] * 100.0 / total : 0);
+    }
+
+    for (i = 0; i < IFS_CNT; ++i) {
+        pe("TIMING: if %s:", IFS[i].name);
+        for (p = 0; p < TIMING_PHASE_CNT; ++p) {
+            if (IFS[i].ns[p])
+                pe(" %s %.3f ms,", PHASE_NAMES[p], IFS[i].ns[p] / 1e6);
+        }
+        pe(" tx %" PRIu64 " frames %" PRIu64 " bytes, rx %" PRIu64
+           " frames %" PRIu64 " bytes\n", IFS[i].frames[1], IFS[i].bytes[1],
+           IFS[i].frames[0], IFS[i].bytes[0]);
+    }
+
+    pe("TIMING: syscalls %" PRIu64 ", allocations %" PRIu64 "\n",
+       TIMING_CNTS[TIMING_CNT_SYSCALL], TIMING_CNTS[TIMING_CNT_ALLOC]);
+    pe("TIMING: rusage user %.3f ms, sys %.3f ms, maxrss %ld kB, "
+       "minflt %ld, majflt %ld, nvcsw %ld, nivcsw %ld\n",
+       tv_ms(&RU_BEGIN.ru_utime, &ru.ru_utime),
+       tv_ms(&RU_BEGIN.ru_stime, &ru.ru_stime), ru.ru_maxrss,
+       ru.ru_minflt - RU_BEGIN.ru_minflt, ru.ru_majflt - RU_BEGIN.ru_majflt,
+       ru.ru_nvcsw - RU_BEGIN.ru_nvcsw, ru.ru_nivcsw - RU_BEGIN.ru_nivcsw);
+}
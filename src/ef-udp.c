@@ -1,12 +1,50 @@
 #include <stdio.h>
+#include <netinet/in.h>
 #include "ef.h"
 
+enum {
+    IPV4_PSEUDO_FIELD_SIP,
+    IPV4_PSEUDO_FIELD_DIP,
+    IPV4_PSEUDO_FIELD_ZERO,
+    IPV4_PSEUDO_FIELD_PROTO,
+    IPV4_PSEUDO_FIELD_LEN,
+};
+
+enum {
+    UDP_FIELD_SPORT,
+    UDP_FIELD_DPORT,
+    UDP_FIELD_LEN,
+    UDP_FIELD_CHKSUM,
+
+    UDP_FIELD_LAST
+};
+
+enum {
+    TCP_FIELD_SPORT,
+    TCP_FIELD_DPORT,
+    TCP_FIELD_SEQN,
+    TCP_FIELD_ACKN,
+    TCP_FIELD_DOFF,
+    TCP_FIELD_RESV,
+    TCP_FIELD_URG,
+    TCP_FIELD_ACK,
+    TCP_FIELD_PSH,
+    TCP_FIELD_RST,
+    TCP_FIELD_SYN,
+    TCP_FIELD_FIN,
+    TCP_FIELD_WIN,
+    TCP_FIELD_CHKSUM,
+    TCP_FIELD_URGP,
+
+    TCP_FIELD_LAST
+};
+
 static field_t IPv4_PSEUDO_FIELDS[] = {
-    { .name = "sip",     .bit_width =  32 },
-    { .name = "dip",     .bit_width =  32 },
-    { .name = "zero",    .bit_width =   8 },
-    { .name = "proto",   .bit_width =   8 },
-    { .name = "len",     .bit_width =  16 },
+    [IPV4_PSEUDO_FIELD_SIP]   = { .name = "sip",     .bit_width =  32 },
+    [IPV4_PSEUDO_FIELD_DIP]   = { .name = "dip",     .bit_width =  32 },
+    [IPV4_PSEUDO_FIELD_ZERO]  = { .name = "zero",    .bit_width =   8 },
+    [IPV4_PSEUDO_FIELD_PROTO] = { .name = "proto",   .bit_width =   8 },
+    [IPV4_PSEUDO_FIELD_LEN]   = { .name = "len",     .bit_width =  16 },
 };
 
 static hdr_t HDR_IPV4_PSEUDO = {
@@ -17,11 +55,11 @@ static hdr_t HDR_IPV4_PSEUDO = {
 };
 
 static field_t IPv6_PSEUDO_FIELDS[] = {
-    { .name = "sip",     .bit_width = 128 },
-    { .name = "dip",     .bit_width = 128 },
-    { .name = "len",     .bit_width =  32 },
-    { .name = "zero",    .bit_width =  24 },
-    { .name = "proto",   .bit_width =   8 },
+    [IPV6_PSEUDO_FIELD_SIP]   = { .name = "sip",     .bit_width = 128 },
+    [IPV6_PSEUDO_FIELD_DIP]   = { .name = "dip",     .bit_width = 128 },
+    [IPV6_PSEUDO_FIELD_LEN]   = { .name = "len",     .bit_width =  32 },
+    [IPV6_PSEUDO_FIELD_ZERO]  = { .name = "zero",    .bit_width =  24 },
+    [IPV6_PSEUDO_FIELD_PROTO] = { .name = "proto",   .bit_width =   8 },
 };
 
 hdr_t HDR_IPV6_PSEUDO = {
@@ -35,8 +73,15 @@ static int udp_tcp_fill_defaults(struct frame *f, int stack_idx) {
     int i, udp_len = 0;
     char buf[16];
     hdr_t *h = f->stack[stack_idx];
-    field_t *chksum = find_field(h, "chksum");
-    field_t *len = find_field(h, "len");
+    field_t *chksum, *len = 0;
+
+    // This function is shared by UDP and TCP, and only UDP has a len field
+    if (h->type == IPPROTO_UDP) {
+        chksum = &h->fields[UDP_FIELD_CHKSUM];
+        len = &h->fields[UDP_FIELD_LEN];
+    } else {
+        chksum = &h->fields[TCP_FIELD_CHKSUM];
+    }
 
     for (i = stack_idx; i < f->stack_size; ++i) {
         udp_len += f->stack[i]->size;
@@ -45,38 +90,45 @@ static int udp_tcp_fill_defaults(struct frame *f, int stack_idx) {
     if (len && !len->val) { // This field is only present in UDP
         snprintf(buf, 16, "%d", udp_len);
         buf[15] = 0;
-        len->val = parse_bytes(buf, 2);
+        field_val_parse(len, buf, 2);
     }
 
     if (!chksum->val && stack_idx >= 1) {
         hdr_t *ll = f->stack[stack_idx - 1];
         hdr_t *pseudo_hdr;
-        field_t *pseudo_len;
+        field_t *pseudo_sip, *pseudo_dip, *pseudo_len, *pseudo_proto;
         buf_t *b;
         int offset, sum;
 
         if (strcmp(ll->name, "ipv4") == 0) {
             pseudo_hdr = hdr_clone(&HDR_IPV4_PSEUDO);
+            pseudo_sip = &pseudo_hdr->fields[IPV4_PSEUDO_FIELD_SIP];
+            pseudo_dip = &pseudo_hdr->fields[IPV4_PSEUDO_FIELD_DIP];
+            pseudo_len = &pseudo_hdr->fields[IPV4_PSEUDO_FIELD_LEN];
+            pseudo_proto = &pseudo_hdr->fields[IPV4_PSEUDO_FIELD_PROTO];
         } else if (strcmp(ll->name, "ipv6") == 0) {
             pseudo_hdr = hdr_clone(&HDR_IPV6_PSEUDO);
+            pseudo_sip = &pseudo_hdr->fields[IPV6_PSEUDO_FIELD_SIP];
+            pseudo_dip = &pseudo_hdr->fields[IPV6_PSEUDO_FIELD_DIP];
+            pseudo_len = &pseudo_hdr->fields[IPV6_PSEUDO_FIELD_LEN];
+            pseudo_proto = &pseudo_hdr->fields[IPV6_PSEUDO_FIELD_PROTO];
         } else {
             return 0;
         }
 
         // Clone selected parts of ip header into pseudo header
-        find_field(pseudo_hdr, "sip")->val = bclone(find_field(ll, "sip")->val);
-        find_field(pseudo_hdr, "dip")->val = bclone(find_field(ll, "dip")->val);
+        pseudo_sip->val = bclone(find_field(ll, "sip")->val);
+        pseudo_dip->val = bclone(find_field(ll, "dip")->val);
 
         // Set proto in pseudo header
         snprintf(buf, 16, "%d", h->type);
         buf[15] = 0;
-        find_field(pseudo_hdr, "proto")->val = parse_bytes(buf, 1);
+        field_val_parse(pseudo_proto, buf, 1);
 
         // Set len in pseudo header. Size of len is different in ipv4 and 6
         snprintf(buf, 16, "%d", udp_len);
         buf[15] = 0;
-        pseudo_len = find_field(pseudo_hdr, "len");
-        pseudo_len->val = parse_bytes(buf, pseudo_len->bit_width / 8);
+        field_val_parse(pseudo_len, buf, pseudo_len->bit_width / 8);
 
         // Serialize the header (making checksum calculation easier)
         b = balloc(udp_len + pseudo_hdr->size);
@@ -91,7 +143,7 @@ static int udp_tcp_fill_defaults(struct frame *f, int stack_idx) {
         sum = inet_chksum(0, (uint16_t *)b->data, b->size);
         snprintf(buf, 16, "%d", sum);
         buf[15] = 0;
-        chksum->val = parse_bytes(buf, 2);
+        field_val_parse(chksum, buf, 2);
 
         bfree(b);
         hdr_free(pseudo_hdr);
@@ -100,15 +152,19 @@ static int udp_tcp_fill_defaults(struct frame *f, int stack_idx) {
 }
 
 static field_t UDP_FIELDS[] = {
+    [UDP_FIELD_SPORT] =
     { .name = "sport",
       .help = "Source Port Number, e.g. 22 for SSH",
       .bit_width =  16 },
+    [UDP_FIELD_DPORT] =
     { .name = "dport",
       .help = "Destination Port Number, e.g. 22 for SSH",
       .bit_width =  16 },
+    [UDP_FIELD_LEN] =
     { .name = "len",
       .help = "Length of UDP header and data",
       .bit_width =  16 },
+    [UDP_FIELD_CHKSUM] =
     { .name = "chksum",
       .help = "Checksum",
       .bit_width =  16 },
@@ -125,48 +181,63 @@ static hdr_t HDR_UDP = {
 };
 
 static field_t TCP_FIELDS[] = {
+    [TCP_FIELD_SPORT] =
     { .name = "sport",
       .help = "Source Port Number, e.g. 22 for SSH",
       .bit_width =  16 },
+    [TCP_FIELD_DPORT] =
     { .name = "dport",
       .help = "Destination Port Number, e.g. 22 for SSH",
       .bit_width =  16 },
+    [TCP_FIELD_SEQN] =
     { .name = "seqn",
       .help = "Sequence number",
       .bit_width =  32 },
+    [TCP_FIELD_ACKN] =
     { .name = "ackn",
       .help = "Acknowledgement number",
       .bit_width =  32 },
+    [TCP_FIELD_DOFF] =
     { .name = "doff",
       .help = "Data offset, size of TCP header in 32-bit words",
       .bit_width =   4 },
+    [TCP_FIELD_RESV] =
     { .name = "resv",
       .help = "Reserved, must be zero",
       .bit_width =   6 },
+    [TCP_FIELD_URG] =
     { .name = "urg",
       .help = "Urgent Pointer field significant",
       .bit_width =   1 },
+    [TCP_FIELD_ACK] =
     { .name = "ack",
       .help = "Acknowledgment field significant",
       .bit_width =   1 },
+    [TCP_FIELD_PSH] =
     { .name = "psh",
       .help = "Push Function",
       .bit_width =   1 },
+    [TCP_FIELD_RST] =
     { .name = "rst",
       .help = "Reset the connection",
       .bit_width =   1 },
+    [TCP_FIELD_SYN] =
     { .name = "syn",
       .help = "Synchronize sequence numbers",
       .bit_width =   1 },
+    [TCP_FIELD_FIN] =
     { .name = "fin",
       .help = "No more data from sender",
       .bit_width =   1 },
+    [TCP_FIELD_WIN] =
     { .name = "win",
       .help = "Window",
       .bit_width =  16 },
+    [TCP_FIELD_CHKSUM] =
     { .name = "chksum",
       .help = "Checksum",
       .bit_width =  16 },
+    [TCP_FIELD_URGP] =
     { .name = "urgp",
       .help = "Urgent Pointer",
       .bit_width =  16 },
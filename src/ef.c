@@ -5,6 +5,7 @@
 #include <arpa/inet.h>
 
 hdr_t *hdr_tmpls[HDR_TMPL_SIZE];
+static name_hash_t *HDR_TMPL_HASH;
 
 void hexdump(void *_d, int s) {
     int i;
@@ -20,12 +21,7 @@ void hexdump(void *_d, int s) {
 }
 
 void print_hex_str(int fd, void *_d, int s) {
-    uint8_t *d = (uint8_t *)_d;
-    uint8_t *e = d + s;
-
-    for (; d != e; ++d) {
-        dprintf(fd, "%02hhx", *d);
-    }
+    out_hex(fd, _d, s);
 }
 
 typedef void (*destruct_cb_t)(void *buf);
@@ -63,6 +59,30 @@ int field_copy(field_t *dst, const field_t *src) {
     return 0;
 }
 
+// Parse #s into the value of the field, which is #bytes long. The value buffer
+// of the field is reused if it has the size already. On errors the field is
+// left without a value.
+int field_val_parse(field_t *f, const char *s, int bytes) {
+    if (f->val && f->val->size != (size_t)bytes) {
+        bfree(f->val);
+        f->val = 0;
+    }
+
+    if (!f->val) {
+        f->val = balloc(bytes);
+        if (!f->val)
+            return -1;
+    }
+
+    if (parse_bytes_into(s, f->val->data, bytes) < 0) {
+        bfree(f->val);
+        f->val = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
 void hdr_destruct(hdr_t *h) {
     int i;
 
@@ -85,6 +105,7 @@ int hdr_copy(hdr_t *dst, const hdr_t *src) {
 
     if (src->fields_size && src->fields) {
         dst->fields = malloc(src->fields_size * sizeof(field_t));
+        TIMING_CNT(TIMING_CNT_ALLOC, 1);
         if (!dst->fields)
             return -1;
     }
@@ -162,7 +183,7 @@ int ether_type_fill_defaults(struct frame *f, int stack_idx) {
         snprintf(buf, 16, "%d", f->stack[stack_idx + 1]->type);
         buf[15] = 0;
 
-        et->val = parse_bytes(buf, 2);
+        field_val_parse(et, buf, 2);
     }
 
     return 0;
@@ -192,6 +213,11 @@ void def_offset(hdr_t *h) {
 field_t *find_field(hdr_t *h, const char *field) {
     int i;
 
+    if (h->field_hash) {
+        i = name_hash_find(h->field_hash, field);
+        return i < 0 ? 0 : &h->fields[i];
+    }
+
     for (i = 0; i < h->fields_size; ++i)
         if (!strcmp(field, h->fields[i].name))
             return &h->fields[i];
@@ -274,6 +300,14 @@ void hdr_write_field(buf_t *b, int offset, const field_t *f, const buf_t *val)
     // the first valid bit given the field width?
     bits_to_1st_valid = 8 * val->size - f->bit_width;
 
+    // Byte aligned fields (addresses, payloads) are copied as a whole
+    if (f->bit_offset % 8 == 0 && f->bit_width % 8 == 0 &&
+        8 * val->size >= (size_t)f->bit_width) {
+        memcpy(b->data + offset + f->bit_offset / 8,
+               val->data + bits_to_1st_valid / 8, f->bit_width / 8);
+        return;
+    }
+
     for (pos = 0; pos < f->bit_width; pos++)
         bit_set(b, f->bit_offset + pos + (8 * offset),
                 bit_get(val, pos + bits_to_1st_valid));
@@ -399,7 +433,7 @@ int hdr_parse_fields(frame_t *frame, struct hdr *hdr, int offset,
             }
 
         } else {
-            f->val = parse_bytes(argv[i], BIT_TO_BYTE(f->bit_width));
+            field_val_parse(f, argv[i], BIT_TO_BYTE(f->bit_width));
             i += 1;
         }
         f->rx_match_skip = 0;
@@ -578,6 +612,67 @@ void hdr_help(hdr_t **hdr, int size, int indent, int show_fields)
     }
 }
 
+hdr_t *hdr_tmpl_find(const char *name) {
+    int i;
+
+    if (HDR_TMPL_HASH) {
+        i = name_hash_find(HDR_TMPL_HASH, name);
+        return i < 0 ? 0 : hdr_tmpls[i];
+    }
+
+    for (i = 0; i < HDR_TMPL_SIZE; ++i)
+        if (hdr_tmpls[i] && strcmp(name, hdr_tmpls[i]->name) == 0)
+            return hdr_tmpls[i];
+
+    return 0;
+}
+
+static void hdr_fields_hash_init(hdr_t *h) {
+    int i;
+    const char **names;
+
+    names = malloc((h->fields_size + 1) * sizeof(*names));
+    if (!names)
+        return;
+
+    for (i = 0; i < h->fields_size; ++i)
+        names[i] = h->fields[i].name;
+
+    h->field_hash = name_hash_new(names, h->fields_size);
+    free(names);
+}
+
+// Build the name indexes of the header templates and their fields. Must be
+// called after all templates are registered.
+static void hdr_tmpls_hash_init() {
+    int i;
+    const char *names[HDR_TMPL_SIZE];
+
+    for (i = 0; i < HDR_TMPL_SIZE; ++i) {
+        names[i] = hdr_tmpls[i] ? hdr_tmpls[i]->name : 0;
+
+        if (hdr_tmpls[i] && !hdr_tmpls[i]->field_hash)
+            hdr_fields_hash_init(hdr_tmpls[i]);
+    }
+
+    HDR_TMPL_HASH = name_hash_new(names, HDR_TMPL_SIZE);
+}
+
+static void hdr_tmpls_hash_uninit() {
+    int i;
+
+    for (i = 0; i < HDR_TMPL_SIZE; ++i) {
+        if (!hdr_tmpls[i])
+            continue;
+
+        name_hash_free(hdr_tmpls[i]->field_hash);
+        hdr_tmpls[i]->field_hash = 0;
+    }
+
+    name_hash_free(HDR_TMPL_HASH);
+    HDR_TMPL_HASH = 0;
+}
+
 void ifh_init();
 void eth_init();
 void vlan_init();
@@ -619,6 +714,8 @@ void init() {
     opcua_init();
     coap_init();
     sv_init();
+
+    hdr_tmpls_hash_init();
 }
 
 void ifh_uninit();
@@ -643,6 +740,8 @@ void sv_uninit();
 
 void uninit() __attribute__ ((destructor));
 void uninit() {
+    hdr_tmpls_hash_uninit();
+
     ifh_uninit();
     eth_uninit();
     vlan_uninit();
@@ -2,9 +2,11 @@
 #define EF_H
 
 #include <stdint.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <sys/select.h>
 #include <linux/if_packet.h>
 
 #include "version.h"
@@ -18,61 +20,101 @@ extern "C" {
 
 extern int TIME_OUT_MS;
 
+// Frames dropped by the host on the RX sockets of the last test, which makes
+// its result inconclusive. See ef-exec.c.
+extern int EXEC_HOST_DROPS;
+
+///////////////////////////////////////////////////////////////////////////////
+// Timing report (-T), see ef-timing.c. The probes below are compiled away
+// unless ef is built with TIMING_ENABLE (EF_TIMING), and cost a branch each
+// when built in but not enabled. The time of a phase is exclusive, a nested
+// phase pauses the one it is entered from.
+typedef enum {
+    TIMING_OTHER,       // Not covered by any of the phases below
+    TIMING_PARSE,       // Argument parsing
+    TIMING_CLONE,       // Cloning header templates into a frame
+    TIMING_FRAME_BUF,   // frame_to_buf() and frame_mask_to_buf()
+    TIMING_SOCKET,      // raw_socket() setup and drain
+    TIMING_CAPTURE,     // Starting and stopping captures, incl. their sleeps
+    TIMING_TX,
+    TIMING_WAIT,        // Waiting in select() for RX frames or TX room
+    TIMING_RX,          // Receiving and matching frames
+    TIMING_TEARDOWN,    // Closing sockets, checking results, freeing cmds
+    TIMING_PHASE_CNT,
+} timing_phase_t;
+
+typedef enum {
+    TIMING_CNT_SYSCALL, // Socket and write syscalls done by ef
+    TIMING_CNT_ALLOC,   // Buffer, header and frame allocations
+    TIMING_CNT_CNT,
+} timing_cnt_t;
+
+// Set by timing_enable(). The state is per thread, the report covers the
+// thread which enabled it.
+extern int TIMING;
+extern __thread uint64_t TIMING_CNTS[TIMING_CNT_CNT];
+
+int timing_enable();
+void timing_enter_(timing_phase_t phase, const char *ifname);
+void timing_leave_();
+void timing_io_(const char *ifname, int tx, size_t bytes);
+void timing_report();
+
+#ifdef EF_TIMING
+#define TIMING_ENTER(phase, ifname) \
+    do { if (TIMING) timing_enter_(phase, ifname); } while (0)
+#define TIMING_LEAVE() \
+    do { if (TIMING) timing_leave_(); } while (0)
+#define TIMING_CNT(cnt, n) \
+    do { if (TIMING) TIMING_CNTS[cnt] += (n); } while (0)
+#define TIMING_IO(ifname, tx, bytes) \
+    do { if (TIMING) timing_io_(ifname, tx, bytes); } while (0)
+#else
+#define TIMING_ENTER(phase, ifname) do { } while (0)
+#define TIMING_LEAVE() do { } while (0)
+#define TIMING_CNT(cnt, n) do { } while (0)
+#define TIMING_IO(ifname, tx, bytes) do { } while (0)
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
+struct buf_map;
+
 typedef struct {
     size_t  size;
     uint8_t *data;
+
+    // Set if data points into a read-only file mapping, which is shared (and
+    // reference counted) between clones of the buffer.
+    struct buf_map *map;
 } buf_t;
 
 void bfree(buf_t *b);
 buf_t *balloc(size_t size);
 buf_t *bclone(const buf_t *b);
+buf_t *bmap_file(const char *path, size_t offset, size_t len);
 int bequal(const buf_t *a, const buf_t *b);
 int bequal_mask(const buf_t *rx_frame, const buf_t *expected_frame,
                 const buf_t *mask, int padding);
 
-typedef struct buf_list_element {
-    struct buf_list_element *next;
-    buf_t                    buf;
-} buf_list_element_t;
-
-void ble_free(buf_list_element_t *head);
-buf_list_element_t *ble_alloc(size_t size);
-
-buf_list_element_t *ble_tail(buf_list_element_t *head);
-
-buf_list_element_t *ble_append(buf_list_element_t *head, buf_list_element_t *e);
-
-buf_list_element_t *ble_append_buf(buf_list_element_t *head, buf_t *e);
-
-typedef struct {
-    size_t size;
-    size_t capacity;
-    buf_list_element_t *head;
-} buf_list_t;
-
-buf_t *bl_to_buf(buf_list_t *b);
-
-// debug feature, check invariants
-void bl_check(buf_list_t *b);
-
-void bl_reset(buf_list_t *b);
-void bset_value(buf_t *b, uint8_t v);
-
-static inline void bl_init(buf_list_t *b) { bl_reset(b); }
-static inline void bl_destroy(buf_list_t *b) { bl_reset(b); }
-
-int bl_printf_append(buf_list_t *b, const char *format, ...)
-    __attribute__ ((format (printf, 2, 3)));
-
 buf_t *bprintf(const char *fmt, ...)
     __attribute__ ((format (printf, 1, 2)));
 
+// File descriptors used by po() and pe(). Defaults to stdout and stderr, but
+// are redirected to the client while a job is served in daemon mode.
+extern int PO_FD;
+extern int PE_FD;
+
 int po(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
 int pe(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
 
-//ssize_t bwrite(int fd, const buf_list_t *buf, ssize_t off, size_t count);
-size_t bwrite_all(int fd, const buf_list_t *buf);
+// Buffered output, see ef-buf.c. Output is written at the latest on
+// out_flush(), at exit, or on SIGINT/SIGTERM/SIGHUP once out_signals_init() is
+// called.
+int out_write(int fd, const void *d, size_t len);
+int out_vprintf(int fd, const char *fmt, va_list ap);
+int out_hex(int fd, const void *d, size_t len);
+int out_flush();
+void out_signals_init();
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -83,6 +125,7 @@ static inline void name ## _free(name ## _t *f) {                              \
     destruct_free(f, (void *)&name ## _destruct);                              \
 }                                                                              \
 static inline name ## _t *name ## _alloc() {                                   \
+    TIMING_CNT(TIMING_CNT_ALLOC, 1);                                           \
     return (name ## _t *)calloc(1, sizeof(name ## _t));                        \
 }                                                                              \
 static inline name ## _t *name ## _clone(const name ## _t *src) {              \
@@ -97,6 +140,27 @@ static inline name ## _t *name ## _clone(const name ## _t *src) {              \
     }                                                                          \
 }
 
+struct name_hash;
+typedef struct name_hash name_hash_t;
+
+name_hash_t *name_hash_new(const char * const names[], int cnt);
+int name_hash_find(const name_hash_t *h, const char *name);
+void name_hash_free(name_hash_t *h);
+
+// Hex codec, see ef-hex.c
+enum {
+    HEX_DECODE_INVALID = -1,
+    HEX_DECODE_ALIGN   = -2,
+    HEX_DECODE_SIZE    = -3,
+};
+
+void hex_encode(char *o, const uint8_t *d, size_t len);
+int hex_decode(const char *s, size_t len, uint8_t *o, size_t o_size,
+               size_t *o_len);
+void hex_decode_err_print(const char *s, int err);
+int hex_impl_select(const char *name);
+const char *hex_impl_name();
+
 struct frame;
 struct field;
 typedef int (*frame_fill_defaults_t)(struct frame *, int stack_idx);
@@ -128,6 +192,7 @@ typedef struct field {
 
 int field_copy(field_t *dst, const field_t *src);
 void field_destruct(field_t *f);
+int field_val_parse(field_t *f, const char *s, int bytes);
 GEN_ALLOC_CLONE_FREE(field);
 
 typedef struct hdr {
@@ -139,6 +204,10 @@ typedef struct hdr {
     field_t    *fields;
     int         fields_size;
 
+    // Index of the field names, built at init for all templates and shared
+    // by their clones. If not set, find_field() searches the fields.
+    name_hash_t *field_hash;
+
     int         offset_in_frame;
 
     frame_fill_defaults_t frame_fill_defaults;
@@ -163,6 +232,7 @@ void frame_destruct(frame_t *f);
 GEN_ALLOC_CLONE_FREE(frame);
 
 buf_t *parse_bytes(const char *s, int bytes);
+int parse_bytes_into(const char *s, uint8_t *o, int bytes);
 buf_t *parse_field_hex(struct hdr *hdr, int hdr_offset, const char *s, int bytes);
 int parse_uint8(const char *s, uint8_t *o);
 int parse_uint32(const char *s, uint32_t *o);
@@ -170,6 +240,7 @@ int parse_var_bytes(buf_t **b, int argc, const char *argv[]);
 buf_t *parse_var_bytes_hex(const char *s, int min_size);
 
 field_t *find_field(hdr_t *h, const char *field);
+hdr_t *hdr_tmpl_find(const char *name);
 
 void hdr_write_field(buf_t *b, int offset, const field_t *f, const buf_t *val);
 
@@ -258,17 +329,36 @@ typedef enum {
 
 extern hdr_t *hdr_tmpls[HDR_TMPL_SIZE];
 
+// The IPv6 pseudo header of the UDP, TCP and ICMPv6 checksums, see ef-udp.c
+enum {
+    IPV6_PSEUDO_FIELD_SIP,
+    IPV6_PSEUDO_FIELD_DIP,
+    IPV6_PSEUDO_FIELD_LEN,
+    IPV6_PSEUDO_FIELD_ZERO,
+    IPV6_PSEUDO_FIELD_PROTO,
+};
+
+extern hdr_t HDR_IPV6_PSEUDO;
+
 typedef enum {
     CMD_TYPE_INVALID,
     CMD_TYPE_NAME,
-#ifdef HAS_LIBPCAP
     CMD_TYPE_PCAP,
-#endif
     CMD_TYPE_HEX,
     CMD_TYPE_RX,
     CMD_TYPE_TX,
+    CMD_TYPE_GEN,
+    CMD_TYPE_EXPECT,
+    CMD_TYPE_RFC2544,
 } cmd_type_t;
 
+struct replay;
+struct gen;
+struct link_expect;
+struct lat_tx;
+struct seq_rx;
+struct rfc2544;
+
 struct cmd;
 typedef struct cmd {
     struct cmd *next;
@@ -280,17 +370,249 @@ typedef struct cmd {
     buf_t      *frame_mask_buf;
     int         done;
     uint32_t    repeat;
+    int         idx;
+
+    // Frames are read from a pcap file instead ('tx <if> replay ...')
+    struct replay *replay;
+
+    // Variants of a frame with value ranges ('gen <file> ...')
+    struct gen    *gen;
+
+    // Check of a link counter ('expect-<counter> <if> <op> <cnt>')
+    struct link_expect *expect;
+
+    // Latency signature in each frame sent ('tx <if> latency ...'), or
+    // latency measured on the frames received ('rx <if> latency')
+    struct lat_tx *lat;
+    int            lat_rx;
+
+    // Sequence numbers of the frames received ('rx <if> seq ...')
+    struct seq_rx *seq;
+
+    // RFC 2544 benchmark ('rfc2544 <tx-if> <rx-if> ...')
+    struct rfc2544 *rfc2544;
 } cmd_t;
 
+///////////////////////////////////////////////////////////////////////////////
+// Live statistics (-s <interval-in-ms>), see ef-stats.c. The counters of an
+// interface are only written by the thread running the test, and read by the
+// stats thread, so they are updated with relaxed atomic stores and no locks.
+typedef struct {
+    char     name[32];
+    uint64_t tx_frames;
+    uint64_t tx_bytes;
+    uint64_t tx_drop;       // Frames which could not be sent
+    uint64_t rx_frames;
+    uint64_t rx_bytes;
+    uint64_t rx_match;
+    uint64_t rx_unexpected;
+} stats_if_t;
+
+#define STATS_ADD(s, cnt, n)                                                   \
+    do {                                                                       \
+        if (s)                                                                 \
+            __atomic_store_n(&(s)->cnt, (s)->cnt + (n), __ATOMIC_RELAXED);     \
+    } while (0)
+
+void stats_enable();
+int stats_start(int interval_ms);
+void stats_stop();
+
+// Returns 0 if the stats are not enabled
+stats_if_t *stats_if_get(const char *name);
+
 typedef struct {
     int          fd;
     int          has_rx;
     int          has_tx;
     cmd_t       *cmd;
     int          rx_err_cnt;
+    stats_if_t  *stats;
+    struct lat_rx *lat;
+    struct seq_rx *seq;
 } cmd_socket_t;
 
+///////////////////////////////////////////////////////////////////////////////
+// Kernel link statistics, see ef-link.c
+typedef enum {
+    LINK_RX_FRAMES,
+    LINK_TX_FRAMES,
+    LINK_RX_BYTES,
+    LINK_TX_BYTES,
+    LINK_RX_DROPPED,
+    LINK_TX_DROPPED,
+    LINK_RX_ERRORS,
+    LINK_TX_ERRORS,
+    LINK_CNT_CNT,
+} link_cnt_t;
+
+typedef enum {
+    LINK_OP_EQ,
+    LINK_OP_NE,
+    LINK_OP_GE,
+    LINK_OP_LE,
+    LINK_OP_GT,
+    LINK_OP_LT,
+} link_op_t;
+
+typedef struct {
+    uint64_t cnt[LINK_CNT_CNT];
+} link_stats_t;
+
+typedef struct link_expect {
+    link_cnt_t cnt;
+    link_op_t  op;
+    uint64_t   val;
+} link_expect_t;
+
+typedef struct {
+    const char   *ifname;
+    int           valid;
+    link_stats_t  before;
+    link_stats_t  delta;
+} link_snap_t;
+
+int link_cnt_parse(const char *name);
+int link_socket();
+int link_stats_get(int fd, const char *ifname, link_stats_t *s);
+int argc_link_expect(int argc, const char *argv[], const char *counter,
+                     link_expect_t **expect);
+int link_expect_check(const link_expect_t *e, uint64_t val);
+
+// Snapshot the counters of the interfaces of a run, if it checks them or
+// sends with 'rep' or 'replay'. Returns the number of snapshots.
+int link_snap_begin(int cnt, const cmd_t *cmds, link_snap_t *snaps,
+                    int snap_max);
+
+// Print the deltas, and check the expect-* commands. Returns the number of
+// errors.
+int link_snap_end(int cnt, const cmd_t *cmds, link_snap_t *snaps,
+                  int snap_cnt);
+
+// The speed of the link in Mbps (ethtool), or -1 if unknown
+int link_speed_get(const char *ifname);
+
+///////////////////////////////////////////////////////////////////////////////
+// Sequence number tracking, see ef-seq.c
+#define SEQ_WIN_BITS 4096
+
+typedef struct {
+    int      started;
+    uint64_t first;
+    uint64_t next;          // The highest sequence number received + 1
+    uint64_t frames;
+    uint64_t lost;
+    uint64_t reordered;
+    uint64_t reorder_max;   // The largest reordering distance
+    uint64_t duplicates;
+    uint64_t late;          // Received after having left the window
+    uint64_t bits[SEQ_WIN_BITS / 64];
+} seq_win_t;
+
+void seq_win_start(seq_win_t *w, uint64_t first);
+void seq_win_add(seq_win_t *w, uint64_t s);
+void seq_win_add_wrap(seq_win_t *w, uint64_t v, int bits);
+void seq_win_end(seq_win_t *w, uint64_t end);
+int seq_win_report(const seq_win_t *w, const char *ifname, const char *what);
+
+typedef enum {
+    SEQ_SRC_RTAG,       // Redundancy tag (802.1CB)
+    SEQ_SRC_HTAG,       // HSR tag
+    SEQ_SRC_OFFSET,     // A counter at a fixed offset in the frame
+} seq_src_t;
+
+typedef struct seq_rx {
+    seq_src_t src;
+    int       offset;
+    int       bytes;
+    seq_win_t win;
+} seq_rx_t;
+
+int argc_seq(int argc, const char *argv[], seq_rx_t **seq);
+int seq_rx_frame(seq_rx_t *r, const buf_t *b);
+int seq_rx_report(seq_rx_t *r, const char *ifname);
+
+///////////////////////////////////////////////////////////////////////////////
+// Latency measurement, see ef-latency.c
+#define LAT_SIG_SIZE    28
+#define LAT_STREAMS_MAX 64
+
+// HDR style histogram of values in ns, with LAT_SUB_BITS bits of precision
+#define LAT_SUB_BITS 7
+#define LAT_SUB_CNT  (1 << LAT_SUB_BITS)
+#define LAT_HALF     (LAT_SUB_CNT / 2)
+#define LAT_MAX_BITS 44
+#define LAT_BUCKETS  (LAT_SUB_CNT + (LAT_MAX_BITS - LAT_SUB_BITS) * LAT_HALF)
+
+typedef struct {
+    uint64_t cnt;
+    uint64_t min;
+    uint64_t max;
+    double   sum;
+    uint64_t buckets[LAT_BUCKETS];
+} lat_hist_t;
+
+void lat_hist_add(lat_hist_t *h, uint64_t v);
+uint64_t lat_hist_percentile(const lat_hist_t *h, double p);
+
+typedef struct lat_tx {
+    uint32_t stream;
+    int      stream_auto;   // No stream id given, see lat_tx_streams()
+    uint64_t seq;
+    int      offset;    // Of the signature in the frame
+    uint16_t sum;       // Of the bytes replaced by the signature
+} lat_tx_t;
+
+typedef struct {
+    uint32_t   id;
+    lat_hist_t lat;
+    lat_hist_t ipdv;
+    int64_t    last_transit;
+    uint64_t   last_seq;
+    double     jitter;
+    uint64_t   negative;
+    seq_win_t  seq;
+    uint64_t   seq_end;     // The next sequence number of the sender, if known
+} lat_stream_t;
+
+typedef struct lat_rx {
+    int           cnt;
+    lat_stream_t *streams[LAT_STREAMS_MAX];
+} lat_rx_t;
+
+int argc_latency(int argc, const char *argv[], lat_tx_t **lat);
+int lat_tx_prepare(lat_tx_t *t, const frame_t *f, const buf_t *b);
+int lat_tx_streams(int cnt, cmd_t *cmds);
+void lat_tx_stamp(lat_tx_t *t, buf_t *b);
+
+lat_rx_t *lat_rx_new();
+void lat_rx_free(lat_rx_t *r);
+int lat_rx_frame(lat_rx_t *r, const buf_t *b, const struct timespec *ts);
+void lat_rx_sent(lat_rx_t *r, const lat_tx_t *t);
+int lat_rx_report(lat_rx_t *r, const char *ifname);
+
+// Where the timestamp of a frame was taken
+typedef enum {
+    TS_SRC_HOST,    // By ef, when it handled the frame
+    TS_SRC_SW,      // By the kernel (SO_TIMESTAMPING)
+    TS_SRC_HW,      // By the NIC (SO_TIMESTAMPING)
+} ts_src_t;
+
+const char *ts_src_name(ts_src_t src);
+
+int raw_socket(const char *name);
+
+// Socket buffer sizing and host drop counts of the RX sockets, see ef-exec.c
+#define RCVBUF_MAX (64 * 1024 * 1024)
+void raw_socket_rcvbuf(int fd, int size);
+int raw_socket_drops(int fd, struct tpacket_stats *st);
+int rx_frame_recv(int fd, buf_t *b, struct timespec *ts, int flags);
+int rx_frame_recv_ts(int fd, buf_t *b, struct timespec *ts, ts_src_t *ts_src,
+                     struct timespec *ts_sys, int flags);
 int exec_cmds(int cnt, cmd_t *cmds);
+int exec_session_begin();
+int exec_session_active();
+void exec_session_end();
 
 void print_hex_str(int fd, void *_d, int s);
 
@@ -301,20 +623,202 @@ void print_help();
 int argc_cmds(int argc, const char *argv[]);
 int main_(int argc, const char *argv[]);
 
+int argv_split(char *s, const char *argv[], int argv_max);
+int is_blank_or_comment(const char *s);
+int batch_job(char *s);
+int batch_run(const char *path);
+int daemon_run(const char *path);
+
+// Capture file writer, see ef-pcap.c
+#define PCAP_WRITER_IF_MAX 16
+
+typedef struct {
+    int      fd;
+    int      ng;
+    int      nsec;
+    uint32_t snaplen;
+    size_t   len;
+    uint8_t *buf;
+
+    // pcapng interfaces, the index is the interface id
+    int      if_cnt;
+    char    *if_names[PCAP_WRITER_IF_MAX];
+} pcap_writer_t;
+
+pcap_writer_t *pcap_writer_open(const char *path, uint32_t snaplen,
+                                int append);
+int pcap_writer_if(pcap_writer_t *w, const char *name);
+int pcap_writer_write(pcap_writer_t *w, int if_id, const struct timespec *ts,
+                      const uint8_t *data, uint32_t len);
+int pcap_writer_flush(pcap_writer_t *w);
+int pcap_writer_close(pcap_writer_t *w);
+
+typedef void (*pcap_read_cb_t)(void *ctx, const struct timespec *ts,
+                               const uint8_t *data, uint32_t len,
+                               uint32_t orig_len);
+int pcap_file_read(const char *path, pcap_read_cb_t cb, void *ctx);
+
+struct pcap_file;
+typedef struct pcap_file pcap_file_t;
+
+typedef struct {
+    struct timespec ts;
+    const uint8_t  *data;
+    uint32_t        len;
+    uint32_t        orig_len;
+} pcap_rec_t;
+
+pcap_file_t *pcap_file_open(const char *path);
+int pcap_file_next(pcap_file_t *f, pcap_rec_t *rec);
+void pcap_file_rewind(pcap_file_t *f);
+void pcap_file_close(pcap_file_t *f);
+
+typedef enum {
+    REPLAY_ORIG,    // Original gaps, scaled by 'speed'
+    REPLAY_PPS,     // Fixed rate
+    REPLAY_ASAP,    // No gaps
+} replay_mode_t;
+
+// All times are in ns of CLOCK_MONOTONIC
+typedef struct replay {
+    char         *path;
+    pcap_file_t  *f;
+    replay_mode_t mode;
+    double        speed;
+    uint64_t      pps;
+    uint32_t      loop;
+
+    uint32_t      pass;
+    int           started;
+    int           done;
+    int           err;
+    uint64_t      sent;        // Records consumed, including failed ones
+    uint64_t      failed;
+    uint64_t      start;
+    uint64_t      last;        // Deadline of the previous record
+    uint64_t      pass_base;   // Deadline of the first record of this pass
+    uint64_t      pass_ts;     // Time stamp of the first record of this pass
+    int           pass_first;
+
+    int           pending;     // rec is loaded, and due at 'deadline'
+    pcap_rec_t    rec;
+    uint64_t      deadline;
+} replay_t;
+
+uint64_t replay_now();
+int argc_replay(int argc, const char *argv[], replay_t **r);
+void replay_free(replay_t *r);
+const pcap_rec_t *replay_next(replay_t *r, uint64_t now, uint64_t *wait);
+void replay_sent(replay_t *r);
+void replay_size(replay_t *r, uint64_t *frames, uint64_t *bytes);
+
+typedef struct gen gen_t;
+
+int argc_gen(int argc, const char *argv[], gen_t **g);
+void gen_free(gen_t *g);
+uint64_t gen_cnt(const gen_t *g);
+int64_t gen_run(const gen_t *g, const char *path);
+
+typedef struct rfc2544 rfc2544_t;
+
+typedef enum {
+    RFC2544_PASS,
+    RFC2544_FAIL,           // The DUT lost frames
+    RFC2544_HOST_LIMITED,   // The host could not send or receive at the rate,
+                            // which tells nothing about the DUT
+} rfc2544_res_t;
+
+typedef struct {
+    uint64_t      sent;
+    uint64_t      received;
+    uint64_t      tx_err;
+    uint64_t      host_drops;
+    double        fps;      // Achieved
+    rfc2544_res_t res;
+    lat_rx_t     *lat;
+} rfc2544_trial_t;
+
+// Binary search of the highest rate or burst which passes. #lo has passed (or
+// is 0), #hi has failed (or is the maximum), and #cur is the next to try.
+typedef struct {
+    double lo;
+    double hi;
+    double cur;
+    double step;            // The resolution
+    int    whole;           // The values are frame counts
+    int    host_limited;    // Stopped by a host limited trial, #lo is only a
+                            // lower bound
+} rfc2544_search_t;
+
+int argc_rfc2544(int argc, const char *argv[], rfc2544_t **r);
+void rfc2544_free(rfc2544_t *r);
+int rfc2544_run(rfc2544_t *r, const char *tx_if);
+rfc2544_res_t rfc2544_trial_res(const rfc2544_trial_t *t, double fps,
+                                uint64_t cnt);
+int rfc2544_search_next(rfc2544_search_t *s, rfc2544_res_t res);
+
 struct capture;
 typedef struct capture {
     struct capture    *next;
-    buf_t             *tcpdump_cmd;
+    char              *ifname;
+    char              *file;
+    uint32_t           snaplen;
+    uint32_t           cnt;
+
+    // In-process capture
+    int                fd;
+    uint32_t           frames;
+    pcap_writer_t     *pcap;
+    int                if_id;
+
+    // External capture, using tcpdump
+    char             **tcpdump_argv;
     pid_t              pid;
-    int                res;
     int                running;
-    int                success;
+    int                ready;
+    int                err_fd;
+    char               err_line[256];
+    size_t             err_line_len;
 } capture_t;
 
+typedef enum {
+    RESULT_TX,
+    RESULT_RX_OK,
+    RESULT_RX_ERR,
+    RESULT_NO_RX,
+} result_type_t;
+
+// One record per result event. This is also the record format of the binary
+// result stream ('-o bin:<file>').
+typedef struct {
+    uint64_t ts_sec;
+    uint32_t ts_nsec;
+    uint32_t frame_len;
+    int32_t  cmd_idx;     // Index of the command, -1 if none matched
+    uint8_t  type;        // result_type_t
+    uint8_t  ts_src;      // ts_src_t
+    uint8_t  pad[2];
+    char     ifname[16];
+    char     name[32];    // Name of the frame, empty if not named
+} result_rec_t;
+
+int result_sink_open(const char *spec);
+int result_sink_active();
+void result_add(result_type_t type, int cmd_idx, const char *ifname,
+                const struct timespec *ts, ts_src_t ts_src,
+                uint32_t frame_len, const char *name);
+int result_flush();
+int result_sink_close();
+void result_job_begin();
+const result_rec_t *result_job_recs(size_t *cnt);
+void result_job_end(int fd);
+
 int capture_cnt();
 int capture_add(char *s);
 int capture_all_start();
 int capture_all_stop();
+int capture_fds_fill(fd_set *rfds, int fd_max);
+void capture_fds_process(fd_set *rfds);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,69 @@
+#include "ef.h"
+#include "ef-test.h"
+
+#include <string>
+#include <vector>
+#include "catch_single_include.hxx"
+
+static std::vector<std::string> split(const char *line) {
+    std::vector<std::string> v;
+    const char *argv[16];
+    std::string s(line);
+    int argc;
+
+    argc = argv_split(&s[0], argv, 16);
+    if (argc < 0)
+        return {"<error>"};
+
+    for (int i = 0; i < argc; ++i)
+        v.push_back(argv[i]);
+
+    CHECK(argv[argc] == 0);
+
+    return v;
+}
+
+TEST_CASE("argv-split", "[batch]" ) {
+    typedef std::vector<std::string> V;
+
+    CHECK(split("") == V());
+    CHECK(split(" \t ") == V());
+    CHECK(split("tx eth0  name f1") == V({"tx", "eth0", "name", "f1"}));
+    CHECK(split("  a\tb  ") == V({"a", "b"}));
+
+    // Quotes
+    CHECK(split("a 'b c' d") == V({"a", "b c", "d"}));
+    CHECK(split("a \"b c\" d") == V({"a", "b c", "d"}));
+    CHECK(split("a'b'\"c\"d") == V({"abcd"}));
+    CHECK(split("'a \"b\"'") == V({"a \"b\""}));
+    CHECK(split("\"a 'b'\"") == V({"a 'b'"}));
+
+    // Escapes
+    CHECK(split("a\\ b c") == V({"a b", "c"}));
+    CHECK(split("\\'a\\\"") == V({"'a\""}));
+    CHECK(split("\"a\\\"b\"") == V({"a\"b"}));
+    CHECK(split("'a\\b'") == V({"a\\b"}));
+    CHECK(split("a\\") == V({"a\\"}));
+
+    // Empty fields
+    CHECK(split("a '' b") == V({"a", "", "b"}));
+    CHECK(split("\"\"") == V({""}));
+    CHECK(split("'' \"\"") == V({"", ""}));
+
+    // Errors
+    CHECK(split("a 'b") == V({"<error>"}));
+    CHECK(split("a \"b") == V({"<error>"}));
+    CHECK(split("1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16") == V({"<error>"}));
+}
+
+TEST_CASE("batch-job-timeout", "[batch]" ) {
+    const char *bad[] = {"-t abc", "-t -1", "-t 10x", "-t", "-t ''",
+                         "-t 99999999999"};
+    int timeout = TIME_OUT_MS;
+
+    for (auto b : bad) {
+        std::string s(b);
+        CHECK(batch_job(&s[0]) == -1);
+        CHECK(TIME_OUT_MS == timeout);
+    }
+}
@@ -20,4 +20,7 @@ std::ostream& operator<<(std::ostream& o, const HexBuf &b);
 
 frame_t *parse_frame_wrap(std::vector<const char *> ptrs);
 
+// The previous implementation of parse_bytes(), see parse-bytes-legacy.c
+extern "C" buf_t *parse_bytes_legacy(const char *s, int bytes);
+
 #endif   // EF_TEST_H
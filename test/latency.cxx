@@ -0,0 +1,156 @@
+#include "ef.h"
+#include "ef-test.h"
+
+#include <time.h>
+#include "catch_single_include.hxx"
+
+static uint16_t sum16(const buf_t *b) {
+    uint32_t sum = 0;
+
+    for (size_t i = 0; i + 1 < b->size; i += 2)
+        sum += b->data[i] << 8 | b->data[i + 1];
+
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return sum;
+}
+
+TEST_CASE("latency-hist", "[latency]" ) {
+    lat_hist_t *h = (lat_hist_t *)calloc(1, sizeof(lat_hist_t));
+
+    CHECK(lat_hist_percentile(h, 50) == 0);
+
+    for (uint64_t v = 1; v <= 100; ++v)
+        lat_hist_add(h, v);
+
+    CHECK(h->cnt == 100);
+    CHECK(h->min == 1);
+    CHECK(h->max == 100);
+    CHECK(lat_hist_percentile(h, 50) == 50);
+    CHECK(lat_hist_percentile(h, 99) == 99);
+    CHECK(lat_hist_percentile(h, 100) == 100);
+
+    // Large values are within the precision of the buckets
+    lat_hist_add(h, 1000000);
+    lat_hist_add(h, 12345678);
+    CHECK(lat_hist_percentile(h, 100) == 12345678);
+    uint64_t v = lat_hist_percentile(h, 99.5);
+    CHECK(v >= 1000000 * 0.984);
+    CHECK(v <= 1000000 * 1.016);
+
+    // Out of range values are counted in the last bucket
+    lat_hist_add(h, UINT64_MAX);
+    CHECK(h->cnt == 103);
+
+    free(h);
+}
+
+TEST_CASE("latency-signature", "[latency]" ) {
+    const char *argv[] = {"latency", "7", "eth"};
+    struct timespec ts;
+    lat_tx_t *t = 0;
+    lat_rx_t *r;
+
+    REQUIRE(argc_latency(3, argv, &t) == 2);
+    REQUIRE(t);
+    CHECK(t->stream == 7);
+    CHECK(t->stream_auto == 0);
+
+    auto f = parse_frame_wrap({"eth", "dmac", "::1", "smac", "::2", "ipv4",
+                               "udp", "data", "pattern", "cnt", "40"});
+    REQUIRE(f);
+    buf_t *b = frame_to_buf(f);
+    uint16_t sum = sum16(b);
+
+    REQUIRE(lat_tx_prepare(t, f, b) == 0);
+    lat_tx_stamp(t, b);
+    lat_tx_stamp(t, b);
+    CHECK(t->seq == 2);
+
+    // The UDP and IPv4 checksums are still valid
+    CHECK(sum16(b) == sum);
+
+    r = lat_rx_new();
+    clock_gettime(CLOCK_REALTIME, &ts);
+    CHECK(lat_rx_frame(r, b, &ts) == 1);
+    REQUIRE(r->cnt == 1);
+    CHECK(r->streams[0]->id == 7);
+    CHECK(r->streams[0]->last_seq == 1);
+    CHECK(r->streams[0]->lat.cnt == 1);
+
+    // A minimum size frame, padded again by a DUT which removed a tag
+    auto f2 = parse_frame_wrap({"eth", "data", "pattern", "cnt", "46"});
+    buf_t *b2 = frame_to_buf(f2);
+    REQUIRE(lat_tx_prepare(t, f2, b2) == 0);
+    lat_tx_stamp(t, b2);
+
+    buf_t *p = balloc(60);
+    memcpy(p->data, b2->data + 4, b2->size - 4);
+    CHECK(lat_rx_frame(r, p, &ts) == 1);
+    CHECK(r->streams[0]->lat.cnt == 2);
+    CHECK(r->streams[0]->last_seq == 2);
+
+    // Frames without a signature are not accounted
+    memset(p->data, 0, p->size);
+    CHECK(lat_rx_frame(r, p, &ts) == 0);
+
+    lat_rx_free(r);
+    bfree(p);
+    bfree(b2);
+    bfree(b);
+    frame_free(f2);
+    frame_free(f);
+    free(t);
+}
+
+TEST_CASE("latency-no-room", "[latency]" ) {
+    const char *argv[] = {"latency"};
+    lat_tx_t *t = 0;
+
+    REQUIRE(argc_latency(1, argv, &t) == 1);
+    REQUIRE(t);
+    CHECK(t->stream == 0);
+    CHECK(t->stream_auto == 1);
+
+    // Not enough data
+    auto f1 = parse_frame_wrap({"eth", "ipv4", "udp", "data", "pattern",
+                                "cnt", "27"});
+    buf_t *b1 = frame_to_buf(f1);
+    CHECK(lat_tx_prepare(t, f1, b1) == -1);
+
+    // Padded to 60 bytes
+    auto f2 = parse_frame_wrap({"eth", "data", "pattern", "cnt", "30"});
+    buf_t *b2 = frame_to_buf(f2);
+    CHECK(lat_tx_prepare(t, f2, b2) == -1);
+
+    bfree(b1);
+    bfree(b2);
+    frame_free(f1);
+    frame_free(f2);
+    free(t);
+}
+
+TEST_CASE("latency-streams", "[latency]" ) {
+    lat_tx_t t[3] = {};
+    cmd_t cmds[4] = {};
+
+    for (int i = 0; i < 4; ++i)
+        cmds[i].idx = i;
+
+    // Commands without a stream id get their index
+    cmds[0].lat = &t[0];
+    cmds[2].lat = &t[1];
+    cmds[3].lat = &t[2];
+    t[0].stream_auto = 1;
+    t[1].stream_auto = 1;
+    t[2].stream = 7;
+    CHECK(lat_tx_streams(4, cmds) == 0);
+    CHECK(t[0].stream == 0);
+    CHECK(t[1].stream == 2);
+    CHECK(t[2].stream == 7);
+
+    // A given id may not be used by another command
+    t[2].stream = 2;
+    CHECK(lat_tx_streams(4, cmds) == 1);
+}
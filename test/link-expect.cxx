@@ -0,0 +1,80 @@
+#include "ef.h"
+#include "ef-test.h"
+
+#include <vector>
+#include "catch_single_include.hxx"
+
+static link_expect_t *parse_expect(const char *counter,
+                                   std::vector<const char *> ptrs) {
+    link_expect_t *e = 0;
+
+    if (argc_link_expect(ptrs.size(), ptrs.data(), counter, &e) != 2)
+        return 0;
+
+    return e;
+}
+
+TEST_CASE("link-expect", "[link]" ) {
+    link_expect_t *e;
+
+    e = parse_expect("rx-frames", {">=", "1000000"});
+    REQUIRE(e);
+    CHECK(e->cnt == LINK_RX_FRAMES);
+    CHECK(e->op == LINK_OP_GE);
+    CHECK(e->val == 1000000);
+    CHECK(link_expect_check(e, 1000000) == 1);
+    CHECK(link_expect_check(e, 999999) == 0);
+    free(e);
+
+    e = parse_expect("tx-dropped", {"==", "0", "tx", "eth0"});
+    REQUIRE(e);
+    CHECK(e->cnt == LINK_TX_DROPPED);
+    CHECK(link_expect_check(e, 0) == 1);
+    CHECK(link_expect_check(e, 1) == 0);
+    free(e);
+
+    e = parse_expect("rx-bytes", {"<", "0x100"});
+    REQUIRE(e);
+    CHECK(link_expect_check(e, 0xff) == 1);
+    CHECK(link_expect_check(e, 0x100) == 0);
+    free(e);
+
+    CHECK(parse_expect("rx-foo", {">=", "1"}) == 0);
+    CHECK(parse_expect("rx-frames", {"=>", "1"}) == 0);
+    CHECK(parse_expect("rx-frames", {">=", "1k"}) == 0);
+    CHECK(parse_expect("rx-frames", {">=", "-1"}) == 0);
+    CHECK(parse_expect("rx-frames", {">="}) == 0);
+}
+
+TEST_CASE("link-expect-ops", "[link]" ) {
+    struct {
+        const char *sym;
+        const char *word;
+        int op;
+        int below, equal, above;
+    } ops[] = {
+        { "==", "eq", LINK_OP_EQ, 0, 1, 0 },
+        { "!=", "ne", LINK_OP_NE, 1, 0, 1 },
+        { ">=", "ge", LINK_OP_GE, 0, 1, 1 },
+        { "<=", "le", LINK_OP_LE, 1, 1, 0 },
+        { ">",  "gt", LINK_OP_GT, 0, 0, 1 },
+        { "<",  "lt", LINK_OP_LT, 1, 0, 0 },
+    };
+
+    for (auto &o : ops) {
+        for (auto spelling : {o.sym, o.word}) {
+            link_expect_t *e = parse_expect("rx-frames", {spelling, "10"});
+
+            INFO(spelling);
+            REQUIRE(e);
+            CHECK(e->op == o.op);
+            CHECK(link_expect_check(e, 9) == o.below);
+            CHECK(link_expect_check(e, 10) == o.equal);
+            CHECK(link_expect_check(e, 11) == o.above);
+            free(e);
+        }
+    }
+
+    CHECK(parse_expect("rx-frames", {"GE", "1"}) == 0);
+    CHECK(parse_expect("rx-frames", {"geq", "1"}) == 0);
+}
@@ -0,0 +1,202 @@
+#include "ef.h"
+#include "ef-test.h"
+
+#include <vector>
+#include <string>
+#include <unistd.h>
+#include "catch_single_include.hxx"
+
+struct pcap_rec {
+    struct timespec ts;
+    std::string     data;
+    uint32_t        orig_len;
+};
+
+static void pcap_rec_cb(void *ctx, const struct timespec *ts,
+                        const uint8_t *data, uint32_t len, uint32_t orig_len) {
+    auto recs = (std::vector<pcap_rec> *)ctx;
+
+    recs->push_back({*ts, std::string((const char *)data, len), orig_len});
+}
+
+static void pcap_roundtrip(const char *path) {
+    std::vector<pcap_rec> recs;
+    struct timespec ts1 = { 1000, 123456789 }, ts2 = { 2000, 1 };
+    uint8_t d[100];
+
+    for (size_t i = 0; i < sizeof(d); ++i)
+        d[i] = i;
+
+    pcap_writer_t *w = pcap_writer_open(path, 64, 0);
+    REQUIRE(w);
+    CHECK(pcap_writer_write(w, pcap_writer_if(w, "eth0"), &ts1, d, 61) == 0);
+    CHECK(pcap_writer_write(w, pcap_writer_if(w, "eth1"), &ts2, d, 100) == 0);
+    CHECK(pcap_writer_close(w) == 0);
+
+    // Appending keeps the existing records
+    w = pcap_writer_open(path, 64, 1);
+    REQUIRE(w);
+    CHECK(pcap_writer_write(w, pcap_writer_if(w, "eth0"), &ts2, d, 1) == 0);
+    CHECK(pcap_writer_close(w) == 0);
+
+    REQUIRE(pcap_file_read(path, pcap_rec_cb, &recs) == 3);
+    CHECK(recs[0].ts.tv_sec == 1000);
+    CHECK(recs[0].ts.tv_nsec == 123456789);
+    CHECK(recs[0].data == std::string((const char *)d, 61));
+    CHECK(recs[0].orig_len == 61);
+
+    // Truncated to the snaplen
+    CHECK(recs[1].ts.tv_sec == 2000);
+    CHECK(recs[1].ts.tv_nsec == 1);
+    CHECK(recs[1].data == std::string((const char *)d, 64));
+    CHECK(recs[1].orig_len == 100);
+
+    CHECK(recs[2].data == std::string((const char *)d, 1));
+
+    unlink(path);
+}
+
+TEST_CASE("pcap-rw", "[pcap]" ) {
+    pcap_roundtrip("/tmp/ef-test.pcap");
+    pcap_roundtrip("/tmp/ef-test.pcapng");
+}
+
+// Deadlines of the records, when each record is sent as soon as it is due
+static std::vector<uint64_t> replay_deadlines(const char *args) {
+    std::vector<uint64_t> res;
+    std::vector<std::string> words;
+    std::vector<const char *> argv;
+    const pcap_rec_t *rec;
+    replay_t *r = 0;
+    uint64_t now = 1000, wait;
+    std::string s(args);
+    size_t pos;
+
+    while ((pos = s.find(' ')) != std::string::npos) {
+        words.push_back(s.substr(0, pos));
+        s.erase(0, pos + 1);
+    }
+    words.push_back(s);
+    for (auto &w : words)
+        argv.push_back(w.c_str());
+
+    REQUIRE(argc_replay(argv.size(), argv.data(), &r) == (int)argv.size());
+
+    while (!r->done) {
+        wait = 0;
+        rec = replay_next(r, now, &wait);
+        if (rec) {
+            res.push_back(now - 1000);
+            replay_sent(r);
+        }
+        now += wait;
+    }
+
+    replay_free(r);
+
+    return res;
+}
+
+TEST_CASE("pcap-replay", "[pcap]" ) {
+    const char *path = "/tmp/ef-test-replay.pcap";
+    struct timespec ts[] = { { 10, 0 }, { 10, 1000 }, { 10, 500 }, { 11, 0 } };
+    uint8_t d[60] = {};
+
+    pcap_writer_t *w = pcap_writer_open(path, 1500, 0);
+    REQUIRE(w);
+    for (auto &t : ts)
+        CHECK(pcap_writer_write(w, 0, &t, d, sizeof(d)) == 0);
+    CHECK(pcap_writer_close(w) == 0);
+
+    // Out of order records are sent right away
+    CHECK(replay_deadlines("replay /tmp/ef-test-replay.pcap") ==
+          std::vector<uint64_t>({0, 1000, 1000, 1000000000}));
+
+    CHECK(replay_deadlines("replay /tmp/ef-test-replay.pcap speed x2") ==
+          std::vector<uint64_t>({0, 500, 500, 500000000}));
+
+    // The next pass starts where the previous one ended
+    CHECK(replay_deadlines("replay /tmp/ef-test-replay.pcap speed 4 loop 2") ==
+          std::vector<uint64_t>({0, 250, 250, 250000000,
+                                 250000000, 250000250, 250000250, 500000000}));
+
+    CHECK(replay_deadlines("replay /tmp/ef-test-replay.pcap pps 3 loop 2") ==
+          std::vector<uint64_t>({0, 333333333, 666666666, 1000000000,
+                                 1333333333, 1666666666, 2000000000,
+                                 2333333333}));
+
+    CHECK(replay_deadlines("replay /tmp/ef-test-replay.pcap asap") ==
+          std::vector<uint64_t>({0, 0, 0, 0}));
+
+    // The size of a pass, which leaves the replay at its start
+    const char *argv[] = {"replay", path, "loop", "3"};
+    replay_t *r = 0;
+    uint64_t frames, bytes;
+
+    REQUIRE(argc_replay(4, argv, &r) == 4);
+    replay_size(r, &frames, &bytes);
+    CHECK(frames == 4);
+    CHECK(bytes == 4 * sizeof(d));
+    CHECK(replay_next(r, 1000, 0) != 0);
+    replay_free(r);
+
+    unlink(path);
+}
+
+static std::string frame_hex(std::vector<const char *> argv) {
+    frame_t *f = frame_alloc();
+    std::string res;
+
+    REQUIRE(argc_frame(argv.size(), argv.data(), f) == (int)argv.size());
+
+    buf_t *b = frame_to_buf(f);
+    res = std::string((const char *)b->data, b->size);
+    bfree(b);
+    frame_free(f);
+
+    return res;
+}
+
+TEST_CASE("pcap-gen", "[pcap]" ) {
+    std::vector<pcap_rec> recs;
+    std::vector<std::string> exp;
+    gen_t *g = 0;
+
+    // pcp is patched, dscp changes the checksum, cnt changes the size
+    const char *argv[] = { "threads", "3", "shards", "2", "eth", "ctag",
+                           "pcp", "6..7", "ipv4", "dscp", "1..3", "udp",
+                           "data", "pattern", "cnt", "0..1", "rx" };
+    REQUIRE(argc_gen(17, argv, &g) == 16);
+    CHECK(gen_cnt(g) == 12);
+    CHECK(gen_run(g, "/tmp/ef-test-gen.pcap") == 12);
+    gen_free(g);
+
+    for (int pcp = 6; pcp <= 7; ++pcp) {
+        for (int dscp = 1; dscp <= 3; ++dscp) {
+            for (int cnt = 0; cnt <= 1; ++cnt) {
+                std::string p = std::to_string(pcp), d = std::to_string(dscp),
+                            c = std::to_string(cnt);
+                exp.push_back(frame_hex({"eth", "ctag", "pcp", p.c_str(),
+                                         "ipv4", "dscp", d.c_str(), "udp",
+                                         "data", "pattern", "cnt",
+                                         c.c_str()}));
+            }
+        }
+    }
+
+    REQUIRE(pcap_file_read("/tmp/ef-test-gen-000.pcap", pcap_rec_cb,
+                           &recs) == 6);
+    REQUIRE(pcap_file_read("/tmp/ef-test-gen-001.pcap", pcap_rec_cb,
+                           &recs) == 6);
+    for (size_t i = 0; i < recs.size(); ++i) {
+        CHECK(recs[i].data == exp[i]);
+        CHECK(recs[i].ts.tv_sec == 0);
+        CHECK(recs[i].ts.tv_nsec == (long)i * 1000);
+    }
+
+    const char *bad[] = { "eth", "ctag", "vid", "2..1" };
+    CHECK(argc_gen(4, bad, &g) == -1);
+
+    unlink("/tmp/ef-test-gen-000.pcap");
+    unlink("/tmp/ef-test-gen-001.pcap");
+}
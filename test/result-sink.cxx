@@ -0,0 +1,142 @@
+#include "ef.h"
+#include "ef-test.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "catch_single_include.hxx"
+
+static std::string slurp(const char *path) {
+    std::string s;
+    char buf[4096];
+    size_t n;
+    FILE *f = fopen(path, "rb");
+
+    if (!f)
+        return s;
+
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        s.append(buf, n);
+
+    fclose(f);
+
+    return s;
+}
+
+static std::vector<std::string> lines(const std::string &s) {
+    std::vector<std::string> v;
+    size_t b = 0, e;
+
+    while ((e = s.find('\n', b)) != std::string::npos) {
+        v.push_back(s.substr(b, e - b));
+        b = e + 1;
+    }
+
+    return v;
+}
+
+TEST_CASE("result-sink-jsonl", "[result]" ) {
+    char path[] = "/tmp/ef-result-XXXXXX";
+    struct timespec ts = { 1700000000, 5 };
+    int fd = mkstemp(path);
+
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    std::string spec = std::string("jsonl:") + path;
+    REQUIRE(result_sink_open(spec.c_str()) == 0);
+    CHECK(result_sink_active());
+
+    result_add(RESULT_TX, 0, "eth0", &ts, TS_SRC_SW, 64, "f1");
+    result_add(RESULT_RX_ERR, -1, "a\"b\\c\n", &ts, TS_SRC_HW, 60, 0);
+    result_add(RESULT_NO_RX, 2, "eth1", &ts, TS_SRC_HOST, 0, "\x01");
+
+    // More records than fit in a buffer go through the writer thread
+    for (int i = 0; i < 10000; ++i)
+        result_add(RESULT_RX_OK, 1, "eth1", &ts, TS_SRC_SW, i, 0);
+
+    REQUIRE(result_sink_close() == 0);
+    CHECK(!result_sink_active());
+
+    auto v = lines(slurp(path));
+    REQUIRE(v.size() == 10003);
+    CHECK(v[0] == "{\"type\":\"tx\",\"cmd\":0,\"if\":\"eth0\",\"ts\":"
+                  "1700000000.000000005,\"ts_src\":\"sw\",\"len\":64,"
+                  "\"name\":\"f1\"}");
+    CHECK(v[1] == "{\"type\":\"rx-err\",\"cmd\":-1,\"if\":\"a\\\"b\\\\c"
+                  "\\u000a\",\"ts\":1700000000.000000005,\"ts_src\":\"hw\","
+                  "\"len\":60}");
+    CHECK(v[2] == "{\"type\":\"no-rx\",\"cmd\":2,\"if\":\"eth1\",\"ts\":"
+                  "1700000000.000000005,\"ts_src\":\"host\",\"len\":0,"
+                  "\"name\":\"\\u0001\"}");
+
+    // In order, across the buffers
+    CHECK(v[3].find("\"len\":0}") != std::string::npos);
+    CHECK(v[10002].find("\"len\":9999}") != std::string::npos);
+
+    unlink(path);
+}
+
+TEST_CASE("result-sink-bin", "[result]" ) {
+    char path[] = "/tmp/ef-result-XXXXXX";
+    struct timespec ts = { 1700000000, 123456789 };
+    int fd = mkstemp(path);
+
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    // The record layout is an interface of the binary stream
+    CHECK(sizeof(result_rec_t) == 72);
+    CHECK(offsetof(result_rec_t, ts_sec) == 0);
+    CHECK(offsetof(result_rec_t, ts_nsec) == 8);
+    CHECK(offsetof(result_rec_t, frame_len) == 12);
+    CHECK(offsetof(result_rec_t, cmd_idx) == 16);
+    CHECK(offsetof(result_rec_t, type) == 20);
+    CHECK(offsetof(result_rec_t, ts_src) == 21);
+    CHECK(offsetof(result_rec_t, ifname) == 24);
+    CHECK(offsetof(result_rec_t, name) == 40);
+
+    std::string spec = std::string("bin:") + path;
+    REQUIRE(result_sink_open(spec.c_str()) == 0);
+
+    result_add(RESULT_RX_OK, 3, "eth0", &ts, TS_SRC_HW, 1514,
+               "a-name-longer-than-the-record-holds");
+    for (int i = 0; i < 5000; ++i)
+        result_add(RESULT_TX, i, "eth1", &ts, TS_SRC_SW, 64, 0);
+
+    REQUIRE(result_sink_close() == 0);
+
+    std::string s = slurp(path);
+    REQUIRE(s.size() == 8 + 5001 * sizeof(result_rec_t));
+
+    uint32_t hdr[2];
+    memcpy(hdr, s.data(), sizeof(hdr));
+    CHECK(hdr[0] == 0x45465231);
+    CHECK(hdr[1] == sizeof(result_rec_t));
+
+    result_rec_t r;
+    memcpy(&r, s.data() + 8, sizeof(r));
+    CHECK(r.ts_sec == 1700000000);
+    CHECK(r.ts_nsec == 123456789);
+    CHECK(r.frame_len == 1514);
+    CHECK(r.cmd_idx == 3);
+    CHECK(r.type == RESULT_RX_OK);
+    CHECK(r.ts_src == TS_SRC_HW);
+    CHECK(std::string(r.ifname) == "eth0");
+    CHECK(std::string(r.name) == "a-name-longer-than-the-record-h");
+
+    memcpy(&r, s.data() + 8 + 5000 * sizeof(r), sizeof(r));
+    CHECK(r.type == RESULT_TX);
+    CHECK(r.cmd_idx == 4999);
+    CHECK(r.name[0] == 0);
+
+    unlink(path);
+}
+
+TEST_CASE("result-sink-invalid", "[result]" ) {
+    CHECK(result_sink_open("csv:/tmp/x") == -1);
+    CHECK(result_sink_open("jsonl:/nonexistent/dir/file") == -1);
+    CHECK(!result_sink_active());
+}
@@ -0,0 +1,117 @@
+#include "ef.h"
+#include "ef-test.h"
+
+#include <vector>
+#include "catch_single_include.hxx"
+
+static int parse_rfc2544(std::vector<const char *> ptrs) {
+    rfc2544_t *r = 0;
+    int res;
+
+    res = argc_rfc2544(ptrs.size(), ptrs.data(), &r);
+    if (res > 0)
+        CHECK(r);
+    else
+        CHECK(r == 0);
+    rfc2544_free(r);
+
+    return res;
+}
+
+TEST_CASE("rfc2544-args", "[rfc2544]" ) {
+    CHECK(parse_rfc2544({"eth1", "eth", "ipv4", "udp"}) == 4);
+
+    // The frame ends where the next command starts
+    CHECK(parse_rfc2544({"eth1", "rate", "1000", "sizes", "64,1518",
+                         "duration", "100", "resolution", "0.1", "burst",
+                         "1000", "tests", "throughput,b2b", "eth", "dmac",
+                         "::1", "tx", "eth0", "eth"}) == 16);
+
+    CHECK(parse_rfc2544({"eth1", "sizes", "63", "eth"}) == -1);
+    CHECK(parse_rfc2544({"eth1", "sizes", "64,", "eth"}) == 4);
+    CHECK(parse_rfc2544({"eth1", "sizes", "64;128", "eth"}) == -1);
+    CHECK(parse_rfc2544({"eth1", "tests", "throughput,foo", "eth"}) == -1);
+    CHECK(parse_rfc2544({"eth1", "rate", "0", "eth"}) == -1);
+    CHECK(parse_rfc2544({"eth1", "resolution", "100", "eth"}) == -1);
+    CHECK(parse_rfc2544({"eth1", "burst", "x", "eth"}) == -1);
+    CHECK(parse_rfc2544({"eth1"}) == -1);
+    CHECK(parse_rfc2544({}) == -1);
+}
+
+TEST_CASE("rfc2544-trial", "[rfc2544]" ) {
+    rfc2544_trial_t t = {};
+
+    t.sent = t.received = 1000;
+    t.fps = 995;
+    CHECK(rfc2544_trial_res(&t, 1000, 1000) == RFC2544_PASS);
+
+    t.received = 999;
+    CHECK(rfc2544_trial_res(&t, 1000, 1000) == RFC2544_FAIL);
+
+    // The host did not keep up: too slow, also for a burst at the line
+    // rate, send errors or drops on RX
+    t.fps = 900;
+    CHECK(rfc2544_trial_res(&t, 1000, 1000) == RFC2544_HOST_LIMITED);
+
+    t.fps = 995;
+    t.sent = 990;
+    t.tx_err = 10;
+    CHECK(rfc2544_trial_res(&t, 1000, 1000) == RFC2544_HOST_LIMITED);
+
+    t.sent = 1000;
+    t.tx_err = 0;
+    t.host_drops = 1;
+    CHECK(rfc2544_trial_res(&t, 1000, 1000) == RFC2544_HOST_LIMITED);
+
+    // The rate of a single frame is not known
+    t = {};
+    t.sent = t.received = 1;
+    CHECK(rfc2544_trial_res(&t, 10, 1) == RFC2544_PASS);
+}
+
+TEST_CASE("rfc2544-search", "[rfc2544]" ) {
+    rfc2544_search_t s = {};
+
+    // The DUT passes up to 30%
+    s.hi = s.cur = 100;
+    s.step = 1;
+    while (rfc2544_search_next(&s, s.cur <= 30 ? RFC2544_PASS :
+                                                 RFC2544_FAIL))
+        ;
+    CHECK(s.lo <= 30);
+    CHECK(s.lo >= 29);
+    CHECK(s.hi > 30);
+    CHECK(!s.host_limited);
+
+    // Full rate
+    s = {};
+    s.hi = s.cur = 100;
+    s.step = 1;
+    CHECK(rfc2544_search_next(&s, RFC2544_PASS) == 0);
+    CHECK(s.lo == 100);
+
+    // The host cannot send above 60%: the search stops there, instead of
+    // searching below it
+    s = {};
+    s.hi = s.cur = 100;
+    s.step = 1;
+    CHECK(rfc2544_search_next(&s, RFC2544_FAIL) == 1);
+    CHECK(s.cur == 50);
+    CHECK(rfc2544_search_next(&s, RFC2544_PASS) == 1);
+    CHECK(s.cur == 75);
+    CHECK(rfc2544_search_next(&s, RFC2544_HOST_LIMITED) == 0);
+    CHECK(s.host_limited);
+    CHECK(s.lo == 50);
+    CHECK(s.hi == 100);
+
+    // Bursts are whole frames
+    s = {};
+    s.hi = s.cur = 1001;
+    s.step = 1;
+    s.whole = 1;
+    while (rfc2544_search_next(&s, s.cur <= 333 ? RFC2544_PASS :
+                                                  RFC2544_FAIL))
+        CHECK(s.cur == (uint64_t)s.cur);
+    CHECK(s.lo == 333);
+    CHECK(s.hi == 334);
+}
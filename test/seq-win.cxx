@@ -0,0 +1,145 @@
+#include "ef.h"
+#include "ef-test.h"
+
+#include "catch_single_include.hxx"
+
+static seq_win_t *seq_win_new() {
+    seq_win_t *w = (seq_win_t *)calloc(1, sizeof(seq_win_t));
+
+    seq_win_start(w, 0);
+
+    return w;
+}
+
+TEST_CASE("seq-win-in-order", "[seq]" ) {
+    seq_win_t *w = seq_win_new();
+
+    for (uint64_t s = 0; s < 100000; ++s)
+        seq_win_add(w, s);
+
+    seq_win_end(w, 100000);
+    CHECK(w->frames == 100000);
+    CHECK(w->lost == 0);
+    CHECK(w->reordered == 0);
+    CHECK(w->duplicates == 0);
+    CHECK(w->late == 0);
+
+    free(w);
+}
+
+TEST_CASE("seq-win-loss", "[seq]" ) {
+    seq_win_t *w = seq_win_new();
+
+    // 5 lost within the window, then a gap larger than the window
+    for (uint64_t s = 0; s < 100; ++s)
+        if (s % 20 != 7)
+            seq_win_add(w, s);
+
+    seq_win_add(w, 100 + 3 * SEQ_WIN_BITS);
+    CHECK(w->lost == 5 + 3 * SEQ_WIN_BITS - SEQ_WIN_BITS + 1);
+
+    // Lost at the end, only known from the sender
+    seq_win_end(w, 101 + 3 * SEQ_WIN_BITS + 10);
+    CHECK(w->lost == 5 + 3 * SEQ_WIN_BITS + 10);
+
+    free(w);
+}
+
+TEST_CASE("seq-win-reorder", "[seq]" ) {
+    seq_win_t *w = seq_win_new();
+
+    seq_win_add(w, 0);
+    seq_win_add(w, 1);
+    seq_win_add(w, 4);
+    seq_win_add(w, 2);
+    seq_win_add(w, 3);
+    seq_win_add(w, 3);
+    seq_win_add(w, 5);
+
+    seq_win_end(w, 6);
+    CHECK(w->frames == 7);
+    CHECK(w->lost == 0);
+    CHECK(w->reordered == 2);
+    CHECK(w->reorder_max == 2);
+    CHECK(w->duplicates == 1);
+
+    free(w);
+}
+
+TEST_CASE("seq-win-late", "[seq]" ) {
+    seq_win_t *w = seq_win_new();
+
+    for (uint64_t s = 1; s < 2 * SEQ_WIN_BITS; ++s)
+        seq_win_add(w, s);
+
+    CHECK(w->lost == 1);
+    seq_win_add(w, 0);
+    CHECK(w->late == 1);
+    CHECK(w->lost == 0);
+
+    // Beyond a jump larger than the window
+    seq_win_add(w, 5 * SEQ_WIN_BITS);
+    CHECK(w->lost == 2 * SEQ_WIN_BITS + 1);
+    seq_win_add(w, 3 * SEQ_WIN_BITS);
+    seq_win_add(w, 4 * SEQ_WIN_BITS - 1);
+    CHECK(w->late == 3);
+    CHECK(w->lost == 2 * SEQ_WIN_BITS - 1);
+
+    // The rest of the holes, in the window
+    seq_win_end(w, 5 * SEQ_WIN_BITS + 1);
+    CHECK(w->lost == 3 * SEQ_WIN_BITS - 2);
+
+    free(w);
+}
+
+TEST_CASE("seq-win-wrap", "[seq]" ) {
+    seq_win_t *w = (seq_win_t *)calloc(1, sizeof(seq_win_t));
+
+    // A 16 bit R-TAG sequence number, starting close to the wrap
+    for (uint64_t s = 65000; s < 65000 + 1000; ++s)
+        seq_win_add_wrap(w, s & 0xffff, 16);
+
+    seq_win_add_wrap(w, (65000 + 990) & 0xffff, 16);
+    seq_win_end(w, 0);
+    CHECK(w->frames == 1001);
+    CHECK(w->next == 66000);
+    CHECK(w->lost == 0);
+    CHECK(w->duplicates == 1);
+
+    free(w);
+}
+
+TEST_CASE("seq-rx-rtag", "[seq]" ) {
+    const char *argv[] = {"seq", "rtag"};
+    seq_rx_t *r = 0;
+
+    REQUIRE(argc_seq(2, argv, &r) == 2);
+    REQUIRE(r);
+
+    for (int s = 0; s < 3; ++s) {
+        char seqn[8];
+
+        snprintf(seqn, sizeof(seqn), "%d", s);
+        auto f = parse_frame_wrap({"eth", "ctag", "vid", "10", "rtag", "seqn",
+                                   seqn, "ipv4"});
+        buf_t *b = frame_to_buf(f);
+        CHECK(seq_rx_frame(r, b) == 1);
+        bfree(b);
+        frame_free(f);
+    }
+
+    auto f = parse_frame_wrap({"eth", "ipv4"});
+    buf_t *b = frame_to_buf(f);
+    CHECK(seq_rx_frame(r, b) == 0);
+    bfree(b);
+    frame_free(f);
+
+    CHECK(r->win.frames == 3);
+    CHECK(r->win.next == 3);
+    free(r);
+
+    const char *bad[] = {"seq", "offset", "14", "bytes", "3"};
+    r = 0;
+    CHECK(argc_seq(5, bad, &r) == -1);
+    CHECK(r == 0);
+}
@@ -3,6 +3,10 @@
 
 #include "catch_single_include.hxx"
 
+#include <chrono>
+#include <functional>
+#include <unistd.h>
+
 //std::ostream& operator<<(std::ostream& o, const buf_t &b) {
 //    o << hexstr(b);
 //    return o;
@@ -102,6 +106,149 @@ TEST_CASE("parse_bytes", "[parse_bytes]" ) {
         // 1:2::3  -> 01:02:00:00:00:03
 }
 
+// The inputs of the parse_bytes test case, used to compare the current
+// implementation with the previous one, and to benchmark them against each
+// other.
+static const struct {
+    const char *s;
+    int         bytes;
+} PARSE_BYTES_VECTORS[] = {
+    {"5", 4},
+    {"5", 3},
+    {"5", 2},
+    {"5", 1},
+    {"100", 4},
+    {"77", 4},
+    {"1234", 4},
+    {"0x0800", 2},
+    {"0b1111", 2},
+    {"::1", 16},
+    {"2000::10.1.2.3", 16},
+    {"10.1.2.3", 4},
+    {"10.1.2.8", 4},
+    {"10.0.99.2", 4},
+    {"5.6.7.8", 4},
+    {":::", 6},
+    {"00::00::00", 6},
+    {"::00::00", 6},
+    {"::", 6},
+    {"::1", 6},
+    {"::1:2", 6},
+    {"::1:2:3", 6},
+    {"::1:2:3:4", 6},
+    {"::1:2:3:4:5", 6},
+    {"::1:2:3:4:5:6", 6},
+    {"::1:2:3:4:5:6:7", 6},
+    {"10::", 6},
+    {"10::1", 6},
+    {"10::1:2", 6},
+    {"10::1:2:3", 6},
+    {"10::1:2:3:4", 6},
+    {"10::1:2:3:4:5", 6},
+    {"10::1:2:3:4:5:6", 6},
+    {"10:20::", 6},
+    {"10:20::1", 6},
+    {"10:20::1:2", 6},
+    {"10:20::1:2:3", 6},
+    {"10:20::1:2:3:4", 6},
+    {"10:20::1:2:3:4:5", 6},
+    {"10:20:30::", 6},
+    {"10:20:30::1", 6},
+    {"10:20:30::1:2", 6},
+    {"10:20:30::1:2:3", 6},
+    {"10:20:30::1:2:3:4", 6},
+    {"10:20:30:40::", 6},
+    {"10:20:30:40::1", 6},
+    {"10:20:30:40::1:2", 6},
+    {"10:20:30:40::1:2:3", 6},
+    {"10:20:30:40:50::", 6},
+    {"10:20:30:40:50::1", 6},
+    {"10:20:30:40:50::1:2", 6},
+    {"a::4", 6},
+    {"0a::4", 6},
+    {"a0::4", 6},
+    {"B::5", 6},
+    {"0B::5", 6},
+    {"B0::5", 6},
+    {"::", 16},
+    {"0x3311ff", 16},
+    {"0x11000022", 12},
+    {"0b00000001", 12},
+    {"0b00000101", 12},
+    {"0b1000000000000101", 12},
+};
+
+TEST_CASE("parse_bytes_legacy", "[parse_bytes]" ) {
+    for (const auto &v : PARSE_BYTES_VECTORS) {
+        INFO(v.s << " (" << v.bytes << " bytes)");
+        CHECK(hexstr(parse_bytes(v.s, v.bytes)) ==
+              hexstr(parse_bytes_legacy(v.s, v.bytes)));
+    }
+}
+
+TEST_CASE("field_val_parse", "[parse_bytes]" ) {
+    field_t f = {};
+
+    CHECK(field_val_parse(&f, "0x1234", 2) == 0);
+    REQUIRE(f.val);
+    CHECK(hexstr(bclone(f.val)) == "1234");
+
+    // The value is parsed into the buffer the field has
+    buf_t *val = f.val;
+    CHECK(field_val_parse(&f, "5", 2) == 0);
+    CHECK(f.val == val);
+    CHECK(hexstr(bclone(f.val)) == "0005");
+
+    CHECK(field_val_parse(&f, "1.2.3.4", 4) == 0);
+    CHECK(hexstr(bclone(f.val)) == "01020304");
+
+    CHECK(field_val_parse(&f, "x", 4) == -1);
+    CHECK(f.val == 0);
+}
+
+// Hidden, run with: ef-tests "[bench]"
+TEST_CASE("parse_bytes_bench", "[.][bench]" ) {
+    const int rounds = 20000;
+    std::vector<size_t> valid;
+    uint8_t o[16];
+
+    // Only the vectors that parse, the error paths print a message each time
+    for (size_t i = 0; i < sizeof(PARSE_BYTES_VECTORS) /
+                           sizeof(PARSE_BYTES_VECTORS[0]); ++i) {
+        buf_t *b = parse_bytes(PARSE_BYTES_VECTORS[i].s,
+                               PARSE_BYTES_VECTORS[i].bytes);
+        if (b)
+            valid.push_back(i);
+        bfree(b);
+    }
+
+    auto bench = [&](const char *name, std::function<void(size_t)> fn) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r)
+            for (size_t i : valid)
+                fn(i);
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+
+        printf("%-20s %8.1f ns/op\n", name, ns / (rounds * valid.size()));
+    };
+
+    bench("parse_bytes_legacy", [](size_t i) {
+        bfree(parse_bytes_legacy(PARSE_BYTES_VECTORS[i].s,
+                                 PARSE_BYTES_VECTORS[i].bytes));
+    });
+
+    bench("parse_bytes", [](size_t i) {
+        bfree(parse_bytes(PARSE_BYTES_VECTORS[i].s,
+                          PARSE_BYTES_VECTORS[i].bytes));
+    });
+
+    bench("parse_bytes_into", [&](size_t i) {
+        parse_bytes_into(PARSE_BYTES_VECTORS[i].s, o,
+                         PARSE_BYTES_VECTORS[i].bytes);
+    });
+}
+
 TEST_CASE("hdr_write_field", "[hdr_write_field]" ) {
 #define X(VAL_SIZE, VAL, WIDTH, OFFSET, OUT_SIZE, OUT)            \
     {                                                             \
@@ -365,5 +512,133 @@ TEST_CASE("parse_var_bytes", "[parse_var_bytes]" ) {
     X("aaaaaaaaaaaaaaaaaaaaacef00010203040506070809",
       "repeat", "10", "0xaa", "hex", "acef", "pattern", "cnt", "10");
 
+    {
+        char path[] = "/tmp/ef-test-XXXXXX";
+        int fd = mkstemp(path);
+        REQUIRE(fd >= 0);
+        REQUIRE(write(fd, "\x01\x02\x03\x04\x05\x06", 6) == 6);
+        close(fd);
+
+        X("010203040506", "file", path);
+        X("0304", "file", path, "2", "2");
+        X("0506ab", "file", path, "4", "2", "hex", "ab");
+        X("abcd010203040506", "hex", "abcd", "file", path);
+
+        // The mapping is shared by clones, and outlives the original
+        buf_t *b1 = parse_var_bytes_wrap({"file", path, "1", "3"});
+        REQUIRE(b1);
+        buf_t *b2 = bclone(b1);
+        bfree(b1);
+        CHECK(hexstr(b2) == "020304");
+
+        CHECK(parse_var_bytes_wrap({"file", path, "4", "3"}) == 0);
+        unlink(path);
+    }
+
 #undef X
 }
+
+TEST_CASE("hex_codec", "[hex]" ) {
+    const char *impls[] = { "scalar", "ssse3", "avx2" };
+    std::vector<uint8_t> d(300), o(300);
+    std::string ref, enc;
+    size_t len;
+
+    for (size_t i = 0; i < d.size(); ++i)
+        d[i] = (i * 37 + 11) & 0xff;
+
+    hex_impl_select("scalar");
+    ref.resize(2 * d.size());
+    hex_encode(&ref[0], d.data(), d.size());
+    CHECK(ref.substr(0, 8) == "0b30557a");
+
+    for (const char *impl : impls) {
+        if (hex_impl_select(impl) != 0)
+            continue;
+
+        INFO("impl: " << impl);
+
+        for (size_t n = 0; n <= d.size(); n += 7) {
+            enc.assign(2 * n, 0);
+            hex_encode(&enc[0], d.data(), n);
+            CHECK(enc == ref.substr(0, 2 * n));
+
+            // Upper case, and delimiters at a few byte boundaries
+            for (size_t j = 0; j < enc.size(); j += 3)
+                enc[j] = toupper(enc[j]);
+            if (n > 40)
+                enc.insert(40, ":");
+            if (n > 5)
+                enc.insert(10, "-");
+
+            std::fill(o.begin(), o.end(), 0);
+            CHECK(hex_decode(enc.c_str(), enc.size(), o.data(), n, &len) ==
+                  (n ? 0 : HEX_DECODE_INVALID));
+            if (n) {
+                CHECK(len == n);
+                CHECK(memcmp(o.data(), d.data(), n) == 0);
+            }
+
+            if (n > 1) {
+                CHECK(hex_decode(enc.c_str(), enc.size(), o.data(), n - 1,
+                                 &len) == HEX_DECODE_SIZE);
+            }
+        }
+
+        // Errors in the middle of a block which is otherwise valid
+        std::string s(ref.substr(0, 128));
+        for (size_t j = 0; j < s.size(); j += 5) {
+            std::string t(s);
+            t[j] = 'g';
+            CHECK(hex_decode(t.c_str(), t.size(), o.data(), o.size(), &len) ==
+                  HEX_DECODE_INVALID);
+
+            t = s;
+            t.insert(j | 1, ".");
+            CHECK(hex_decode(t.c_str(), t.size(), o.data(), o.size(), &len) ==
+                  HEX_DECODE_ALIGN);
+        }
+
+        // An invalid character is reported before an alignment error
+        CHECK(hex_decode("a.bcz", 5, o.data(), o.size(), &len) ==
+              HEX_DECODE_INVALID);
+        CHECK(hex_decode("abc", 3, o.data(), o.size(), &len) ==
+              HEX_DECODE_ALIGN);
+        CHECK(hex_decode("::", 2, o.data(), o.size(), &len) ==
+              HEX_DECODE_INVALID);
+    }
+
+    hex_impl_select("avx2") == 0 || hex_impl_select("ssse3") == 0 ||
+        hex_impl_select("scalar");
+}
+
+TEST_CASE("hex_bench", "[.][bench]" ) {
+    const char *impls[] = { "scalar", "ssse3", "avx2" };
+    const int rounds = 20000;
+    std::vector<uint8_t> d(1500), o(1500);
+    std::string s(3000, 0);
+    size_t len;
+
+    for (size_t i = 0; i < d.size(); ++i)
+        d[i] = i & 0xff;
+
+    for (const char *impl : impls) {
+        if (hex_impl_select(impl) != 0)
+            continue;
+
+        auto begin = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r)
+            hex_encode(&s[0], d.data(), d.size());
+        auto mid = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r)
+            hex_decode(s.c_str(), s.size(), o.data(), o.size(), &len);
+        auto end = std::chrono::steady_clock::now();
+
+        printf("%-8s encode %8.1f ns, decode %8.1f ns (1500 bytes)\n", impl,
+               std::chrono::duration<double, std::nano>(mid - begin).count() / rounds,
+               std::chrono::duration<double, std::nano>(end - mid).count() / rounds);
+    }
+
+    hex_impl_select("avx2") == 0 || hex_impl_select("ssse3") == 0 ||
+        hex_impl_select("scalar");
+}